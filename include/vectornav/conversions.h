@@ -0,0 +1,123 @@
+/*
+ * MIT License (MIT)
+ *
+ * Copyright (c) 2018 Dereck Wonnacott <dereck@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+//
+// Conversions between the VectorNav library's vectors and ROS messages.
+//
+// The functions follow tf2's toMsg/fromMsg convention and live in vn::math
+// next to the types they convert, so tf2::convert finds them by argument
+// dependent lookup:
+//
+//     geometry_msgs::Vector3 msg;
+//     toMsg(cd.angularRate(), msg);
+//     tf2::convert(cd.quaternion(), imu.orientation);
+//
+// Message fields are written directly from the library's values, so filling
+// a message costs no temporaries. To do arithmetic on the values with Eigen,
+// view them in place with the functions in vn/eigen.h.
+//
+
+#ifndef VECTORNAV_CONVERSIONS_H
+#define VECTORNAV_CONVERSIONS_H
+
+#include <geometry_msgs/Point.h>
+#include <geometry_msgs/Quaternion.h>
+#include <geometry_msgs/Vector3.h>
+
+#include "vn/vector.h"
+
+namespace vn {
+namespace math {
+
+// Converts a position to a point message.
+template <typename T>
+geometry_msgs::Point toMsg(const vec<3, T>& in)
+{
+    geometry_msgs::Point out;
+    out.x = in.x;
+    out.y = in.y;
+    out.z = in.z;
+    return out;
+}
+
+// Converts a vector to a vector message.
+template <typename T>
+geometry_msgs::Vector3& toMsg(const vec<3, T>& in, geometry_msgs::Vector3& out)
+{
+    out.x = in.x;
+    out.y = in.y;
+    out.z = in.z;
+    return out;
+}
+
+// Converts a scalar last quaternion, as output by the sensor, to a quaternion
+// message.
+template <typename T>
+geometry_msgs::Quaternion toMsg(const vec<4, T>& in)
+{
+    geometry_msgs::Quaternion out;
+    out.x = in.x;
+    out.y = in.y;
+    out.z = in.z;
+    out.w = in.w;
+    return out;
+}
+
+// Converts a quaternion to a quaternion message.
+template <typename T>
+geometry_msgs::Quaternion& toMsg(const vec<4, T>& in, geometry_msgs::Quaternion& out)
+{
+    out.x = in.x;
+    out.y = in.y;
+    out.z = in.z;
+    out.w = in.w;
+    return out;
+}
+
+// Converts a point message to a position.
+template <typename T>
+void fromMsg(const geometry_msgs::Point& in, vec<3, T>& out)
+{
+    out = vec<3, T>(in.x, in.y, in.z);
+}
+
+// Converts a vector message to a vector.
+template <typename T>
+void fromMsg(const geometry_msgs::Vector3& in, vec<3, T>& out)
+{
+    out = vec<3, T>(in.x, in.y, in.z);
+}
+
+// Converts a quaternion message to a scalar last quaternion.
+template <typename T>
+void fromMsg(const geometry_msgs::Quaternion& in, vec<4, T>& out)
+{
+    out = vec<4, T>(in.x, in.y, in.z, in.w);
+}
+
+}
+}
+
+#endif
@@ -25,7 +25,9 @@
 
 #include <iostream>
 #include <cmath>
-#include <eigen3/Eigen/Dense>
+#include <mutex>
+#include <atomic>
+#include <memory>
 // No need to define PI twice if we already have it included...
 //#define M_PI 3.14159265358979323846  /* M_PI */
 
@@ -39,15 +41,15 @@
 #include "nav_msgs/Odometry.h"
 #include "sensor_msgs/Temperature.h"
 #include "sensor_msgs/FluidPressure.h"
+#include "sensor_msgs/TimeReference.h"
 #include "std_srvs/Empty.h"
 #include <tf2/LinearMath/Transform.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
 #include <vectornav/Ins.h>
+#include <vectornav/Reconnect.h>
 
-using namespace Eigen;
 
-
-ros::Publisher pubIMU, pubMag, pubGPS, pubOdom, pubTemp, pubPres, pubIns, ins_pos_pub, local_vel_pub, NED_pose_pub, ECEF_pose_pub, ins_ref_pub, ecef_ref_pub;
+ros::Publisher pubIMU, pubMag, pubGPS, pubOdom, pubTemp, pubPres, pubIns, pubReconnect, pubTimeRef, ins_pos_pub, local_vel_pub, NED_pose_pub, ECEF_pose_pub, ins_ref_pub, ecef_ref_pub;
 ros::ServiceServer resetOdomSrv;
 
 //Unused covariances initilized to zero's
@@ -63,8 +65,13 @@ struct UserData {
 
 // Include this header file to get access to VectorNav sensors.
 #include "vn/sensors.h"
+#include "vn/sensorhub.h"
 #include "vn/compositedata.h"
+#include "vn/gapdetector.h"
+#include "vn/clocksync.h"
 #include "vn/util.h"
+#include "vn/geodesy.h"
+#include "vectornav/conversions.h"
 
 using namespace std;
 using namespace vn::math;
@@ -73,7 +80,28 @@ using namespace vn::protocol::uart;
 using namespace vn::xplat;
 
 // Method declarations for future use.
-void BinaryAsyncMessageReceived(void* userData, Packet& p, size_t index);
+void BinaryAsyncMessageReceived(void* userData, Packet& p, size_t index, TimeStamp timestamp);
+
+// Tracks gaps in the sensor's counters so we can tell data lost on the wire
+// from data lost in software. Accessed from the serial thread and the timer.
+GapDetector gap_detector;
+std::mutex gap_detector_mutex;
+
+// Maps the sensor's TimeStartup onto the host clock so vectornav/TimeReference
+// gives when the sensor produced the data rather than when we received it.
+// Only accessed from the serial thread.
+ClockSync clock_sync;
+
+// Set by the supervisor after reconnecting, since a power cycled sensor
+// restarts its clock. The serial thread resets clock_sync when it sees it.
+std::atomic<bool> sensor_reconnected(false);
+
+// Converts a host timestamp from the library's clock into ROS time.
+ros::Time toRosTime(const TimeStamp& t)
+{
+    TimeStamp now = TimeStamp::get(t.clockSource());
+    return ros::Time::now() - ros::Duration().fromNSec(now.totalNs() - t.totalNs());
+}
 
 // frame id used only for Odom header.frame_id
 std::string map_frame_id;
@@ -87,18 +115,8 @@ bool frame_based_enu;
 //vec3d initial_position;
 bool initial_position_set = false;
 
-Vector3d Pe_ref;
-Matrix3d Rne;
-Vector3d Pe;
-Vector3d NED;
-double re = 6378137; //equatorial radius
-double rp = 6356752; //polar axis radius
-double ecc = 0.0818; //eccentricity
-//Alternatively use
-//float ecc = pow(re*re - rp*rp,0.5)/re;
-double Ne; //prime vertical radius of curvature
-double lat_radians; //latitude in radians
-double lon_radians; //longitude in radians
+// North, east, down frame at the initial position.
+LocalTangentPlane ned_frame;
 
 //Custom topics
 geometry_msgs::Pose2D ins_ref;
@@ -123,6 +141,41 @@ boost::array<double, 9ul> setCov(XmlRpc::XmlRpcValue rpc){
     return output;
 }
 
+// Adds [register id, "fields"] pairs from the parameter server to a profile
+void addRegisters(XmlRpc::XmlRpcValue rpc, ConfigurationProfile &profile){
+    ROS_ASSERT(rpc.getType() == XmlRpc::XmlRpcValue::TypeArray);
+
+    for(int i = 0; i < rpc.size(); i++){
+        ROS_ASSERT(rpc[i].getType() == XmlRpc::XmlRpcValue::TypeArray && rpc[i].size() == 2);
+        ROS_ASSERT(rpc[i][0].getType() == XmlRpc::XmlRpcValue::TypeInt);
+        ROS_ASSERT(rpc[i][1].getType() == XmlRpc::XmlRpcValue::TypeString);
+        profile.set((int)rpc[i][0], (std::string)rpc[i][1]);
+    }
+}
+
+// Called by the VnSensor supervisor after it restored the connection
+void SensorReconnected(void* userData, const VnSensor::ReconnectInfo& info)
+{
+    ROS_WARN("Reconnected to device at %u baud after %.0f ms outage (reconnect took %.0f ms, %d registers restored)",
+        info.baudrate, info.outageMs, info.reconnectMs, (int)info.changedRegisters.size());
+
+    {
+        std::lock_guard<std::mutex> lock(gap_detector_mutex);
+        gap_detector.reset();
+    }
+    sensor_reconnected = true;
+
+    vectornav::Reconnect msg;
+    msg.header.stamp = ros::Time::now();
+    msg.header.frame_id = frame_id;
+    msg.outage = info.outageMs;
+    msg.latency = info.reconnectMs;
+    msg.baudrate = info.baudrate;
+    msg.changedRegisters = info.changedRegisters;
+    msg.count = info.numOfReconnects;
+    pubReconnect.publish(msg);
+}
+
 // Reset initial position to current position
 bool resetOdom(std_srvs::Empty::Request &req, std_srvs::Empty::Response &resp)
 {
@@ -145,6 +198,8 @@ int main(int argc, char *argv[])
     pubTemp = n.advertise<sensor_msgs::Temperature>("vectornav/Temp", 1000);
     pubPres = n.advertise<sensor_msgs::FluidPressure>("vectornav/Pres", 1000);
     pubIns = n.advertise<vectornav::Ins>("vectornav/INS", 1000);
+    pubReconnect = n.advertise<vectornav::Reconnect>("vectornav/Reconnect", 10);
+    pubTimeRef = n.advertise<sensor_msgs::TimeReference>("vectornav/TimeReference", 1000);
     ins_pos_pub = n.advertise<geometry_msgs::Pose2D>("/vectornav/ins_2d/ins_pose", 1000);
     local_vel_pub = n.advertise<geometry_msgs::Vector3>("/vectornav/ins_2d/local_vel", 1000);
     NED_pose_pub = n.advertise<geometry_msgs::Pose2D>("/vectornav/ins_2d/NED_pose", 1000);
@@ -158,6 +213,10 @@ int main(int argc, char *argv[])
     string SensorPort;
     int SensorBaudrate;
     int async_output_rate;
+    bool persist_configuration;
+    string baud_cache_file;
+    int reconnect_missed_periods;
+    int io_cpu;
 
     // Sensor IMURATE (800Hz by default, used to configure device)
     int SensorImuRate;
@@ -171,6 +230,10 @@ int main(int argc, char *argv[])
     pn.param<std::string>("serial_port", SensorPort, "/dev/ttyUSB0");
     pn.param<int>("serial_baud", SensorBaudrate, 921600);
     pn.param<int>("fixed_imu_rate", SensorImuRate, 800);
+    pn.param<bool>("persist_configuration", persist_configuration, false);
+    pn.param<std::string>("baud_cache_file", baud_cache_file, "/tmp/vectornav_baud");
+    pn.param<int>("reconnect_missed_periods", reconnect_missed_periods, 20);
+    pn.param<int>("io_cpu", io_cpu, -1);
 
     //Call to set covariances
     if(pn.getParam("linear_accel_covariance",rpc_temp))
@@ -191,51 +254,43 @@ int main(int argc, char *argv[])
     // Create a VnSensor object and connect to sensor
     VnSensor vs;
 
-    // Default baudrate variable
-    int defaultBaudrate;
-    // Run through all of the acceptable baud rates until we are connected
-    // Looping in case someone has changed the default
-    bool baudSet = false;
-    while(!baudSet){
-        // Make this variable only accessible in the while loop
-        static int i = 0;
-        defaultBaudrate = vs.supportedBaudrates()[i];
-        ROS_INFO("Connecting with default at %d", defaultBaudrate);
-        // Default response was too low and retransmit time was too long by default.
-        // They would cause errors
-        vs.setResponseTimeoutMs(1000); // Wait for up to 1000 ms for response
-        vs.setRetransmitDelayMs(50);  // Retransmit every 50 ms
-
-        // Acceptable baud rates 9600, 19200, 38400, 57600, 128000, 115200, 230400, 460800, 921600
-        // Data sheet says 128000 is a valid baud rate. It doesn't work with the VN100 so it is excluded.
-        // All other values seem to work fine.
-        try{
-            // Connect to sensor at it's default rate
-            if(defaultBaudrate != 128000 && SensorBaudrate != 128000)
-            {
-                vs.connect(SensorPort, defaultBaudrate);
-                // Issues a change baudrate to the VectorNav sensor and then
-                // reconnects the attached serial port at the new baudrate.
-                vs.changeBaudRate(SensorBaudrate);
-                // Only makes it here once we have the default correct
-                ROS_INFO("Connected baud rate is %d",vs.baudrate());
-                baudSet = true;
-            }
-        }
-        // Catch all oddities
-        catch(...){
-            // Disconnect if we had the wrong default and we were connected
-            vs.disconnect();
-            ros::Duration(0.2).sleep();
-        }
-        // Increment the default iterator
-        i++;
-        // There are only 9 available data rates, if no connection
-        // made yet possibly a hardware malfunction?
-        if(i > 8)
+    // Default response was too low and retransmit time was too long by default.
+    // They would cause errors
+    vs.setResponseTimeoutMs(1000); // Wait for up to 1000 ms for response
+    vs.setRetransmitDelayMs(50);  // Retransmit every 50 ms
+
+    // Optionally service the serial port from a hub thread pinned to one CPU
+    // instead of the port's own thread. Declared after vs so it is destroyed
+    // first, which hands the port back to the sensor.
+    std::unique_ptr<SensorHub> io_hub;
+    if (io_cpu >= 0)
+    {
+        io_hub.reset(new SensorHub(1, io_cpu));
+        io_hub->add(vs);
+        ROS_INFO("Serial I/O pinned to CPU %d", io_cpu);
+    }
+
+    // Find the sensor at whatever baud rate it is using. The last known baud
+    // rate is cached so a restart normally reconnects on the first attempt.
+    // Acceptable baud rates 9600, 19200, 38400, 57600, 128000, 115200, 230400, 460800, 921600
+    // Data sheet says 128000 is a valid baud rate. It doesn't work with the VN100 so it is excluded.
+    // All other values seem to work fine.
+    try{
+        ros::WallTime connect_start = ros::WallTime::now();
+        int foundBaudrate = vs.connectFast(SensorPort, baud_cache_file, SensorBaudrate);
+        ROS_INFO("Found device at %d baud in %.0f ms", foundBaudrate, (ros::WallTime::now() - connect_start).toSec() * 1000.0);
+
+        // Issues a change baudrate to the VectorNav sensor and then
+        // reconnects the attached serial port at the new baudrate.
+        if(foundBaudrate != SensorBaudrate && SensorBaudrate != 128000)
         {
-            break;
+            vs.changeBaudRate(SensorBaudrate);
         }
+        ROS_INFO("Connected baud rate is %d",vs.baudrate());
+    }
+    // Catch all oddities
+    catch(const std::exception &e){
+        ROS_ERROR("Could not connect to device: %s", e.what());
     }
 
     // Now we verify connection (Should be good if we made it this far)
@@ -248,6 +303,11 @@ int main(int argc, char *argv[])
         ROS_WARN("9600, 19200, 38400, 57600, 115200, 128000, 230400, 460800, 921600");
         ROS_WARN("With the test IMU 128000 did not work, all others worked fine.");
     }
+    // Pause the sensor's output while we query and configure it so command
+    // responses don't have to compete with the data stream. Output resumes
+    // when the session ends, also if configuring fails.
+    ConfigurationSession config_session(vs);
+
     // Query the sensor's model number.
     string mn = vs.readModelNumber();
     string fv = vs.readFirmwareVersion();
@@ -260,14 +320,20 @@ int main(int argc, char *argv[])
     UserData user_data;
     user_data.device_family = vs.determineDeviceFamily();
 
+    // Build the desired sensor configuration. Only registers that differ
+    // from the sensor's current values are written.
+    ConfigurationProfile profile;
+    profile.setPersist(persist_configuration);
+
     // Set Data output Freq [Hz]
-    vs.writeAsyncDataOutputFrequency(async_output_rate);
+    profile.setAsyncDataOutputFrequency(async_output_rate);
 
     // Configure binary output message
     BinaryOutputRegister bor(
             ASYNCMODE_PORT1,
             SensorImuRate / async_output_rate,  // update rate [ms]
-            COMMONGROUP_QUATERNION
+            COMMONGROUP_TIMESTARTUP
+            | COMMONGROUP_QUATERNION
             | COMMONGROUP_YAWPITCHROLL
             | COMMONGROUP_ANGULARRATE
             | COMMONGROUP_POSITION
@@ -290,11 +356,106 @@ int main(int argc, char *argv[])
             | INSGROUP_VELU,
             GPSGROUP_NONE);
 
-    vs.writeBinaryOutput1(bor);
+    profile.setBinaryOutput(1, bor);
 
-    // Set Data output Freq [Hz]
-    vs.writeAsyncDataOutputFrequency(async_output_rate);
-    vs.registerAsyncPacketReceivedHandler(&user_data, BinaryAsyncMessageReceived);
+    // Any additional registers from the params
+    if(pn.getParam("sensor_registers", rpc_temp))
+    {
+        addRegisters(rpc_temp, profile);
+    }
+
+    ConfigurationResult config = vs.applyConfiguration(profile);
+    ROS_INFO("Sensor configuration applied in %.1f ms (read %.1f ms, write %.1f ms), %d of %d registers changed%s",
+        config.elapsedMs, config.readMs, config.writeMs,
+        (int)config.changedRegisters.size(), (int)profile.entries().size(),
+        config.settingsWritten ? ", settings saved" : "");
+
+    try
+    {
+        config_session.resume();
+    }
+    catch(const std::exception &e)
+    {
+        // Try once more; the session makes a last attempt when it ends.
+        ROS_WARN("Could not resume sensor output, retrying: %s", e.what());
+
+        try
+        {
+            config_session.resume();
+        }
+        catch(const std::exception &e)
+        {
+            ROS_ERROR("Could not resume sensor output, no data will be published: %s", e.what());
+        }
+    }
+
+    // Gaps are found from the TimeStartup interval between packets, so give
+    // the detector the period the binary output was configured for.
+    {
+        int rate_divisor = SensorImuRate / async_output_rate;
+        std::lock_guard<std::mutex> lock(gap_detector_mutex);
+        gap_detector = GapDetector(1000000000ULL * (rate_divisor > 0 ? rate_divisor : 1) / SensorImuRate);
+    }
+
+    // Only the packets of the binary output configured above reach the
+    // publisher; other subscribers can be added alongside it.
+    size_t publisher_subscription = vs.subscribeAsyncPackets(BinaryAsyncMessageReceived, &user_data,
+        VnSensor::AsyncPacketFilter::binary(bor));
+
+    // Reopen the port and restore the configuration if the device stops
+    // sending or its port disappears, e.g. when the USB cable is unplugged.
+    if (reconnect_missed_periods > 0)
+    {
+        // Rates above 1 kHz would round the period down to 0 ms.
+        int period_ms = 1000 / async_output_rate;
+        vs.enableSupervisor(period_ms > 0 ? period_ms : 1, reconnect_missed_periods, profile, SensorReconnected);
+    }
+
+    // Periodically report line errors and gaps in the sensor's counters.
+    GapDetector::Statistics last_gaps;
+    uint32_t last_line_sample = 0;
+    ros::Timer link_stats_timer = n.createTimer(ros::Duration(1.0),
+        [&vs, &last_gaps, &last_line_sample](const ros::TimerEvent&)
+        {
+            GapDetector::Statistics gaps;
+            uint64_t period_ns;
+            {
+                std::lock_guard<std::mutex> lock(gap_detector_mutex);
+                gaps = gap_detector.statistics();
+                period_ns = gap_detector.periodNs();
+            }
+
+            if (gaps.missingPackets != last_gaps.missingPackets)
+            {
+                ROS_WARN("Missing packets from sensor: %llu (TimeStartup, %.3f ms period)",
+                    (unsigned long long) (gaps.missingPackets - last_gaps.missingPackets), period_ns / 1e6);
+            }
+
+            // SyncInCnt counts SyncIn edges rather than packets, so skipped
+            // values are only worth noting when SyncIn is wired.
+            if (gaps.missingSyncInCnts != last_gaps.missingSyncInCnts)
+            {
+                ROS_DEBUG("SyncIn: %llu more edges than packets",
+                    (unsigned long long) (gaps.missingSyncInCnts - last_gaps.missingSyncInCnts));
+            }
+            last_gaps = gaps;
+
+            try
+            {
+                SerialPort::LineStatistics ls = vs.lineStatistics();
+
+                if (ls.numOfSamples != last_line_sample && ls.delta.hasErrors())
+                {
+                    ROS_WARN("Serial line errors: overrun %u, buffer overrun %u, frame %u, parity %u, break %u",
+                        ls.delta.overrun, ls.delta.bufOverrun, ls.delta.frame, ls.delta.parity, ls.delta.brk);
+                }
+                last_line_sample = ls.numOfSamples;
+            }
+            catch (...)
+            {
+                // Line counters are not available for this port.
+            }
+        });
 
     // You spin me right round, baby
     // Right round like a record, baby
@@ -305,10 +466,14 @@ int main(int argc, char *argv[])
     }
 
     // Node has been terminated
-    vs.unregisterAsyncPacketReceivedHandler();
+    vs.disableSupervisor();
+    vs.unsubscribeAsyncPackets(publisher_subscription);
     ros::Duration(0.5).sleep();
     ROS_INFO ("Unregisted the Packet Received Handler");
-    vs.disconnect();
+    if (vs.isConnected())
+    {
+        vs.disconnect();
+    }
     ros::Duration(0.5).sleep();
     ROS_INFO ("%s is disconnected successfully", mn.c_str());
     return 0;
@@ -317,14 +482,39 @@ int main(int argc, char *argv[])
 //
 // Callback function to process data packet from sensor
 //
-void BinaryAsyncMessageReceived(void* userData, Packet& p, size_t index)
+void BinaryAsyncMessageReceived(void* userData, Packet& p, size_t index, TimeStamp timestamp)
 {
     vn::sensors::CompositeData cd = vn::sensors::CompositeData::parse(p);
     UserData user_data = *static_cast<UserData*>(userData);
 
+    {
+        std::lock_guard<std::mutex> lock(gap_detector_mutex);
+        gap_detector.process(cd);
+    }
+
+    TimeStamp sample_time;
+    if (sensor_reconnected.exchange(false))
+        clock_sync.reset();
+
+    if (clock_sync.process(cd, timestamp, sample_time))
+    {
+        if (clock_sync.isSynchronized())
+            ROS_INFO_ONCE("Synchronized to sensor clock, host drift %.2f ppm", clock_sync.drift() * 1e6);
+
+        // The ins_2d messages have no header, so the time each packet was
+        // produced is published alongside them, together with the sensor
+        // time it was derived from.
+        sensor_msgs::TimeReference msgTimeRef;
+        msgTimeRef.header.stamp = toRosTime(sample_time);
+        msgTimeRef.header.frame_id = frame_id;
+        msgTimeRef.time_ref.fromNSec(cd.hasTimeStartup() ? cd.timeStartup() : cd.timeGps());
+        msgTimeRef.source = cd.hasTimeStartup() ? "TimeStartup" : "TimeGps";
+        pubTimeRef.publish(msgTimeRef);
+    }
+
     // IMU
     /*sensor_msgs::Imu msgIMU;
-    msgIMU.header.stamp = ros::Time::now();
+    msgIMU.header.stamp = toRosTime(sample_time);
     msgIMU.header.frame_id = frame_id;
 
     if (cd.hasQuaternion() && cd.hasAngularRate() && cd.hasAcceleration())
@@ -598,7 +788,7 @@ void BinaryAsyncMessageReceived(void* userData, Packet& p, size_t index)
 
     // INS
     /*vectornav::Ins msgINS;
-    msgINS.header.stamp = ros::Time::now();
+    msgINS.header.stamp = toRosTime(sample_time);
     msgINS.header.frame_id = frame_id;
 
     if (cd.hasInsStatus())
@@ -683,34 +873,17 @@ void BinaryAsyncMessageReceived(void* userData, Packet& p, size_t index)
             {
                 initial_position_set = true;
                 ROS_WARN("in");
-                double refx = (M_PI / 180)*(lla[0]); //starting latitude in radians
-                double refy = (M_PI / 180)*(lla[1]); //starting longitude in radians
-                Ne = (re) / (pow(1 - (ecc*ecc * sin(refx)*sin(refx)),0.5));
-                Pe_ref << Ne * cos(refx)*cos(refy),
-            			  Ne * cos(refx)*sin(refy),
-			              (Ne*(1 - ecc*ecc)) * sin(refx);
-                Rne << -sin(refx) * cos(refy), -sin(refx) * sin(refy), cos(refx),
-                       -sin(refy), cos(refy), 0,
-                       -cos(refx) * cos(refy), -cos(refx) * sin(refy), -sin(refx);
+                ned_frame = LocalTangentPlane(lla);
                 ins_ref.x = lla[0];
                 ins_ref.y = lla[1];
                 ins_ref.theta = (M_PI / 180)*(rpy[0]);
-                ecef_ref.x = Pe_ref(0);
-                ecef_ref.y = Pe_ref(1);
-                ecef_ref.z = Pe_ref(2);
+                toMsg(ned_frame.referenceEcef(), ecef_ref);
             }
-        lat_radians = (M_PI / 180)*(lla[0]);
-        lon_radians = (M_PI / 180)*(lla[1]);
-        Ne = (re) / (pow(1 - (ecc*ecc * sin(lat_radians)*sin(lat_radians)),0.5));
-        Pe << Ne * cos(lat_radians)*cos(lon_radians),
-			  Ne * cos(lat_radians)*sin(lon_radians),
-              (Ne*(1 - ecc*ecc)) * sin(lat_radians);
-        ECEF_pose.x = Pe(0);
-        ECEF_pose.y = Pe(1);
-        ECEF_pose.z = Pe(2);
-        NED = Rne * (Pe - Pe_ref);
-        NED_pose.x = NED(0);
-        NED_pose.y = NED(1);
+        vec3d pe = lla2ecef(lla);
+        vec3d ned = ned_frame.ecef2ned(pe);
+        toMsg(pe, ECEF_pose);
+        NED_pose.x = ned[0];
+        NED_pose.y = ned[1];
         ins_pose.x = lla[0];
         ins_pose.y = lla[1];
         ins_pose.theta = (M_PI / 180)*(rpy[0]);
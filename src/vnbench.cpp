@@ -0,0 +1,824 @@
+/*
+ * MIT License (MIT)
+ *
+ * Copyright (c) 2018 Dereck Wonnacott <dereck@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+//
+// vnbench - Measures the latency of the library's hot paths.
+//
+// Each benchmark prints the distribution of its samples in microseconds:
+//
+//     vnbench roundtrip --port /tmp/vectornav --count 2000
+//
+// measures register read round trips against a sensor or vnsim, with the
+// sensor's async output left running so responses have to be picked out of
+// the data stream as in normal operation.
+//
+//     vnsim --link /tmp/vectornav --unplug 2
+//     vnbench unplug --port /tmp/vectornav --reconnects 5
+//
+// times the port accessors vnpub polls (lineStatistics, baudrate, port,
+// isConnected) from two threads while the supervisor drops and reopens the
+// port each time vnsim pulls the virtual cable. It fails unless every
+// reconnect happens, and crashes if an accessor uses a port being replaced.
+//
+//     vnbench event --count 10000
+//
+// measures how long a thread sleeping on an xplat::Event takes to run after
+// another thread signals it, and
+//
+//     vnbench lock
+//
+// the cost of entering and leaving an xplat::CriticalSection, alone and with
+// two threads competing for it.
+//
+//     vnbench pool
+//
+// compares running a burst of short jobs on xplat::ThreadPool::shared with
+// starting a thread for each of them, and
+//
+//     vnbench math
+//
+// times the vn::math operations used on every sample, in nanoseconds per
+// operation over arrays small enough to stay in cache. The attitude
+// conversions are timed both one value at a time and through the batch
+// versions in vn/batchconversions.h, and the fused operations next to the
+// expressions they replace and to the same expressions in Eigen, both on
+// Eigen's own types and on views of vn::math types from vn/eigen.h. It
+// first checks products of matrices without a specialization (5x5 and
+// 2x3 by 3x4) against element access, and fails if they disagree.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "vn/sensors.h"
+#include "vn/vntime.h"
+#include "vn/event.h"
+#include "vn/thread.h"
+#include "vn/criticalsection.h"
+#include "vn/threadpool.h"
+#include "vn/matrix.h"
+#include "vn/conversions.h"
+#include "vn/batchconversions.h"
+#include "vn/geodesy.h"
+#include "vn/eigen.h"
+
+#include <eigen3/Eigen/Dense>
+
+using namespace std;
+using namespace vn::sensors;
+using namespace vn::xplat;
+using namespace vn::math;
+
+namespace {
+
+struct Options {
+    string benchmark;
+    string port;
+    uint32_t baud;
+    size_t count;
+    size_t warmup;
+    size_t reconnects;
+
+    Options() :
+        baud(0),
+        count(1000),
+        warmup(50),
+        reconnects(5)
+    { }
+};
+
+void usage()
+{
+    fprintf(stderr,
+        "usage: vnbench BENCHMARK [options]\n"
+        "benchmarks:\n"
+        "  roundtrip              register read round trips (needs --port)\n"
+        "  unplug                 port accessors while the supervisor\n"
+        "                         reconnects (needs --port, vnsim --unplug)\n"
+        "  event                  Event signal to wake latency\n"
+        "  lock                   CriticalSection enter/leave cost\n"
+        "  pool                   burst of jobs on the shared ThreadPool\n"
+        "  math                   vector and matrix operations\n"
+        "options:\n"
+        "  --port PATH            serial port of the sensor or vnsim\n"
+        "  --baud N               baudrate (default: search)\n"
+        "  --count N              number of samples (default 1000)\n"
+        "  --warmup N             samples discarded first (default 50)\n"
+        "  --reconnects N         reconnects to wait for (default 5)\n");
+}
+
+bool parseOptions(int argc, char* argv[], Options& o)
+{
+    if (argc < 2)
+        return false;
+
+    o.benchmark = argv[1];
+
+    for (int i = 2; i < argc; i++) {
+        string a = argv[i];
+
+        if (a == "--help" || a == "-h" || i + 1 >= argc)
+            return false;
+        else if (a == "--port")
+            o.port = argv[++i];
+        else if (a == "--baud")
+            o.baud = strtoul(argv[++i], NULL, 10);
+        else if (a == "--count")
+            o.count = strtoul(argv[++i], NULL, 10);
+        else if (a == "--warmup")
+            o.warmup = strtoul(argv[++i], NULL, 10);
+        else if (a == "--reconnects")
+            o.reconnects = strtoul(argv[++i], NULL, 10);
+        else
+            return false;
+    }
+
+    return o.count > 0;
+}
+
+int64_t nowNs()
+{
+    return TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC).totalNs();
+}
+
+// Prints min, percentiles and max of the samples, by default in
+// microseconds.
+void report(const char* name, vector<double> samples, const char* unit = "us")
+{
+    sort(samples.begin(), samples.end());
+
+    size_t n = samples.size();
+    double sum = 0;
+
+    for (size_t i = 0; i < n; i++)
+        sum += samples[i];
+
+    printf("%-24s n=%-7zu min %9.1f  p50 %9.1f  p90 %9.1f  p99 %9.1f  max %9.1f  mean %9.1f %s\n",
+        name, n, samples[0], samples[n / 2], samples[n * 9 / 10], samples[n * 99 / 100],
+        samples[n - 1], sum / n, unit);
+}
+
+int roundtrip(const Options& o)
+{
+    if (o.port.empty()) {
+        fprintf(stderr, "vnbench: roundtrip needs --port\n");
+        return 1;
+    }
+
+    VnSensor vs;
+
+    if (o.baud != 0)
+        vs.connect(o.port, o.baud);
+    else
+        vs.connectFast(o.port, "");
+
+    vector<double> samples;
+    samples.reserve(o.count);
+
+    for (size_t i = 0; i < o.warmup + o.count; i++) {
+        int64_t start = nowNs();
+        vs.readModelNumber();
+        double us = (nowNs() - start) / 1000.0;
+
+        if (i >= o.warmup)
+            samples.push_back(us);
+    }
+
+    report("roundtrip", samples);
+
+    vs.disconnect();
+
+    return 0;
+}
+
+// Polls the calls vnpub makes from its timers while the supervisor replaces
+// the port underneath them.
+struct PortPoller {
+    VnSensor* sensor;
+    atomic<bool>* done;
+    vector<double> samples;
+    uint64_t unavailable;
+};
+
+void pollPort(void* data)
+{
+    PortPoller* p = static_cast<PortPoller*>(data);
+
+    while (!*p->done) {
+        int64_t start = nowNs();
+
+        try {
+            p->sensor->lineStatistics();
+            p->sensor->baudrate();
+            p->sensor->port();
+        }
+        catch (const exception&) {
+            p->unavailable++;
+        }
+
+        p->sensor->isConnected();
+        p->samples.push_back((nowNs() - start) / 1000.0);
+
+        Thread::sleepUs(100);
+    }
+}
+
+void onReconnected(void* userData, const VnSensor::ReconnectInfo& info)
+{
+    printf("reconnect %llu: %.0f ms outage, %.0f ms to restore\n",
+        (unsigned long long) info.numOfReconnects, info.outageMs, info.reconnectMs);
+
+    static_cast<atomic<size_t>*>(userData)->store(static_cast<size_t>(info.numOfReconnects));
+}
+
+int unplug(const Options& o)
+{
+    if (o.port.empty()) {
+        fprintf(stderr, "vnbench: unplug needs --port\n");
+        return 1;
+    }
+
+    VnSensor vs;
+
+    if (o.baud != 0)
+        vs.connect(o.port, o.baud);
+    else
+        vs.connectFast(o.port, "");
+
+    // The simulated sensor is silent for a moment after each replug while
+    // it boots, so only give up on the stream after a full second.
+    atomic<size_t> reconnects(0);
+    vs.enableSupervisor(100, 10, ConfigurationProfile(), onReconnected, &reconnects);
+
+    atomic<bool> done(false);
+    PortPoller first = { &vs, &done, vector<double>(), 0 };
+    PortPoller second = { &vs, &done, vector<double>(), 0 };
+
+    Thread* t1 = Thread::startNew(pollPort, &first);
+    Thread* t2 = Thread::startNew(pollPort, &second);
+
+    int64_t deadline = nowNs() + static_cast<int64_t>(o.reconnects) * 10000000000LL;
+
+    while (reconnects < o.reconnects && nowNs() < deadline)
+        Thread::sleepMs(50);
+
+    done = true;
+    t1->join();
+    t2->join();
+    delete t1;
+    delete t2;
+
+    vs.disableSupervisor();
+
+    if (vs.isConnected())
+        vs.disconnect();
+
+    vector<double> samples(first.samples);
+    samples.insert(samples.end(), second.samples.begin(), second.samples.end());
+
+    report("port accessors", samples);
+    printf("%zu calls, %llu while unplugged, %zu of %zu reconnects\n", samples.size(),
+        (unsigned long long) (first.unavailable + second.unavailable), reconnects.load(), o.reconnects);
+
+    return reconnects >= o.reconnects ? 0 : 1;
+}
+
+// The main thread signals ping and the waker thread, asleep on it, records
+// how long it took to run and answers on pong.
+struct PingPong {
+    Event ping;
+    Event pong;
+    atomic<int64_t> signaledNs;
+    atomic<bool> done;
+    vector<double> samples;
+
+    PingPong() :
+        signaledNs(0),
+        done(false)
+    { }
+};
+
+void waker(void* data)
+{
+    PingPong* p = static_cast<PingPong*>(data);
+
+    while (true) {
+        p->ping.wait();
+        int64_t wokeNs = nowNs();
+
+        if (p->done)
+            break;
+
+        p->samples.push_back((wokeNs - p->signaledNs) / 1000.0);
+        p->pong.signal();
+    }
+}
+
+int event(const Options& o)
+{
+    PingPong p;
+    p.samples.reserve(o.warmup + o.count);
+
+    Thread* t = Thread::startNew(waker, &p);
+
+    for (size_t i = 0; i < o.warmup + o.count; i++) {
+        // Give the waker time to go to sleep so the wake goes through the
+        // kernel as it does for a response or a new sample.
+        Thread::sleepUs(200);
+
+        p.signaledNs = nowNs();
+        p.ping.signal();
+        p.pong.wait();
+    }
+
+    p.done = true;
+    p.ping.signal();
+    t->join();
+    delete t;
+
+    report("event signal to wake", vector<double>(p.samples.begin() + o.warmup, p.samples.end()));
+
+    return 0;
+}
+
+// Batches of enter/leave pairs on a shared lock, timed per batch.
+const size_t LockBatch = 1000;
+
+struct LockRun {
+    CriticalSection* cs;
+    uint64_t* counter;
+    size_t batches;
+    vector<double> samples;
+};
+
+void lockBatches(void* data)
+{
+    LockRun* r = static_cast<LockRun*>(data);
+
+    for (size_t b = 0; b < r->batches; b++) {
+        int64_t start = nowNs();
+
+        for (size_t i = 0; i < LockBatch; i++) {
+            r->cs->enter();
+            (*r->counter)++;
+            r->cs->leave();
+        }
+
+        r->samples.push_back(static_cast<double>(nowNs() - start) / LockBatch);
+    }
+}
+
+int lock(const Options& o)
+{
+    CriticalSection cs;
+    uint64_t counter = 0;
+
+    LockRun first = { &cs, &counter, o.count, vector<double>() };
+    LockRun second = { &cs, &counter, o.count, vector<double>() };
+
+    Thread* t = Thread::startNew(lockBatches, &second);
+    lockBatches(&first);
+    t->join();
+    delete t;
+
+    first.samples.insert(first.samples.end(), second.samples.begin(), second.samples.end());
+    if (counter != 2 * o.count * LockBatch) {
+        fprintf(stderr, "vnbench: lost updates under the lock\n");
+        return 1;
+    }
+
+    // Measured once a second thread has existed: glibc skips the atomic
+    // operations of a mutex while the process has a single thread, which
+    // no program running a sensor's listener thread ever sees.
+    LockRun alone = { &cs, &counter, o.count, vector<double>() };
+    lockBatches(&alone);
+    report("lock uncontended", alone.samples, "ns");
+    report("lock two threads", first.samples, "ns");
+
+    return 0;
+}
+
+// Number of jobs in a burst, about what a search of every port on a
+// machine starts.
+const size_t PoolBurst = 32;
+
+void poolJob(void* data)
+{
+    static_cast<atomic<size_t>*>(data)->fetch_add(1);
+}
+
+int pool(const Options& o)
+{
+    ThreadPool& p = ThreadPool::shared();
+    atomic<size_t> done(0);
+    vector<double> pooled;
+    vector<double> threads;
+
+    for (size_t i = 0; i < o.warmup + o.count; i++) {
+        int64_t start = nowNs();
+
+        ThreadPool::Batch batch;
+        for (size_t j = 0; j < PoolBurst; j++)
+            p.submit(poolJob, &done, &batch);
+        p.wait(batch);
+
+        if (i >= o.warmup)
+            pooled.push_back((nowNs() - start) / 1000.0);
+    }
+
+    for (size_t i = 0; i < o.warmup + o.count; i++) {
+        int64_t start = nowNs();
+
+        vector<Thread*> started;
+        for (size_t j = 0; j < PoolBurst; j++)
+            started.push_back(Thread::startNew(poolJob, &done));
+
+        for (size_t j = 0; j < started.size(); j++) {
+            started[j]->join();
+            delete started[j];
+        }
+
+        if (i >= o.warmup)
+            threads.push_back((nowNs() - start) / 1000.0);
+    }
+
+    printf("%zu jobs per burst, %zu pool threads\n", PoolBurst, p.numOfThreads());
+    report("pool burst", pooled);
+    report("thread per job burst", threads);
+
+    return done == 2 * (o.warmup + o.count) * PoolBurst ? 0 : 1;
+}
+
+// Number of operands per pass of a math benchmark.
+const size_t MathSize = 1024;
+
+struct MathData {
+    vector<mat3f> m3f;
+    vector<mat3d> m3d;
+    vector<vec3f> v3f;
+    vector<vec3d> v3d;
+    vector<vec4f> v4f;
+    vector<vec3d> lla;
+    vector<vec3d> ecef;
+    LocalTangentPlane ned;
+
+    vector<Eigen::Matrix3f> em3f;
+    vector<Eigen::Matrix3d> em3d;
+    vector<Eigen::Vector3f> ev3f;
+    vector<Eigen::Vector3d> ev3d;
+    vector<Eigen::Quaternionf, Eigen::aligned_allocator<Eigen::Quaternionf> > eq;
+
+    vector<mat3f> outM3f;
+    vector<mat3d> outM3d;
+    vector<vec3f> outV3f;
+    vector<vec3d> outV3d;
+    vector<vec4f> outV4f;
+    vector<float> outF;
+
+    vector<Eigen::Matrix3f> outEm3f;
+    vector<Eigen::Vector3f> outEv3f;
+    vector<Eigen::Vector3d> outEv3d;
+
+    MathData() :
+        m3f(MathSize), m3d(MathSize), v3f(MathSize), v3d(MathSize), v4f(MathSize),
+        lla(MathSize), ecef(MathSize), ned(vec3d(45.5, -73.6, 30)),
+        em3f(MathSize), em3d(MathSize), ev3f(MathSize), ev3d(MathSize), eq(MathSize),
+        outM3f(MathSize), outM3d(MathSize), outV3f(MathSize), outV3d(MathSize),
+        outV4f(MathSize), outF(MathSize),
+        outEm3f(MathSize), outEv3f(MathSize), outEv3d(MathSize)
+    {
+        for (size_t i = 0; i < MathSize; i++) {
+            m3f[i] = yprInDegs2Dcm(vec3f(i * 0.35f, i * 0.17f - 90, i * 0.29f - 180));
+
+            for (size_t j = 0; j < 9; j++)
+                m3d[i].e[j] = m3f[i].e[j];
+
+            v3f[i] = vec3f(i * 0.01f, 9.81f, -0.5f);
+            v3d[i] = vec3d(i * 0.01, 9.81, -0.5);
+            v4f[i] = vec4f(0.1f, -0.2f, i * 0.001f, 0.97f).norm();
+            lla[i] = vec3d(45.5 + i * 1e-5, -73.6 + i * 1e-5, 30 + i * 0.01);
+            ecef[i] = lla2ecef(lla[i]);
+
+            em3f[i] = toEigen(m3f[i]);
+            em3d[i] = toEigen(m3d[i]);
+            ev3f[i] = toEigen(v3f[i]);
+            ev3d[i] = toEigen(v3d[i]);
+            eq[i] = toEigenQuaternion(v4f[i]);
+        }
+    }
+};
+
+void mat3fTimesVec3f(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3f[i] = d.m3f[i] * d.v3f[i];
+}
+
+void mat3dTimesVec3d(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3d[i] = d.m3d[i] * d.v3d[i];
+}
+
+void mat3fTimesMat3f(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outM3f[i] = d.m3f[i] * d.m3f[MathSize - 1 - i];
+}
+
+void mat3dTimesMat3d(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outM3d[i] = d.m3d[i] * d.m3d[MathSize - 1 - i];
+}
+
+void mat3fTranspose(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outM3f[i] = d.m3f[i].transpose();
+}
+
+void vec3fCross(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3f[i] = d.v3f[i].cross(d.v3f[MathSize - 1 - i]);
+}
+
+void vec4fDot(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outF[i] = d.v4f[i].dot(d.v4f[MathSize - 1 - i]);
+}
+
+void vec4fNorm(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV4f[i] = d.v4f[i].norm();
+}
+
+void quat2Ypr(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3f[i] = quat2YprInDegs(d.v4f[i]);
+}
+
+void quat2YprBatch(MathData& d)
+{
+    quat2YprInDegs(&d.v4f[0], &d.outV3f[0], MathSize);
+}
+
+void ypr2Quat(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV4f[i] = yprInDegs2Quat(d.v3f[i]);
+}
+
+void ypr2QuatBatch(MathData& d)
+{
+    yprInDegs2Quat(&d.v3f[0], &d.outV4f[0], MathSize);
+}
+
+void ypr2Dcm(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outM3f[i] = yprInDegs2Dcm(d.v3f[i]);
+}
+
+void ypr2DcmBatch(MathData& d)
+{
+    yprInDegs2Dcm(&d.v3f[0], &d.outM3f[0], MathSize);
+}
+
+void mat3dTimesDifference(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3d[i] = d.m3d[i] * (d.v3d[i] - d.v3d[MathSize - 1 - i]);
+}
+
+void mat3dMultDifference(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3d[i] = d.m3d[i].multDifference(d.v3d[i], d.v3d[MathSize - 1 - i]);
+}
+
+void eigenTimesDifference(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outEv3d[i] = d.em3d[i] * (d.ev3d[i] - d.ev3d[MathSize - 1 - i]);
+}
+
+void eigenViewTimesDifference(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        toEigen(d.outV3d[i]) = toEigen(d.m3d[i]) * (toEigen(d.v3d[i]) - toEigen(d.v3d[MathSize - 1 - i]));
+}
+
+void quat2DcmTimesVec3f(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3f[i] = quat2dcm(d.v4f[i]) * d.v3f[i];
+}
+
+void quatRotateVec3f(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3f[i] = quatRotate(d.v4f[i], d.v3f[i]);
+}
+
+void eigenQuatRotate(MathData& d)
+{
+    // quatRotate is the rotation by the conjugate in Eigen's convention.
+    for (size_t i = 0; i < MathSize; i++)
+        d.outEv3f[i] = d.eq[i].conjugate() * d.ev3f[i];
+}
+
+void mat3fTransposeTimes(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outM3f[i] = d.m3f[i].transpose() * d.m3f[MathSize - 1 - i];
+}
+
+void mat3fTransposeMult(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outM3f[i] = d.m3f[i].transposeMult(d.m3f[MathSize - 1 - i]);
+}
+
+void eigenTransposeTimes(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outEm3f[i].noalias() = d.em3f[i].transpose() * d.em3f[MathSize - 1 - i];
+}
+
+void llaToEcef(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3d[i] = lla2ecef(d.lla[i]);
+}
+
+void ecefToLla(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3d[i] = ecef2lla(d.ecef[i]);
+}
+
+void llaToNed(MathData& d)
+{
+    for (size_t i = 0; i < MathSize; i++)
+        d.outV3d[i] = d.ned.lla2ned(d.lla[i]);
+}
+
+// Checks the generic matrix product against one computed through element
+// access, so the two agree on how elements are stored.
+template<size_t m, size_t n, size_t s>
+bool checkProduct()
+{
+    mat<m, n, double> a;
+    mat<n, s, double> b;
+
+    for (size_t row = 0; row < m; row++)
+        for (size_t col = 0; col < n; col++)
+            a(row, col) = static_cast<double>(row * n + col + 1);
+
+    for (size_t row = 0; row < n; row++)
+        for (size_t col = 0; col < s; col++)
+            b(row, col) = static_cast<double>(row) - static_cast<double>(2 * col);
+
+    mat<m, s, double> p = a * b;
+
+    for (size_t row = 0; row < m; row++) {
+        for (size_t col = 0; col < s; col++) {
+            double expected = 0;
+
+            for (size_t k = 0; k < n; k++)
+                expected += a(row, k) * b(k, col);
+
+            if (p(row, col) != expected) {
+                fprintf(stderr, "vnbench: %zux%zu * %zux%zu product is %g at (%zu, %zu), expected %g\n",
+                    m, n, n, s, p(row, col), row, col, expected);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+struct MathBenchmark {
+    const char* name;
+    void (*run)(MathData&);
+};
+
+int math(const Options& o)
+{
+    const MathBenchmark benchmarks[] = {
+        { "mat3f * vec3f", mat3fTimesVec3f },
+        { "mat3d * vec3d", mat3dTimesVec3d },
+        { "mat3f * mat3f", mat3fTimesMat3f },
+        { "mat3d * mat3d", mat3dTimesMat3d },
+        { "mat3f transpose", mat3fTranspose },
+        { "vec3f cross", vec3fCross },
+        { "vec4f dot", vec4fDot },
+        { "vec4f norm", vec4fNorm },
+        { "quat2YprInDegs", quat2Ypr },
+        { "quat2YprInDegs batch", quat2YprBatch },
+        { "yprInDegs2Quat", ypr2Quat },
+        { "yprInDegs2Quat batch", ypr2QuatBatch },
+        { "yprInDegs2Dcm", ypr2Dcm },
+        { "yprInDegs2Dcm batch", ypr2DcmBatch },
+        { "mat3d * (a - b)", mat3dTimesDifference },
+        { "mat3d multDifference", mat3dMultDifference },
+        { "Eigen R * (a - b)", eigenTimesDifference },
+        { "Eigen view R * (a - b)", eigenViewTimesDifference },
+        { "quat2dcm(q) * vec3f", quat2DcmTimesVec3f },
+        { "quatRotate", quatRotateVec3f },
+        { "Eigen q * v", eigenQuatRotate },
+        { "mat3f transpose() * m", mat3fTransposeTimes },
+        { "mat3f transposeMult", mat3fTransposeMult },
+        { "Eigen R^T * M", eigenTransposeTimes },
+        { "lla2ecef", llaToEcef },
+        { "ecef2lla", ecefToLla },
+        { "lla2ned", llaToNed }
+    };
+
+    if (!checkProduct<5, 5, 5>() || !checkProduct<2, 3, 4>())
+        return 1;
+
+    MathData d;
+
+    for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+        vector<double> samples;
+
+        for (size_t i = 0; i < o.warmup + o.count; i++) {
+            int64_t start = nowNs();
+            benchmarks[b].run(d);
+
+            if (i >= o.warmup)
+                samples.push_back(static_cast<double>(nowNs() - start) / MathSize);
+        }
+
+        report(benchmarks[b].name, samples, "ns");
+    }
+
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    try {
+        if (options.benchmark == "roundtrip")
+            return roundtrip(options);
+        else if (options.benchmark == "unplug")
+            return unplug(options);
+        else if (options.benchmark == "event")
+            return event(options);
+        else if (options.benchmark == "lock")
+            return lock(options);
+        else if (options.benchmark == "pool")
+            return pool(options);
+        else if (options.benchmark == "math")
+            return math(options);
+    }
+    catch (const exception& e) {
+        fprintf(stderr, "vnbench: %s\n", e.what());
+        return 1;
+    }
+
+    usage();
+    return 1;
+}
@@ -0,0 +1,1230 @@
+/*
+ * MIT License (MIT)
+ *
+ * Copyright (c) 2018 Dereck Wonnacott <dereck@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+//
+// vnsim - Simulates a VectorNav sensor on a pseudo-terminal.
+//
+// The simulator opens a pty pair, prints the slave device name and then
+// behaves like a sensor connected to it: it answers register reads and writes
+// ($VNRRG/$VNWRG) from a register model, honours $VNWNV, $VNRFS, $VNRST and
+// $VNASY, and streams ASCII and binary asynchronous output generated from a
+// smooth synthetic trajectory. Binary packets carry a valid CRC and follow
+// the binary output registers (75-77), so the library and vnpub run against
+// it unmodified:
+//
+//     rosrun vectornav vnsim --link /tmp/vectornav
+//     roslaunch vectornav vectornav.launch  (with serial_port: /tmp/vectornav)
+//
+// Unless --ignore-baud is given, output is only delivered while the host's
+// termios baudrate matches the simulated sensor's, and output that would not
+// fit on a real line at that baudrate is dropped, so baudrate negotiation and
+// link saturation behave like real hardware.
+//
+// --unplug pulls the virtual cable at intervals: the pty and the link go
+// away and come back later with the sensor freshly reset, so reconnect
+// handling can be exercised without hardware.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "vn/error_detection.h"
+#include "vn/packet.h"
+#include "vn/types.h"
+
+using namespace std;
+using namespace vn::protocol::uart;
+using namespace vn::data::integrity;
+
+namespace {
+
+const double kGravity = 9.80665;
+const double kWgs84A = 6378137.0;
+const double kWgs84E2 = 6.69437999014e-3;
+const double kDegToRad = M_PI / 180.0;
+
+volatile sig_atomic_t keep_running = 1;
+
+void onSignal(int)
+{
+    keep_running = 0;
+}
+
+double monotonicSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct Options {
+    double imu_rate = 800.0;
+    uint32_t baud = 115200;
+    double noise = 0.0;
+    double corrupt = 0.0;
+    double drop = 0.0;
+    double duration = 0.0;
+    double unplug_every = 0.0;
+    double unplug_for = 1.0;
+    bool ignore_baud = false;
+    bool throttle = true;
+    string link;
+    string model = "VN-300T-CR";
+    double latitude = 25.6515;
+    double longitude = -100.2895;
+    double altitude = 540.0;
+    string binary_output[3];
+};
+
+struct Stats {
+    uint64_t binary_packets = 0;
+    uint64_t ascii_packets = 0;
+    uint64_t responses = 0;
+    uint64_t dropped_random = 0;
+    uint64_t dropped_line = 0;
+    uint64_t dropped_baud = 0;
+    uint64_t dropped_blocked = 0;
+    uint64_t corrupted = 0;
+    uint64_t unplugs = 0;
+};
+
+// Synthetic sensor state at a point in time. Angles in degrees, rates in
+// rad/s, everything else in SI units or gauss.
+struct State {
+    double time_startup;
+    double ypr[3];
+    double quat[4];
+    double dcm[3][3];
+    double gyro[3];
+    double accel[3];
+    double mag[3];
+    double lla[3];
+    double ecef[3];
+    double vel_ned[3];
+    double vel_body[3];
+};
+
+void usage()
+{
+    fprintf(stderr,
+        "usage: vnsim [options]\n"
+        "  --link PATH            create a symlink to the pty slave\n"
+        "  --model NAME           model number reported (default VN-300T-CR)\n"
+        "  --baud N               initial sensor baudrate (default 115200)\n"
+        "  --imu-rate HZ          internal sample rate (default 800)\n"
+        "  --binary-output{1,2,3} VALUE\n"
+        "                         initial binary output register value, e.g.\n"
+        "                         1,1,01,1029 (async mode, rate divisor, groups,\n"
+        "                         fields in hex)\n"
+        "  --noise SCALE          add sensor noise (1 = typical MEMS grade)\n"
+        "  --corrupt P            corrupt a byte of a packet with probability P\n"
+        "  --drop P               drop a packet with probability P\n"
+        "  --lla LAT,LON,ALT      reference position\n"
+        "  --duration SEC         exit after SEC seconds\n"
+        "  --unplug SEC[,DOWN]    every SEC seconds remove the pty and the link\n"
+        "                         as if the cable was pulled, and bring them\n"
+        "                         back with the sensor reset after DOWN seconds\n"
+        "                         (default 1)\n"
+        "  --ignore-baud          deliver output whatever the host baudrate\n"
+        "  --no-throttle          do not limit output to the line capacity\n");
+}
+
+bool parseOptions(int argc, char* argv[], Options& o)
+{
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (a == "--ignore-baud")
+            o.ignore_baud = true;
+        else if (a == "--no-throttle")
+            o.throttle = false;
+        else if (a == "--help" || a == "-h")
+            return false;
+        else if (!has_value)
+            return false;
+        else if (a == "--link")
+            o.link = argv[++i];
+        else if (a == "--model")
+            o.model = argv[++i];
+        else if (a == "--baud")
+            o.baud = strtoul(argv[++i], NULL, 10);
+        else if (a == "--imu-rate")
+            o.imu_rate = atof(argv[++i]);
+        else if (a == "--noise")
+            o.noise = atof(argv[++i]);
+        else if (a == "--corrupt")
+            o.corrupt = atof(argv[++i]);
+        else if (a == "--drop")
+            o.drop = atof(argv[++i]);
+        else if (a == "--duration")
+            o.duration = atof(argv[++i]);
+        else if (a == "--unplug") {
+            int n = sscanf(argv[++i], "%lf,%lf", &o.unplug_every, &o.unplug_for);
+            if (n < 1 || o.unplug_every <= 0 || o.unplug_for < 0)
+                return false;
+        }
+        else if (a == "--lla") {
+            if (sscanf(argv[++i], "%lf,%lf,%lf", &o.latitude, &o.longitude, &o.altitude) != 3)
+                return false;
+        }
+        else if (a.compare(0, 15, "--binary-output") == 0 && a.size() == 16 && a[15] >= '1' && a[15] <= '3')
+            o.binary_output[a[15] - '1'] = argv[++i];
+        else
+            return false;
+    }
+
+    return o.imu_rate > 0;
+}
+
+uint32_t speedToBaud(speed_t s)
+{
+    switch (s) {
+        case B9600: return 9600;
+        case B19200: return 19200;
+        case B38400: return 38400;
+        case B57600: return 57600;
+        case B115200: return 115200;
+        case B230400: return 230400;
+        case B460800: return 460800;
+        case B921600: return 921600;
+        default: return 0;
+    }
+}
+
+bool isSupportedBaud(uint32_t baud)
+{
+    static const uint32_t supported[] = { 9600, 19200, 38400, 57600, 115200, 128000, 230400, 460800, 921600 };
+
+    for (size_t i = 0; i < sizeof(supported) / sizeof(supported[0]); i++)
+        if (supported[i] == baud)
+            return true;
+
+    return false;
+}
+
+vector<string> split(const string& s)
+{
+    vector<string> out;
+    size_t start = 0;
+
+    while (true) {
+        size_t comma = s.find(',', start);
+        out.push_back(s.substr(start, comma - start));
+        if (comma == string::npos)
+            break;
+        start = comma + 1;
+    }
+
+    return out;
+}
+
+// Configuration held by one of the binary output registers.
+struct BinaryOutput {
+    uint16_t async_mode = 0;
+    uint16_t rate_divisor = 0;
+    uint8_t groups = 0;
+    uint16_t fields[6] = { 0, 0, 0, 0, 0, 0 };
+
+    bool enabled() const { return async_mode != 0 && rate_divisor != 0 && groups != 0; }
+};
+
+// Parses a binary output register value. Only the groups the library can
+// parse (1 through 6) and fields it knows the size of are accepted.
+bool parseBinaryOutput(const string& value, BinaryOutput& bo)
+{
+    vector<string> f = split(value);
+    if (f.size() < 3)
+        return false;
+
+    BinaryOutput r;
+    r.async_mode = strtoul(f[0].c_str(), NULL, 10);
+    r.rate_divisor = strtoul(f[1].c_str(), NULL, 10);
+    unsigned long groups = strtoul(f[2].c_str(), NULL, 16);
+
+    if (r.async_mode > 3 || groups > 0x3F)
+        return false;
+
+    r.groups = static_cast<uint8_t>(groups);
+
+    size_t next = 3;
+    for (int g = 0; g < 6; g++) {
+        if (!(r.groups & (1 << g)))
+            continue;
+
+        if (next >= f.size())
+            return false;
+
+        r.fields[g] = strtoul(f[next++].c_str(), NULL, 16);
+
+        for (int b = 0; b < 16; b++)
+            if ((r.fields[g] & (1 << b)) && (b >= 15 || Packet::BinaryGroupLengths[g][b] == 0))
+                return false;
+    }
+
+    if (next != f.size())
+        return false;
+
+    bo = r;
+    return true;
+}
+
+// Register contents stored as the comma separated fields of their ASCII
+// responses.
+class RegisterModel {
+public:
+    explicit RegisterModel(const Options& o) : options_(o)
+    {
+        restoreFactorySettings();
+        saved_ = regs_;
+    }
+
+    void restoreFactorySettings()
+    {
+        char buf[32];
+
+        regs_.clear();
+        regs_[0] = "";
+        regs_[1] = options_.model;
+        regs_[2] = "1";
+        regs_[3] = "100000001";
+        regs_[4] = "2.1.0.0";
+        snprintf(buf, sizeof(buf), "%u", options_.baud);
+        regs_[5] = buf;
+        regs_[6] = "14";
+        regs_[7] = "40";
+        regs_[21] = "1.0000,0.0000,1.8000,0.0000,0.0000,-9.7930";
+        regs_[26] = "1,0,0,0,1,0,0,0,1";
+        regs_[30] = "0,0,0,0,1,0,1";
+        regs_[32] = "3,0,0,0,6,1,0,100000000,0";
+        regs_[35] = "1,1,1,1";
+
+        for (int i = 0; i < 3; i++) {
+            BinaryOutput bo;
+            if (!options_.binary_output[i].empty() && parseBinaryOutput(options_.binary_output[i], bo))
+                regs_[75 + i] = options_.binary_output[i];
+            else
+                regs_[75 + i] = "0,0,0";
+        }
+    }
+
+    void saveSettings() { saved_ = regs_; }
+
+    void loadSavedSettings() { regs_ = saved_; }
+
+    bool has(int id) const { return regs_.count(id) != 0; }
+
+    const string& get(int id) const { return regs_.find(id)->second; }
+
+    // Validates and stores a register write.
+    SensorError write(int id, const string& value)
+    {
+        if (!has(id) && id != 8 && id != 9)
+            return ERR_INVALID_REGISTER;
+
+        if ((id >= 1 && id <= 4) || id == 8 || id == 9)
+            return ERR_UNAUTHORIZED_ACCESS;
+
+        vector<string> f = split(value);
+
+        if (id != 0 && f.size() < split(get(id)).size() && !(id >= 75 && id <= 77))
+            return ERR_NOT_ENOUGH_PARAMETERS;
+
+        if (id == 5) {
+            // The optional second field selects the serial port.
+            if (!isSupportedBaud(strtoul(f[0].c_str(), NULL, 10)))
+                return ERR_INVALID_PARAMETER;
+            regs_[id] = f[0];
+            return static_cast<SensorError>(0);
+        }
+
+        if (id == 6) {
+            unsigned long ador = strtoul(f[0].c_str(), NULL, 10);
+            if (ador != 0 && ador != 1 && ador != 2 && ador != 14)
+                return ERR_INVALID_PARAMETER;
+            regs_[id] = f[0];
+            return static_cast<SensorError>(0);
+        }
+
+        if (id == 7) {
+            static const unsigned long rates[] = { 1, 2, 4, 5, 10, 20, 25, 40, 50, 100, 200 };
+            unsigned long adof = strtoul(f[0].c_str(), NULL, 10);
+            bool ok = false;
+            for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+                ok |= rates[i] == adof;
+            if (!ok)
+                return ERR_INVALID_PARAMETER;
+            regs_[id] = f[0];
+            return static_cast<SensorError>(0);
+        }
+
+        if (id >= 75 && id <= 77) {
+            BinaryOutput bo;
+            if (!parseBinaryOutput(value, bo))
+                return ERR_INVALID_PARAMETER;
+        }
+
+        regs_[id] = value;
+        return static_cast<SensorError>(0);
+    }
+
+    uint32_t baud() const { return strtoul(get(5).c_str(), NULL, 10); }
+
+    uint32_t ador() const { return strtoul(get(6).c_str(), NULL, 10); }
+
+    uint32_t adof() const { return strtoul(get(7).c_str(), NULL, 10); }
+
+    BinaryOutput binaryOutput(int index) const
+    {
+        BinaryOutput bo;
+        parseBinaryOutput(get(75 + index), bo);
+        return bo;
+    }
+
+private:
+    const Options& options_;
+    map<int, string> regs_;
+    map<int, string> saved_;
+};
+
+class Simulator {
+public:
+    explicit Simulator(const Options& o) :
+        options_(o),
+        registers_(o),
+        master_(-1),
+        slave_(-1),
+        rng_(12345),
+        uniform_(0.0, 1.0),
+        normal_(0.0, 1.0),
+        async_paused_(false),
+        start_time_(0),
+        next_unplug_(0),
+        replug_at_(0),
+        boot_until_(0),
+        tokens_(0),
+        last_token_time_(0),
+        tick_(0)
+    { }
+
+    ~Simulator()
+    {
+        closePty();
+    }
+
+    bool open()
+    {
+        if (!openPty())
+            return false;
+
+        printf("%s\n", options_.link.empty() ? slave_name_.c_str() : options_.link.c_str());
+        fflush(stdout);
+
+        return true;
+    }
+
+    void run()
+    {
+        start_time_ = monotonicSec();
+        last_token_time_ = start_time_;
+        next_unplug_ = start_time_ + options_.unplug_every;
+        double period = 1.0 / options_.imu_rate;
+        double next_tick = start_time_;
+
+        while (keep_running) {
+            double now = monotonicSec();
+
+            if (options_.duration > 0 && now - start_time_ > options_.duration)
+                break;
+
+            if (options_.unplug_every > 0 && !unplugged() && now >= next_unplug_) {
+                closePty();
+                stats_.unplugs++;
+                replug_at_ = now + options_.unplug_for;
+                fprintf(stderr, "vnsim: unplugged\n");
+            }
+
+            if (unplugged()) {
+                if (now < replug_at_) {
+                    usleep(static_cast<useconds_t>(min(replug_at_ - now, 0.01) * 1e6));
+                    continue;
+                }
+
+                // Plugging back in powers the sensor up again.
+                if (!openPty())
+                    break;
+                reset();
+                next_tick = start_time_;
+                next_unplug_ = now + options_.unplug_every;
+                fprintf(stderr, "vnsim: plugged in as %s\n", slave_name_.c_str());
+            }
+
+            // Produce the output for all ticks that are due. If we fell far
+            // behind, skip ahead rather than bursting.
+            int due = 0;
+            while (next_tick <= now && due < 100) {
+                onTick(next_tick);
+                next_tick += period;
+                due++;
+            }
+            if (next_tick <= now)
+                next_tick = now + period;
+
+            double wait = next_tick - monotonicSec();
+            if (wait < 0)
+                wait = 0;
+
+            fd_set readfs;
+            FD_ZERO(&readfs);
+            FD_SET(master_, &readfs);
+
+            struct timeval tv;
+            tv.tv_sec = static_cast<time_t>(wait);
+            tv.tv_usec = static_cast<suseconds_t>((wait - tv.tv_sec) * 1e6);
+
+            int n = select(master_ + 1, &readfs, NULL, NULL, &tv);
+            if (n < 0 && errno != EINTR) {
+                perror("vnsim: select");
+                break;
+            }
+
+            if (n > 0 && FD_ISSET(master_, &readfs))
+                onReadable();
+        }
+    }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    // Pseudo-terminal //////////////////////////////////////////////////////
+
+    bool unplugged() const { return master_ < 0; }
+
+    bool openPty()
+    {
+        master_ = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master_ < 0 || grantpt(master_) != 0 || unlockpt(master_) != 0) {
+            perror("vnsim: posix_openpt");
+            return false;
+        }
+
+        const char* name = ptsname(master_);
+        if (name == NULL) {
+            perror("vnsim: ptsname");
+            return false;
+        }
+        slave_name_ = name;
+
+        // Keep a handle on the slave so the pty survives the host closing and
+        // reopening it, and start it out in raw mode so nothing is echoed.
+        slave_ = ::open(name, O_RDWR | O_NOCTTY);
+        if (slave_ < 0) {
+            perror("vnsim: open slave");
+            return false;
+        }
+
+        struct termios t;
+        tcgetattr(slave_, &t);
+        cfmakeraw(&t);
+        tcsetattr(slave_, TCSANOW, &t);
+
+        fcntl(master_, F_SETFL, fcntl(master_, F_GETFL) | O_NONBLOCK);
+
+        if (!options_.link.empty()) {
+            unlink(options_.link.c_str());
+            if (symlink(name, options_.link.c_str()) != 0) {
+                perror("vnsim: symlink");
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Removes the link and both ends of the pty, so the device node
+    // disappears and a host holding it open gets a hangup.
+    void closePty()
+    {
+        if (!options_.link.empty())
+            unlink(options_.link.c_str());
+        if (slave_ >= 0)
+            close(slave_);
+        if (master_ >= 0)
+            close(master_);
+
+        slave_ = -1;
+        master_ = -1;
+    }
+
+    // Input ////////////////////////////////////////////////////////////////
+
+    void onReadable()
+    {
+        char buf[512];
+        ssize_t n = read(master_, buf, sizeof(buf));
+        if (n <= 0)
+            return;
+
+        // Commands sent at the wrong baudrate arrive garbled on a real line.
+        if (!baudMatches())
+            return;
+
+        input_.append(buf, n);
+
+        while (true) {
+            size_t start = input_.find('$');
+            if (start == string::npos) {
+                input_.clear();
+                return;
+            }
+
+            size_t end = input_.find('\n', start);
+            if (end == string::npos) {
+                input_.erase(0, start);
+                if (input_.size() > 256)
+                    input_.clear();
+                return;
+            }
+
+            string line = input_.substr(start, end - start + 1);
+            input_.erase(0, end + 1);
+
+            handleCommand(line);
+        }
+    }
+
+    void handleCommand(const string& line)
+    {
+        size_t star = line.find('*');
+        if (star == string::npos || line.size() < star + 3) {
+            sendError(ERR_INVALID_COMMAND);
+            return;
+        }
+
+        string body = line.substr(1, star - 1);
+        string check = line.substr(star + 1);
+        while (!check.empty() && (check[check.size() - 1] == '\r' || check[check.size() - 1] == '\n'))
+            check.erase(check.size() - 1);
+
+        if (check != "XX") {
+            unsigned long expected = strtoul(check.c_str(), NULL, 16);
+            unsigned long actual = check.size() == 4
+                ? Crc16::compute(body.c_str(), body.size())
+                : Checksum8::compute(body.c_str(), body.size());
+
+            if (expected != actual) {
+                sendError(ERR_INVALID_CHECKSUM);
+                return;
+            }
+        }
+
+        string cmd = body.substr(0, 5);
+        string args = body.size() > 6 ? body.substr(6) : string();
+
+        if (cmd == "VNRRG")
+            readRegister(args);
+        else if (cmd == "VNWRG")
+            writeRegister(args);
+        else if (cmd == "VNWNV") {
+            registers_.saveSettings();
+            sendResponse("VNWNV");
+        }
+        else if (cmd == "VNRFS") {
+            registers_.restoreFactorySettings();
+            sendResponse("VNRFS");
+        }
+        else if (cmd == "VNRST") {
+            sendResponse("VNRST");
+            reset();
+        }
+        else if (cmd == "VNASY") {
+            async_paused_ = args == "0";
+            sendResponse(body);
+        }
+        else if (cmd == "VNTAR" || cmd == "VNKMD" || cmd == "VNKAD" || cmd == "VNSGB")
+            sendResponse(body);
+        else
+            sendError(ERR_INVALID_COMMAND);
+    }
+
+    string registerIdString(int id)
+    {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "%02d", id);
+        return buf;
+    }
+
+    void readRegister(const string& args)
+    {
+        vector<string> f = split(args);
+        if (f.empty() || f[0].empty()) {
+            sendError(ERR_NOT_ENOUGH_PARAMETERS);
+            return;
+        }
+
+        int id = atoi(f[0].c_str());
+        string value;
+
+        if (id == 8 || id == 9) {
+            State s = stateAt(monotonicSec() - start_time_);
+            char buf[96];
+            if (id == 8)
+                snprintf(buf, sizeof(buf), "%+08.3f,%+08.3f,%+08.3f", s.ypr[0], s.ypr[1], s.ypr[2]);
+            else
+                snprintf(buf, sizeof(buf), "%+.6f,%+.6f,%+.6f,%+.6f", s.quat[0], s.quat[1], s.quat[2], s.quat[3]);
+            value = buf;
+        }
+        else if (registers_.has(id))
+            value = registers_.get(id);
+        else {
+            sendError(ERR_INVALID_REGISTER);
+            return;
+        }
+
+        sendResponse("VNRRG," + registerIdString(id) + "," + value);
+    }
+
+    void writeRegister(const string& args)
+    {
+        size_t comma = args.find(',');
+        if (comma == string::npos) {
+            sendError(ERR_NOT_ENOUGH_PARAMETERS);
+            return;
+        }
+
+        int id = atoi(args.substr(0, comma).c_str());
+        string value = args.substr(comma + 1);
+        uint32_t old_baud = registers_.baud();
+
+        SensorError e = registers_.write(id, value);
+        if (e != 0) {
+            sendError(e);
+            return;
+        }
+
+        // The response goes out at the old baudrate, like on the sensor.
+        sendResponse("VNWRG," + registerIdString(id) + "," + value, old_baud);
+
+        if (registers_.baud() != old_baud)
+            fprintf(stderr, "vnsim: baudrate changed to %u\n", registers_.baud());
+    }
+
+    void reset()
+    {
+        registers_.loadSavedSettings();
+        async_paused_ = false;
+        start_time_ = monotonicSec();
+        tick_ = 0;
+
+        // The sensor takes a moment to boot before it outputs anything.
+        boot_until_ = start_time_ + 0.5;
+    }
+
+    // Output ///////////////////////////////////////////////////////////////
+
+    bool baudMatches(uint32_t baud = 0)
+    {
+        if (options_.ignore_baud)
+            return true;
+
+        struct termios t;
+        if (tcgetattr(slave_, &t) != 0)
+            return false;
+
+        return speedToBaud(cfgetospeed(&t)) == (baud != 0 ? baud : registers_.baud());
+    }
+
+    // Returns false if the data would not have fit on the line.
+    bool reserveLine(size_t bytes, bool force)
+    {
+        if (!options_.throttle)
+            return true;
+
+        double now = monotonicSec();
+        double bytes_per_sec = registers_.baud() / 10.0;
+        double capacity = bytes_per_sec * 0.01 > 512 ? bytes_per_sec * 0.01 : 512;
+
+        tokens_ += (now - last_token_time_) * bytes_per_sec;
+        last_token_time_ = now;
+        if (tokens_ > capacity)
+            tokens_ = capacity;
+
+        if (!force && tokens_ < bytes)
+            return false;
+
+        tokens_ -= bytes;
+        return true;
+    }
+
+    void send(const string& data, bool is_async, uint32_t baud = 0)
+    {
+        if (!baudMatches(baud)) {
+            stats_.dropped_baud++;
+            return;
+        }
+
+        if (!reserveLine(data.size(), !is_async)) {
+            stats_.dropped_line++;
+            return;
+        }
+
+        ssize_t n = write(master_, data.data(), data.size());
+        if (n < 0 || static_cast<size_t>(n) != data.size())
+            stats_.dropped_blocked++;
+    }
+
+    string finishAscii(const string& body)
+    {
+        char tail[8];
+        snprintf(tail, sizeof(tail), "*%02X\r\n", Checksum8::compute(body.c_str(), body.size()));
+        return "$" + body + tail;
+    }
+
+    void sendResponse(const string& body, uint32_t baud = 0)
+    {
+        stats_.responses++;
+        send(finishAscii(body), false, baud);
+    }
+
+    void sendError(SensorError e)
+    {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "VNERR,%02X", static_cast<unsigned>(e));
+        sendResponse(buf);
+    }
+
+    void sendAsync(string packet, bool binary)
+    {
+        if (uniform_(rng_) < options_.drop) {
+            stats_.dropped_random++;
+            return;
+        }
+
+        if (uniform_(rng_) < options_.corrupt && packet.size() > 2) {
+            size_t i = 1 + static_cast<size_t>(uniform_(rng_) * (packet.size() - 1));
+            if (i >= packet.size())
+                i = packet.size() - 1;
+            packet[i] ^= static_cast<char>(1 << static_cast<int>(uniform_(rng_) * 8));
+            stats_.corrupted++;
+        }
+
+        if (binary)
+            stats_.binary_packets++;
+        else
+            stats_.ascii_packets++;
+
+        send(packet, true);
+    }
+
+    void onTick(double when)
+    {
+        uint64_t tick = tick_++;
+
+        if (async_paused_ || when < boot_until_)
+            return;
+
+        State s;
+        bool have_state = false;
+
+        for (int i = 0; i < 3; i++) {
+            BinaryOutput bo = registers_.binaryOutput(i);
+            if (!bo.enabled() || tick % bo.rate_divisor != 0)
+                continue;
+
+            if (!have_state) {
+                s = noisy(stateAt(when - start_time_));
+                have_state = true;
+            }
+
+            sendAsync(binaryPacket(bo, s), true);
+        }
+
+        uint32_t ador = registers_.ador();
+        uint32_t adof = registers_.adof();
+        if (ador == 0 || adof == 0)
+            return;
+
+        uint64_t divisor = static_cast<uint64_t>(options_.imu_rate / adof + 0.5);
+        if (divisor == 0 || tick % divisor != 0)
+            return;
+
+        if (!have_state)
+            s = noisy(stateAt(when - start_time_));
+
+        sendAsync(asciiPacket(ador, s), false);
+    }
+
+    string asciiPacket(uint32_t ador, const State& s)
+    {
+        char buf[256];
+
+        if (ador == 1)
+            snprintf(buf, sizeof(buf), "VNYPR,%+08.3f,%+08.3f,%+08.3f", s.ypr[0], s.ypr[1], s.ypr[2]);
+        else if (ador == 2)
+            snprintf(buf, sizeof(buf), "VNQTN,%+.6f,%+.6f,%+.6f,%+.6f", s.quat[0], s.quat[1], s.quat[2], s.quat[3]);
+        else
+            snprintf(buf, sizeof(buf),
+                "VNYMR,%+08.3f,%+08.3f,%+08.3f,%+07.4f,%+07.4f,%+07.4f,%+07.3f,%+07.3f,%+07.3f,%+08.6f,%+08.6f,%+08.6f",
+                s.ypr[0], s.ypr[1], s.ypr[2],
+                s.mag[0], s.mag[1], s.mag[2],
+                s.accel[0], s.accel[1], s.accel[2],
+                s.gyro[0], s.gyro[1], s.gyro[2]);
+
+        return finishAscii(buf);
+    }
+
+    // Binary packets ///////////////////////////////////////////////////////
+
+    static void putBytes(string& out, uint64_t v, int n)
+    {
+        for (int i = 0; i < n; i++)
+            out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+
+    static void putF(string& out, double v)
+    {
+        float f = static_cast<float>(v);
+        uint32_t u;
+        memcpy(&u, &f, sizeof(u));
+        putBytes(out, u, 4);
+    }
+
+    static void putD(string& out, double v)
+    {
+        uint64_t u;
+        memcpy(&u, &v, sizeof(u));
+        putBytes(out, u, 8);
+    }
+
+    static void put3F(string& out, const double v[3], double scale = 1.0)
+    {
+        for (int i = 0; i < 3; i++)
+            putF(out, v[i] * scale);
+    }
+
+    string binaryPacket(const BinaryOutput& bo, const State& s)
+    {
+        string p;
+        p.push_back(static_cast<char>(0xFA));
+        p.push_back(static_cast<char>(bo.groups));
+
+        for (int g = 0; g < 6; g++)
+            if (bo.groups & (1 << g))
+                putBytes(p, bo.fields[g], 2);
+
+        double dt = bo.rate_divisor / options_.imu_rate;
+
+        for (int g = 0; g < 6; g++) {
+            if (!(bo.groups & (1 << g)))
+                continue;
+
+            for (int b = 0; b < 15; b++) {
+                if (!(bo.fields[g] & (1 << b)))
+                    continue;
+
+                size_t start = p.size();
+                appendField(p, g, b, s, dt);
+
+                // Anything not modelled is sent as zeros of the right size.
+                p.resize(start + Packet::BinaryGroupLengths[g][b], '\0');
+            }
+        }
+
+        uint16_t crc = Crc16::compute(p.data() + 1, p.size() - 1);
+        p.push_back(static_cast<char>(crc >> 8));
+        p.push_back(static_cast<char>(crc & 0xFF));
+
+        return p;
+    }
+
+    void appendField(string& p, int group, int bit, const State& s, double dt)
+    {
+        const uint64_t startup_ns = static_cast<uint64_t>(s.time_startup * 1e9);
+        const uint64_t gps_week = 2200;
+        const uint64_t tow_ns = static_cast<uint64_t>((100000.0 + s.time_startup) * 1e9);
+        const uint64_t gps_ns = gps_week * 604800ULL * 1000000000ULL + tow_ns;
+        const uint16_t ins_status = 0x0006;
+        double dtheta[3], dvel[3];
+
+        for (int i = 0; i < 3; i++) {
+            dtheta[i] = s.gyro[i] * dt / kDegToRad;
+            dvel[i] = s.accel[i] * dt;
+        }
+
+        switch (group) {
+            case 0: // Common
+                switch (bit) {
+                    case 0: putBytes(p, startup_ns, 8); break;
+                    case 1: putBytes(p, gps_ns, 8); break;
+                    case 3: put3F(p, s.ypr); break;
+                    case 4: for (int i = 0; i < 4; i++) putF(p, s.quat[i]); break;
+                    case 5: put3F(p, s.gyro); break;
+                    case 6: for (int i = 0; i < 3; i++) putD(p, s.lla[i]); break;
+                    case 7: put3F(p, s.vel_ned); break;
+                    case 8: put3F(p, s.accel); break;
+                    case 9: put3F(p, s.accel); put3F(p, s.gyro); break;
+                    case 10: put3F(p, s.mag); putF(p, 25.0); putF(p, 101.325); break;
+                    case 11: putF(p, dt); put3F(p, dtheta); put3F(p, dvel); break;
+                    case 12: putBytes(p, ins_status, 2); break;
+                    case 13: putBytes(p, 0, 4); break;
+                }
+                break;
+
+            case 1: // Time
+                switch (bit) {
+                    case 0: putBytes(p, startup_ns, 8); break;
+                    case 1: putBytes(p, gps_ns, 8); break;
+                    case 2: putBytes(p, tow_ns, 8); break;
+                    case 3: putBytes(p, gps_week, 2); break;
+                }
+                break;
+
+            case 2: // IMU
+                switch (bit) {
+                    case 1: put3F(p, s.mag); break;
+                    case 2: put3F(p, s.accel); break;
+                    case 3: put3F(p, s.gyro); break;
+                    case 4: putF(p, 25.0); break;
+                    case 5: putF(p, 101.325); break;
+                    case 6: putF(p, dt); put3F(p, dtheta); break;
+                    case 7: put3F(p, dvel); break;
+                    case 8: put3F(p, s.mag); break;
+                    case 9: put3F(p, s.accel); break;
+                    case 10: put3F(p, s.gyro); break;
+                }
+                break;
+
+            case 3: // GPS
+                switch (bit) {
+                    case 1: putBytes(p, tow_ns, 8); break;
+                    case 2: putBytes(p, gps_week, 2); break;
+                    case 3: putBytes(p, 12, 1); break;
+                    case 4: putBytes(p, 3, 1); break;
+                    case 5: for (int i = 0; i < 3; i++) putD(p, s.lla[i]); break;
+                    case 6: for (int i = 0; i < 3; i++) putD(p, s.ecef[i]); break;
+                    case 7: put3F(p, s.vel_ned); break;
+                    case 9: putF(p, 1.0); putF(p, 1.0); putF(p, 2.0); break;
+                    case 10: putF(p, 0.1); break;
+                }
+                break;
+
+            case 4: // Attitude
+                switch (bit) {
+                    case 1: put3F(p, s.ypr); break;
+                    case 2: for (int i = 0; i < 4; i++) putF(p, s.quat[i]); break;
+                    case 3:
+                        for (int r = 0; r < 3; r++)
+                            for (int c = 0; c < 3; c++)
+                                putF(p, s.dcm[r][c]);
+                        break;
+                    case 8: putF(p, 0.5); putF(p, 0.1); putF(p, 0.1); break;
+                }
+                break;
+
+            case 5: // INS
+                switch (bit) {
+                    case 0: putBytes(p, ins_status, 2); break;
+                    case 1: for (int i = 0; i < 3; i++) putD(p, s.lla[i]); break;
+                    case 2: for (int i = 0; i < 3; i++) putD(p, s.ecef[i]); break;
+                    case 3: put3F(p, s.vel_body); break;
+                    case 4: put3F(p, s.vel_ned); break;
+                    case 9: putF(p, 1.0); break;
+                    case 10: putF(p, 0.05); break;
+                }
+                break;
+        }
+    }
+
+    // Trajectory ///////////////////////////////////////////////////////////
+
+    // A slow weave around the reference position: 20 m circle every two
+    // minutes with gentle yaw, pitch and roll oscillations.
+    State stateAt(double t)
+    {
+        State s;
+        s.time_startup = t;
+
+        double yaw = 30.0 * sin(0.1 * t);
+        double pitch = 5.0 * sin(0.3 * t);
+        double roll = 3.0 * sin(0.5 * t);
+        double yaw_dot = 3.0 * cos(0.1 * t) * kDegToRad;
+        double pitch_dot = 1.5 * cos(0.3 * t) * kDegToRad;
+        double roll_dot = 1.5 * cos(0.5 * t) * kDegToRad;
+
+        s.ypr[0] = yaw;
+        s.ypr[1] = pitch;
+        s.ypr[2] = roll;
+
+        double cy = cos(yaw * kDegToRad), sy = sin(yaw * kDegToRad);
+        double cp = cos(pitch * kDegToRad), sp = sin(pitch * kDegToRad);
+        double cr = cos(roll * kDegToRad), sr = sin(roll * kDegToRad);
+
+        // Body to NED rotation for a 3-2-1 sequence.
+        double c[3][3] = {
+            { cp * cy, sr * sp * cy - cr * sy, cr * sp * cy + sr * sy },
+            { cp * sy, sr * sp * sy + cr * cy, cr * sp * sy - sr * cy },
+            { -sp, sr * cp, cr * cp }
+        };
+
+        // The sensor reports the NED to body DCM.
+        for (int r = 0; r < 3; r++)
+            for (int k = 0; k < 3; k++)
+                s.dcm[r][k] = c[k][r];
+
+        double cy2 = cos(yaw * kDegToRad / 2), sy2 = sin(yaw * kDegToRad / 2);
+        double cp2 = cos(pitch * kDegToRad / 2), sp2 = sin(pitch * kDegToRad / 2);
+        double cr2 = cos(roll * kDegToRad / 2), sr2 = sin(roll * kDegToRad / 2);
+        s.quat[0] = sr2 * cp2 * cy2 - cr2 * sp2 * sy2;
+        s.quat[1] = cr2 * sp2 * cy2 + sr2 * cp2 * sy2;
+        s.quat[2] = cr2 * cp2 * sy2 - sr2 * sp2 * cy2;
+        s.quat[3] = cr2 * cp2 * cy2 + sr2 * sp2 * sy2;
+
+        s.gyro[0] = roll_dot - yaw_dot * sp;
+        s.gyro[1] = pitch_dot * cr + yaw_dot * cp * sr;
+        s.gyro[2] = -pitch_dot * sr + yaw_dot * cp * cr;
+
+        s.accel[0] = kGravity * sp;
+        s.accel[1] = -kGravity * cp * sr;
+        s.accel[2] = -kGravity * cp * cr;
+
+        const double mag_ned[3] = { 0.27, 0.01, 0.42 };
+        for (int r = 0; r < 3; r++)
+            s.mag[r] = s.dcm[r][0] * mag_ned[0] + s.dcm[r][1] * mag_ned[1] + s.dcm[r][2] * mag_ned[2];
+
+        const double radius = 20.0;
+        const double w = 2 * M_PI / 120.0;
+        double north = radius * sin(w * t);
+        double east = radius * (1 - cos(w * t));
+        s.vel_ned[0] = radius * w * cos(w * t);
+        s.vel_ned[1] = radius * w * sin(w * t);
+        s.vel_ned[2] = 0;
+
+        for (int r = 0; r < 3; r++)
+            s.vel_body[r] = s.dcm[r][0] * s.vel_ned[0] + s.dcm[r][1] * s.vel_ned[1] + s.dcm[r][2] * s.vel_ned[2];
+
+        double lat0 = options_.latitude * kDegToRad;
+        double sl = sin(lat0);
+        double rn = kWgs84A / sqrt(1 - kWgs84E2 * sl * sl);
+        double rm = rn * (1 - kWgs84E2) / (1 - kWgs84E2 * sl * sl);
+
+        s.lla[0] = options_.latitude + north / (rm + options_.altitude) / kDegToRad;
+        s.lla[1] = options_.longitude + east / ((rn + options_.altitude) * cos(lat0)) / kDegToRad;
+        s.lla[2] = options_.altitude;
+
+        double lat = s.lla[0] * kDegToRad, lon = s.lla[1] * kDegToRad;
+        double n = kWgs84A / sqrt(1 - kWgs84E2 * sin(lat) * sin(lat));
+        s.ecef[0] = (n + s.lla[2]) * cos(lat) * cos(lon);
+        s.ecef[1] = (n + s.lla[2]) * cos(lat) * sin(lon);
+        s.ecef[2] = (n * (1 - kWgs84E2) + s.lla[2]) * sin(lat);
+
+        return s;
+    }
+
+    State noisy(State s)
+    {
+        if (options_.noise <= 0)
+            return s;
+
+        double k = options_.noise;
+        for (int i = 0; i < 3; i++) {
+            s.ypr[i] += 0.05 * k * normal_(rng_);
+            s.gyro[i] += 0.002 * k * normal_(rng_);
+            s.accel[i] += 0.02 * k * normal_(rng_);
+            s.mag[i] += 0.002 * k * normal_(rng_);
+        }
+
+        return s;
+    }
+
+private:
+    const Options& options_;
+    RegisterModel registers_;
+    int master_;
+    int slave_;
+    string slave_name_;
+    string input_;
+    mt19937 rng_;
+    uniform_real_distribution<double> uniform_;
+    normal_distribution<double> normal_;
+    bool async_paused_;
+    double start_time_;
+    double next_unplug_;
+    double replug_at_;
+    double boot_until_;
+    double tokens_;
+    double last_token_time_;
+    uint64_t tick_;
+    Stats stats_;
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    Simulator sim(options);
+
+    if (!sim.open())
+        return 1;
+
+    sim.run();
+
+    const Stats& s = sim.stats();
+    fprintf(stderr,
+        "vnsim: generated %llu binary, %llu ascii, %llu responses; "
+        "dropped %llu random, %llu line capacity, %llu baud mismatch, %llu blocked; "
+        "corrupted %llu; unplugged %llu times\n",
+        (unsigned long long) s.binary_packets, (unsigned long long) s.ascii_packets,
+        (unsigned long long) s.responses, (unsigned long long) s.dropped_random,
+        (unsigned long long) s.dropped_line, (unsigned long long) s.dropped_baud,
+        (unsigned long long) s.dropped_blocked, (unsigned long long) s.corrupted,
+        (unsigned long long) s.unplugs);
+
+    return 0;
+}
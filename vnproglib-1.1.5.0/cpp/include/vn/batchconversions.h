@@ -0,0 +1,203 @@
+#ifndef _VN_MATH_BATCHCONVERSIONS_H_
+#define _VN_MATH_BATCHCONVERSIONS_H_
+
+#include <cstddef>
+
+#include "export.h"
+#include "vector.h"
+#include "matrix.h"
+
+namespace vn {
+namespace xplat {
+
+class ThreadPool;
+
+}
+
+namespace math {
+
+/// \defgroup batch_attitude_convertors Batch Attitude Convertors
+/// \brief Attitude conversions over whole arrays, e.g. when reprocessing a
+///     log.
+///
+/// These compute the same formulas as the single-value conversions in
+/// conversions.h, four values at a time. Where the compiler provides SSE2
+/// the trigonometric functions are replaced by polynomial approximations
+/// evaluated four at a time:
+///
+/// - sine and cosine are within 3e-7 of the true value for angles up to
+///   8192 rad in magnitude,
+/// - atan2 is within 3 ulp, about 3e-7 rad near pi, and asin within 2e-7
+///   rad.
+///
+/// Angles therefore differ from the single-value conversions by at most
+/// about 2.5e-7 rad, well below the error the float inputs already carry.
+/// Without SSE2 the standard library's functions are used and the results
+/// match the single-value conversions. asin clamps its argument to [-1, 1],
+/// so a quaternion slightly off unit length gives +/-90 degrees of pitch
+/// rather than NaN.
+///
+/// Each conversion comes in an array-of-structures form working on the
+/// library's vector and matrix types and, for the quaternion and yaw, pitch,
+/// roll conversions, a structure-of-arrays form working on one array per
+/// component. Input and output arrays must not overlap.
+///
+/// Passing a pool spreads inputs of more than a few thousand values over its
+/// threads and the calling thread. Each call returns once every value has
+/// been converted.
+/// \{
+
+/// \brief Converts quaternions to yaw, pitch, roll in degrees.
+///
+/// \param[in] quats The quaternions, scalar last.
+/// \param[out] yprs The yaw, pitch, roll values in degrees.
+/// \param[in] count The number of quaternions.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT quat2YprInDegs(const vec4f* quats, vec3f* yprs, size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts quaternions to yaw, pitch, roll in radians.
+///
+/// \param[in] quats The quaternions, scalar last.
+/// \param[out] yprs The yaw, pitch, roll values in radians.
+/// \param[in] count The number of quaternions.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT quat2YprInRads(const vec4f* quats, vec3f* yprs, size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts yaw, pitch, roll in degrees to quaternions.
+///
+/// \param[in] yprs The yaw, pitch, roll values in degrees.
+/// \param[out] quats The quaternions, scalar last.
+/// \param[in] count The number of values.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT yprInDegs2Quat(const vec3f* yprs, vec4f* quats, size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts yaw, pitch, roll in radians to quaternions.
+///
+/// \param[in] yprs The yaw, pitch, roll values in radians.
+/// \param[out] quats The quaternions, scalar last.
+/// \param[in] count The number of values.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT yprInRads2Quat(const vec3f* yprs, vec4f* quats, size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts yaw, pitch, roll in degrees to direction cosine matrices.
+///
+/// \param[in] yprs The yaw, pitch, roll values in degrees.
+/// \param[out] dcms The direction cosine matrices.
+/// \param[in] count The number of values.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT yprInDegs2Dcm(const vec3f* yprs, mat3f* dcms, size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts yaw, pitch, roll in radians to direction cosine matrices.
+///
+/// \param[in] yprs The yaw, pitch, roll values in radians.
+/// \param[out] dcms The direction cosine matrices.
+/// \param[in] count The number of values.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT yprInRads2Dcm(const vec3f* yprs, mat3f* dcms, size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts direction cosine matrices to yaw, pitch, roll in degrees.
+///
+/// \param[in] dcms The direction cosine matrices.
+/// \param[out] yprs The yaw, pitch, roll values in degrees.
+/// \param[in] count The number of matrices.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT dcm2YprInDegs(const mat3f* dcms, vec3f* yprs, size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts direction cosine matrices to yaw, pitch, roll in radians.
+///
+/// \param[in] dcms The direction cosine matrices.
+/// \param[out] yprs The yaw, pitch, roll values in radians.
+/// \param[in] count The number of matrices.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT dcm2YprInRads(const mat3f* dcms, vec3f* yprs, size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts quaternions to direction cosine matrices.
+///
+/// \param[in] quats The quaternions, scalar last.
+/// \param[out] dcms The direction cosine matrices.
+/// \param[in] count The number of quaternions.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT quat2dcm(const vec4f* quats, mat3f* dcms, size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts direction cosine matrices to quaternions.
+///
+/// \param[in] dcms The direction cosine matrices.
+/// \param[out] quats The quaternions, scalar last.
+/// \param[in] count The number of matrices.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT dcm2quat(const mat3f* dcms, vec4f* quats, size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts quaternions held one component per array to yaw, pitch,
+///     roll in degrees.
+///
+/// \param[in] qx The quaternions' x components.
+/// \param[in] qy The quaternions' y components.
+/// \param[in] qz The quaternions' z components.
+/// \param[in] qw The quaternions' scalar components.
+/// \param[out] yaw The yaw angles in degrees.
+/// \param[out] pitch The pitch angles in degrees.
+/// \param[out] roll The roll angles in degrees.
+/// \param[in] count The number of quaternions.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT quat2YprInDegs(
+	const float* qx, const float* qy, const float* qz, const float* qw,
+	float* yaw, float* pitch, float* roll,
+	size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts quaternions held one component per array to yaw, pitch,
+///     roll in radians.
+///
+/// \param[in] qx The quaternions' x components.
+/// \param[in] qy The quaternions' y components.
+/// \param[in] qz The quaternions' z components.
+/// \param[in] qw The quaternions' scalar components.
+/// \param[out] yaw The yaw angles in radians.
+/// \param[out] pitch The pitch angles in radians.
+/// \param[out] roll The roll angles in radians.
+/// \param[in] count The number of quaternions.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT quat2YprInRads(
+	const float* qx, const float* qy, const float* qz, const float* qw,
+	float* yaw, float* pitch, float* roll,
+	size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts yaw, pitch, roll in degrees held one angle per array to
+///     quaternions held one component per array.
+///
+/// \param[in] yaw The yaw angles in degrees.
+/// \param[in] pitch The pitch angles in degrees.
+/// \param[in] roll The roll angles in degrees.
+/// \param[out] qx The quaternions' x components.
+/// \param[out] qy The quaternions' y components.
+/// \param[out] qz The quaternions' z components.
+/// \param[out] qw The quaternions' scalar components.
+/// \param[in] count The number of values.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT yprInDegs2Quat(
+	const float* yaw, const float* pitch, const float* roll,
+	float* qx, float* qy, float* qz, float* qw,
+	size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \brief Converts yaw, pitch, roll in radians held one angle per array to
+///     quaternions held one component per array.
+///
+/// \param[in] yaw The yaw angles in radians.
+/// \param[in] pitch The pitch angles in radians.
+/// \param[in] roll The roll angles in radians.
+/// \param[out] qx The quaternions' x components.
+/// \param[out] qy The quaternions' y components.
+/// \param[out] qz The quaternions' z components.
+/// \param[out] qw The quaternions' scalar components.
+/// \param[in] count The number of values.
+/// \param[in] pool Pool to spread large inputs over, or <c>NULL</c>.
+void vn_proglib_DLLEXPORT yprInRads2Quat(
+	const float* yaw, const float* pitch, const float* roll,
+	float* qx, float* qy, float* qz, float* qw,
+	size_t count, xplat::ThreadPool* pool = NULL);
+
+/// \}
+
+}
+}
+
+#endif
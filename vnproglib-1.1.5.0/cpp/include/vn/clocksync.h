@@ -0,0 +1,125 @@
+#ifndef _VNSENSORS_CLOCKSYNC_H_
+#define _VNSENSORS_CLOCKSYNC_H_
+
+#include <deque>
+
+#include "vn/int.h"
+#include "vn/export.h"
+#include "vn/vntime.h"
+#include "vn/compositedata.h"
+
+namespace vn {
+namespace sensors {
+
+/// \brief Maps the sensor's clock onto the host's clock.
+///
+/// Host receive timestamps contain the serial, USB and scheduling latency of
+/// every packet, while the sensor's own <c>TimeStartup</c> or <c>TimeGps</c>
+/// counters are free of jitter. Since latency can only delay a packet, every
+/// (sensor time, host time) pair lies on or above the line
+/// <c>host = offset + (1 + drift) * sensor</c>. ClockSync keeps the lower
+/// convex hull of these pairs over a sliding window and uses its supporting
+/// edge as the estimate of that line, which converges to the minimum latency
+/// path without any tuning of noise parameters.
+///
+/// ClockSync is not thread-safe.
+class vn_proglib_DLLEXPORT ClockSync
+{
+
+public:
+
+	/// \brief Creates a new ClockSync.
+	///
+	/// \param[in] windowSec The span of sensor time to fit the model over.
+	///     Longer windows give better drift estimates but adapt slower to
+	///     changes in drift.
+	/// \param[in] minSpanSec The span of sensor time required before the
+	///     model is used.
+	explicit ClockSync(double windowSec = 60.0, double minSpanSec = 1.0);
+
+	/// \brief Adds a pair of sensor and host times to the model and returns
+	///     the corrected host time of the sample.
+	///
+	/// A sensor time that does not advance, e.g. <c>TimeGps</c> before the
+	/// first fix, is skipped and <c>hostTime</c> returned. The model is only
+	/// restarted if the sensor time goes back by more than a second or jumps
+	/// apart from the host time.
+	///
+	/// \param[in] sensorTimeNs The sensor's time of the sample in nanoseconds.
+	/// \param[in] hostTime The host time the sample was received.
+	/// \return The host time the sample was produced according to the model
+	///     or <c>hostTime</c> if the model is not yet available.
+	xplat::TimeStamp process(uint64_t sensorTimeNs, xplat::TimeStamp hostTime);
+
+	/// \brief Adds a parsed packet to the model and returns its corrected
+	///     host time.
+	///
+	/// <c>TimeStartup</c> is used if present; otherwise <c>TimeGps</c>.
+	///
+	/// \param[in] cd The parsed packet.
+	/// \param[in] hostTime The host time the packet was received.
+	/// \param[out] correctedTime The host time the packet was produced. Set to
+	///     <c>hostTime</c> if the model is not yet available.
+	/// \return <c>true</c> if the packet contained a sensor time; otherwise
+	///     <c>false</c>.
+	bool process(CompositeData& cd, xplat::TimeStamp hostTime, xplat::TimeStamp& correctedTime);
+
+	/// \brief Converts a sensor time to host time using the current model.
+	///
+	/// \param[in] sensorTimeNs The sensor time in nanoseconds.
+	/// \return The corresponding host time.
+	/// \exception invalid_operation The model is not yet available.
+	xplat::TimeStamp toHostTime(uint64_t sensorTimeNs) const;
+
+	/// \brief Indicates if enough samples have been seen to use the model.
+	///
+	/// \return <c>true</c> if synchronized; otherwise <c>false</c>.
+	bool isSynchronized() const;
+
+	/// \brief Returns the estimated drift of the host clock relative to the
+	///     sensor clock.
+	///
+	/// \return The drift as a fraction, e.g. 1e-6 for 1 ppm.
+	double drift() const;
+
+	/// \brief Returns the number of times the model was restarted because
+	///     the sensor time went backwards or the clocks jumped apart.
+	///
+	/// \return The number of resets.
+	uint64_t numOfResets() const;
+
+	/// \brief Discards all samples.
+	void reset();
+
+private:
+	struct Point
+	{
+		double x;	// Sensor time in seconds since the origin.
+		double y;	// Host time in seconds since the origin.
+
+		Point(double x_, double y_) : x(x_), y(y_) { }
+	};
+
+	void restart(uint64_t sensorTimeNs, xplat::TimeStamp hostTime);
+	void addToHull(const Point& p);
+	void updateModel();
+
+private:
+	double _windowSec;
+	double _minSpanSec;
+	bool _haveOrigin;
+	uint64_t _originSensorNs;
+	int64_t _originHostNs;
+	xplat::TimeStamp::ClockSource _hostClock;
+	Point _last;
+	std::deque<Point> _hull;
+	bool _synchronized;
+	double _intercept;
+	double _slope;
+	uint64_t _numOfResets;
+};
+
+}
+}
+
+#endif
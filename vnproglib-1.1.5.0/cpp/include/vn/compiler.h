@@ -76,4 +76,13 @@
 	#define VN_HAVE_SECURE_SCL 0
 #endif
 
+// The VN_HAVE_SSE2 define indicates if SSE2 intrinsics are available for code
+// working on several values at a time. Defining VN_NO_SIMD when building the
+// library selects the portable code instead.
+#if !defined(VN_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define VN_HAVE_SSE2 1
+#else
+	#define VN_HAVE_SSE2 0
+#endif
+
 #endif
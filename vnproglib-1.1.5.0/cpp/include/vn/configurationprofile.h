@@ -0,0 +1,124 @@
+#ifndef _VNSENSORS_CONFIGURATIONPROFILE_H_
+#define _VNSENSORS_CONFIGURATIONPROFILE_H_
+
+#include <string>
+#include <vector>
+
+#include "vn/int.h"
+#include "vn/export.h"
+#include "vn/types.h"
+#include "vn/registers.h"
+
+namespace vn {
+namespace sensors {
+
+/// \brief A declarative set of register values for a VectorNav sensor.
+///
+/// Each entry holds a register ID and the register's fields exactly as they
+/// appear after the register ID in a <c>$VNWRG</c> command, e.g. register
+/// 7 with fields <c>"200"</c>. Entries are applied in the order they were
+/// first set. See VnSensor::applyConfiguration.
+class vn_proglib_DLLEXPORT ConfigurationProfile
+{
+
+public:
+
+	/// \brief A single register and its desired fields.
+	struct Entry
+	{
+		uint8_t registerId;	///< The register ID.
+		std::string fields;	///< The comma separated fields.
+
+		Entry(uint8_t registerId_, const std::string& fields_) :
+			registerId(registerId_),
+			fields(fields_)
+		{ }
+	};
+
+	/// \brief Creates a new, empty profile.
+	ConfigurationProfile();
+
+	/// \brief Sets the desired fields of a register, replacing any previous
+	///     value for the same register.
+	///
+	/// \param[in] registerId The register ID.
+	/// \param[in] fields The comma separated fields, without the register ID.
+	void set(uint8_t registerId, const std::string& fields);
+
+	/// \brief Sets the Async Data Output Type register.
+	///
+	/// \param[in] ador The ASCII asynchronous output type.
+	void setAsyncDataOutputType(protocol::uart::AsciiAsync ador);
+
+	/// \brief Sets the Async Data Output Frequency register.
+	///
+	/// \param[in] adof The ASCII asynchronous output frequency in Hz.
+	void setAsyncDataOutputFrequency(uint32_t adof);
+
+	/// \brief Sets one of the Binary Output registers.
+	///
+	/// \param[in] binaryOutputNumber The binary output, 1 to 3.
+	/// \param[in] fields The register's fields.
+	void setBinaryOutput(uint8_t binaryOutputNumber, const BinaryOutputRegister& fields);
+
+	/// \brief Indicates if the settings are saved to non-volatile memory when
+	///     applying the profile changed any register.
+	///
+	/// \return <c>true</c> if the settings are persisted; otherwise <c>false</c>.
+	bool persist() const;
+
+	/// \brief Sets if the settings are saved to non-volatile memory when
+	///     applying the profile changed any register.
+	///
+	/// \param[in] persist <c>true</c> to persist the settings.
+	void setPersist(bool persist);
+
+	/// \brief Returns the entries of the profile in the order they are applied.
+	///
+	/// \return The entries.
+	const std::vector<Entry>& entries() const;
+
+	/// \brief Removes all entries.
+	void clear();
+
+	/// \brief Compares two comma separated field lists as the sensor would
+	///     interpret them.
+	///
+	/// Fields match if they are textually equal ignoring case, equal as
+	/// real numbers to within the precision the sensor reports, or equal as
+	/// integers. Only fields with a decimal point or a signed exponent are
+	/// compared as real numbers. This makes <c>"1,4,01,0029"</c> match
+	/// <c>"1,4,1,29"</c> and <c>"+0.100000"</c> match <c>"0.1"</c>, but not
+	/// <c>"921600"</c> and <c>"921610"</c>.
+	///
+	/// \param[in] a The first field list.
+	/// \param[in] b The second field list.
+	/// \return <c>true</c> if the field lists are equivalent.
+	static bool fieldsMatch(const std::string& a, const std::string& b);
+
+private:
+	std::vector<Entry> _entries;
+	bool _persist;
+};
+
+/// \brief The outcome of VnSensor::applyConfiguration.
+struct ConfigurationResult
+{
+	std::vector<uint8_t> changedRegisters;	///< The registers that were written, in order.
+	bool settingsWritten;					///< Indicates if a Write Settings command was issued.
+	double readMs;							///< Time spent reading the current register values.
+	double writeMs;							///< Time spent writing changed registers and settings.
+	double elapsedMs;						///< Total time spent.
+
+	ConfigurationResult() :
+		settingsWritten(false),
+		readMs(0),
+		writeMs(0),
+		elapsedMs(0)
+	{ }
+};
+
+}
+}
+
+#endif
@@ -9,6 +9,10 @@
 #include "nocopy.h"
 #include "export.h"
 
+#if __linux__
+	#include <atomic>
+#endif
+
 namespace vn {
 namespace xplat {
 
@@ -39,11 +43,21 @@ public:
 
 private:
 
+	#if __linux__
+
+	// Futex word kept inline so no allocation is needed. 0 is unlocked, 1
+	// locked and 2 locked with threads possibly waiting.
+	std::atomic<int> _state;
+
+	#else
+
 	// Contains internal data, mainly stuff that is required for cross-platform
 	// support.
 	struct Impl;
 	Impl *_pi;
 
+	#endif
+
 };
 
 }
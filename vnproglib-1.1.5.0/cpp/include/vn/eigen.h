@@ -0,0 +1,136 @@
+#ifndef _VN_MATH_EIGEN_H_
+#define _VN_MATH_EIGEN_H_
+
+#include <cstddef>
+#include <type_traits>
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Geometry>
+
+#include "vector.h"
+#include "matrix.h"
+
+/// \file
+/// \brief Views of the library's vectors and matrices as Eigen objects.
+///
+/// Only this header uses Eigen and the library itself does not include it,
+/// so applications without Eigen are unaffected.
+///
+/// The views are <c>Eigen::Map</c>s over the vector's or matrix's own
+/// elements, so nothing is copied either way. Reading through a view uses the
+/// values in place and assigning to one writes the result straight into the
+/// library's type:
+///
+/// \code
+/// vec3d ned;
+/// toEigen(ned) = toEigen(rotation) * (toEigen(ecef) - toEigen(reference));
+/// \endcode
+///
+/// A view is only valid while the object it was made from is alive.
+
+namespace vn {
+namespace math {
+
+/// \brief Checks at compile time that a vector's components can be viewed as
+///     an Eigen column vector.
+template<size_t n, typename T>
+struct EigenVecLayout
+{
+	static_assert(std::is_standard_layout<vec<n, T> >::value, "vec must be standard layout to be viewed by Eigen.");
+	static_assert(sizeof(vec<n, T>) == n * sizeof(T), "vec must hold exactly its components to be viewed by Eigen.");
+
+	/// \brief The Eigen type with the same layout.
+	typedef Eigen::Matrix<T, static_cast<int>(n), 1> Type;
+};
+
+/// \brief Checks at compile time that a matrix's elements can be viewed as an
+///     Eigen matrix.
+///
+/// Both the library's matrices and Eigen's default matrices store their
+/// elements column by column.
+template<size_t m, size_t n, typename T>
+struct EigenMatLayout
+{
+	static_assert(std::is_standard_layout<mat<m, n, T> >::value, "mat must be standard layout to be viewed by Eigen.");
+	static_assert(sizeof(mat<m, n, T>) == m * n * sizeof(T), "mat must hold exactly its elements to be viewed by Eigen.");
+
+	/// \brief The Eigen type with the same layout.
+	typedef Eigen::Matrix<T, static_cast<int>(m), static_cast<int>(n)> Type;
+};
+
+/// \brief Views a vector as an Eigen column vector.
+///
+/// \param[in] v The vector.
+/// \return A writable view of the vector's components.
+template<size_t n, typename T>
+Eigen::Map<typename EigenVecLayout<n, T>::Type> toEigen(vec<n, T>& v)
+{
+	return Eigen::Map<typename EigenVecLayout<n, T>::Type>(v.c);
+}
+
+/// \brief Views a vector as a read-only Eigen column vector.
+///
+/// \param[in] v The vector.
+/// \return A read-only view of the vector's components.
+template<size_t n, typename T>
+Eigen::Map<const typename EigenVecLayout<n, T>::Type> toEigen(const vec<n, T>& v)
+{
+	return Eigen::Map<const typename EigenVecLayout<n, T>::Type>(v.c);
+}
+
+/// \brief Views a matrix as an Eigen matrix.
+///
+/// \param[in] mt The matrix.
+/// \return A writable view of the matrix's elements.
+template<size_t m, size_t n, typename T>
+Eigen::Map<typename EigenMatLayout<m, n, T>::Type> toEigen(mat<m, n, T>& mt)
+{
+	return Eigen::Map<typename EigenMatLayout<m, n, T>::Type>(mt.e);
+}
+
+/// \brief Views a matrix as a read-only Eigen matrix.
+///
+/// \param[in] mt The matrix.
+/// \return A read-only view of the matrix's elements.
+template<size_t m, size_t n, typename T>
+Eigen::Map<const typename EigenMatLayout<m, n, T>::Type> toEigen(const mat<m, n, T>& mt)
+{
+	return Eigen::Map<const typename EigenMatLayout<m, n, T>::Type>(mt.e);
+}
+
+/// \brief Views a quaternion as an Eigen quaternion.
+///
+/// The sensor's quaternions are scalar last, which is also the order Eigen
+/// stores a quaternion's coefficients in. Eigen rotates vectors where
+/// \ref quat2dcm and \ref quatRotate rotate frames, so the sensor's attitude
+/// as an Eigen rotation is the conjugate of the view:
+/// <c>toEigenQuaternion(q).conjugate() * v</c> equals <c>quatRotate(q, v)</c>.
+///
+/// \param[in] q The quaternion.
+/// \return A writable view of the quaternion.
+template<typename T>
+Eigen::Map<Eigen::Quaternion<T> > toEigenQuaternion(vec<4, T>& q)
+{
+	// Instantiates the layout checks.
+	(void) sizeof(EigenVecLayout<4, T>);
+
+	return Eigen::Map<Eigen::Quaternion<T> >(q.c);
+}
+
+/// \brief Views a quaternion as a read-only Eigen quaternion.
+///
+/// \param[in] q The quaternion, scalar last.
+/// \return A read-only view of the quaternion.
+template<typename T>
+Eigen::Map<const Eigen::Quaternion<T> > toEigenQuaternion(const vec<4, T>& q)
+{
+	// Instantiates the layout checks.
+	(void) sizeof(EigenVecLayout<4, T>);
+
+	return Eigen::Map<const Eigen::Quaternion<T> >(q.c);
+}
+
+}
+}
+
+#endif
@@ -5,6 +5,10 @@
 #include "int.h"
 #include "export.h"
 
+#if __linux__
+	#include <atomic>
+#endif
+
 namespace vn {
 namespace xplat {
 
@@ -60,11 +64,24 @@ public:
 
 private:
 
+	#if __linux__
+
+	WaitResult waitNs(int64_t timeoutNs);
+
+	// Futex word kept inline so no allocation is needed. Signalling only
+	// enters the kernel when a waiter may be sleeping, and waiting only
+	// enters it when the event is not already signaled.
+	std::atomic<int> _state;
+
+	#else
+
 	// Contains internal data, mainly stuff that is required for cross-platform
 	// support.
 	struct Impl;
 	Impl *_pi;
 
+	#endif
+
 };
 
 }
@@ -2,6 +2,7 @@
 #define _VNSENSORS_EZASYNCDATA_H_
 
 #include <string>
+#include <vector>
 
 #include "vn/int.h"
 #include "vn/nocopy.h"
@@ -10,6 +11,7 @@
 #include "vn/criticalsection.h"
 #include "vn/event.h"
 #include "vn/export.h"
+#include "vn/seqlock.h"
 
 namespace vn {
 namespace sensors {
@@ -22,6 +24,40 @@ private:
 	explicit EzAsyncData(VnSensor* sensor);
 
 public:
+
+	/// \brief The latest values of the outputs a control loop typically
+	///     needs, kept in a form that can be copied without locks or
+	///     allocation. Each value is the most recent one received, as with
+	///     \ref currentData.
+	struct Sample
+	{
+		uint64_t numOfPackets;					///< Number of packets received so far; 0 if none.
+		bool hasTimeStartup;
+		bool hasYawPitchRoll;
+		bool hasQuaternion;
+		bool hasAngularRate;
+		bool hasAcceleration;
+		bool hasMagnetic;
+		bool hasTemperature;
+		bool hasPressure;
+		bool hasPositionEstimatedLla;
+		bool hasVelocityEstimatedNed;
+		bool hasVelocityEstimatedBody;
+		bool hasInsStatus;
+		uint64_t timeStartup;					///< Sensor time since startup in nanoseconds.
+		math::vec3f yawPitchRoll;				///< Yaw, pitch, roll in degrees.
+		math::vec4f quaternion;					///< Attitude quaternion.
+		math::vec3f angularRate;				///< Compensated angular rate in rad/s.
+		math::vec3f acceleration;				///< Compensated acceleration in m/s^2.
+		math::vec3f magnetic;					///< Compensated magnetic field in Gauss.
+		float temperature;						///< Temperature in C.
+		float pressure;							///< Pressure in kPa.
+		math::vec3d positionEstimatedLla;		///< Estimated latitude, longitude (degrees) and altitude (m).
+		math::vec3f velocityEstimatedNed;		///< Estimated NED velocity in m/s.
+		math::vec3f velocityEstimatedBody;		///< Estimated body velocity in m/s.
+		protocol::uart::InsStatus insStatus;	///< INS status.
+	};
+
 	/// \brief DTOR
 	~EzAsyncData();
 
@@ -60,14 +96,85 @@ public:
 	/// \exception timeout Did not receive new data by the timeout.
 	CompositeData getNextData(int timeoutMs);
 
+	/// \brief Copies out the latest values without taking any lock, so
+	///     polling never delays the thread parsing packets.
+	///
+	/// The copy is only retried if a packet is published while it is being
+	/// made. A packet takes far longer to arrive than the copy takes, so
+	/// this fails only if the calling thread is preempted during
+	/// maxAttempts copies in a row. Callers polling at a fixed rate can
+	/// simply keep their previous sample and try again next cycle.
+	///
+	/// \param[out] sample The latest values. Unspecified if the method fails.
+	/// \param[in] maxAttempts The number of copies to attempt.
+	/// \return <c>true</c> if a consistent sample was copied.
+	bool latestSample(Sample& sample, size_t maxAttempts = xplat::SeqLock<Sample>::DefaultMaxAttempts);
+
+	/// \brief Returns the capacity of the history of received packets.
+	///
+	/// \return The capacity, or 0 if the history is disabled.
+	size_t historyCapacity();
+
+	/// \brief Keeps the data of every received packet until it is retrieved
+	///     with \ref getNextBatch, instead of only the most recent one.
+	///
+	/// Any samples not yet retrieved are discarded. When the history is full
+	/// the oldest sample is overwritten and counted by
+	/// \ref numOfHistoryOverflows. The history is disabled by default.
+	///
+	/// \param[in] capacity The number of samples to keep, or 0 to disable
+	///     the history.
+	void setHistoryCapacity(size_t capacity);
+
+	/// \brief Moves up to maxCount of the oldest samples from the history,
+	///     waiting if there are none yet.
+	///
+	/// The samples are copied into the first elements of batch, which is
+	/// grown as needed but never shrunk. Passing the same vector on every
+	/// call therefore stops allocating once it has grown to maxCount.
+	///
+	/// \param[in,out] batch Receives the samples, oldest first.
+	/// \param[in] maxCount The maximum number of samples to retrieve.
+	/// \param[in] timeoutMs The number of milliseconds to wait for a sample.
+	/// \return The number of samples retrieved.
+	/// \exception timeout No sample was received by the timeout.
+	/// \exception invalid_operation The history is disabled.
+	size_t getNextBatch(std::vector<CompositeData>& batch, size_t maxCount, int timeoutMs);
+
+	/// \brief Moves up to maxCount of the oldest samples from the history,
+	///     waiting if there are none yet.
+	///
+	/// \param[in] maxCount The maximum number of samples to retrieve.
+	/// \param[in] timeoutMs The number of milliseconds to wait for a sample.
+	/// \return The samples, oldest first.
+	/// \exception timeout No sample was received by the timeout.
+	/// \exception invalid_operation The history is disabled.
+	std::vector<CompositeData> getNextBatch(size_t maxCount, int timeoutMs);
+
+	/// \brief Returns the number of samples overwritten in the history
+	///     before they were retrieved.
+	///
+	/// \return The number of samples lost to overflows.
+	uint64_t numOfHistoryOverflows();
+
 private:
 	static void asyncPacketReceivedHandler(void* userData, protocol::uart::Packet& p, size_t index);
 
+	void publishSample();
+
 private:
 	VnSensor* _sensor;
 	xplat::CriticalSection _mainCS, _copyCS;
 	CompositeData _persistentData, _nextData;
 	xplat::Event _newDataEvent;
+	xplat::SeqLock<Sample> _latest;
+	uint64_t _numOfPackets;
+
+	// Ring of samples not yet retrieved, guarded by _copyCS.
+	std::vector<CompositeData> _history;
+	size_t _historyStart, _historyCount;
+	uint64_t _historyOverflows;
+	xplat::Event _historyEvent;
 };
 
 }
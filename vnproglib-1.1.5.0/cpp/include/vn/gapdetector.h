@@ -0,0 +1,112 @@
+#ifndef _VNSENSORS_GAPDETECTOR_H_
+#define _VNSENSORS_GAPDETECTOR_H_
+
+#include "vn/int.h"
+#include "vn/export.h"
+#include "vn/vntime.h"
+#include "vn/compositedata.h"
+
+namespace vn {
+namespace sensors {
+
+/// \brief Detects gaps in the sensor's own counters.
+///
+/// Feeding every parsed asynchronous packet through a GapDetector tells how
+/// many samples the sensor produced that never reached the application. By
+/// comparing this with the line counters from
+/// \ref vn::xplat::SerialPort::lineStatistics it is possible to tell data lost
+/// on the wire (overruns, framing errors) from data lost in software (packets
+/// dropped by a slow consumer).
+class vn_proglib_DLLEXPORT GapDetector
+{
+
+public:
+
+	/// \brief Accumulated gap statistics.
+	struct Statistics
+	{
+		/// \brief Number of packets processed.
+		uint64_t numOfPackets;
+
+		/// \brief Number of discontinuities found in <c>TimeStartup</c>.
+		uint64_t timeStartupGaps;
+
+		/// \brief Estimated number of packets missing based on
+		///     <c>TimeStartup</c>.
+		uint64_t missingPackets;
+
+		/// \brief Number of times <c>SyncInCnt</c> advanced by more than one
+		///     between packets.
+		///
+		/// <c>SyncInCnt</c> counts SyncIn edges, not packets, so this is only
+		/// a diagnostic of the SyncIn signal and is not counted as a gap.
+		uint64_t syncInCntGaps;
+
+		/// \brief Number of SyncIn edges between packets beyond the first.
+		uint64_t missingSyncInCnts;
+
+		/// \brief Number of times the sensor's counters went backwards, which
+		///     indicates the sensor was reset.
+		uint64_t sensorResets;
+
+		/// \brief Host time the most recent gap was detected.
+		xplat::TimeStamp lastGap;
+
+		Statistics() :
+			numOfPackets(0),
+			timeStartupGaps(0),
+			missingPackets(0),
+			syncInCntGaps(0),
+			missingSyncInCnts(0),
+			sensorResets(0)
+		{ }
+	};
+
+	/// \brief Creates a new GapDetector.
+	///
+	/// \param[in] expectedPeriodNs The expected output period of the sensor in
+	///     nanoseconds. If 0, the period is learned from the smallest
+	///     <c>TimeStartup</c> increment seen.
+	explicit GapDetector(uint64_t expectedPeriodNs = 0);
+
+	/// \brief Checks the counters in a parsed packet for gaps.
+	///
+	/// Gaps are found from the <c>TimeStartup</c> interval between packets
+	/// compared to the output period, so packets without it are only
+	/// counted. <c>SyncInCnt</c> is tracked for
+	/// \ref Statistics::syncInCntGaps only.
+	///
+	/// \param[in] cd The parsed packet.
+	/// \return <c>true</c> if a gap was detected; otherwise <c>false</c>.
+	bool process(CompositeData& cd);
+
+	/// \brief Returns the accumulated statistics.
+	///
+	/// \return The statistics.
+	Statistics statistics() const;
+
+	/// \brief Returns the output period currently assumed.
+	///
+	/// \return The period in nanoseconds or 0 if not yet known.
+	uint64_t periodNs() const;
+
+	/// \brief Clears the statistics and tracked counter values.
+	void reset();
+
+private:
+	bool checkTimeStartup(uint64_t timeStartup);
+	void checkSyncInCnt(uint32_t syncInCnt);
+
+private:
+	uint64_t _expectedPeriodNs;
+	uint64_t _learnedPeriodNs;
+	bool _haveTimeStartup, _haveSyncInCnt;
+	uint64_t _lastTimeStartup;
+	uint32_t _lastSyncInCnt;
+	Statistics _stats;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,160 @@
+#ifndef _VN_MATH_GEODESY_H_
+#define _VN_MATH_GEODESY_H_
+
+#include <cstddef>
+
+#include "export.h"
+#include "vector.h"
+#include "matrix.h"
+
+namespace vn {
+namespace math {
+
+/// \defgroup wgs84_constants WGS84 Constants
+/// \brief The WGS84 ellipsoid, as used by the sensor's LLA and ECEF outputs.
+/// \{
+
+/// \brief Semi-major axis in meters.
+static const double WGS84_A = 6378137.0;
+
+/// \brief Flattening.
+static const double WGS84_F = 1.0 / 298.257223563;
+
+/// \brief Semi-minor axis in meters.
+static const double WGS84_B = WGS84_A * (1.0 - WGS84_F);
+
+/// \brief First eccentricity squared.
+static const double WGS84_E2 = WGS84_F * (2.0 - WGS84_F);
+
+/// \}
+
+/// \defgroup position_convertors Position Convertors
+/// \brief Conversions between latitude, longitude, altitude and earth-centered,
+///     earth-fixed positions.
+///
+/// Latitude and longitude are in degrees and altitude is in meters above the
+/// ellipsoid, as output by the sensor. ECEF positions are in meters.
+/// \{
+
+/// \brief Converts a latitude, longitude, altitude to an ECEF position.
+///
+/// \param[in] lla The latitude, longitude, altitude.
+/// \return The ECEF position.
+vec3d vn_proglib_DLLEXPORT lla2ecef(vec3d lla);
+
+/// \brief Converts an ECEF position to a latitude, longitude, altitude.
+///
+/// Uses Olson's closed form rather than iterating. From 3000 km below the
+/// surface to 1000 km above it the result is within 1e-8 m of the exact
+/// position, about the rounding of the ECEF input itself. The earth's center
+/// gives a latitude and longitude of 0.
+///
+/// \param[in] ecef The ECEF position.
+/// \return The latitude, longitude, altitude.
+vec3d vn_proglib_DLLEXPORT ecef2lla(vec3d ecef);
+
+/// \brief Converts latitudes, longitudes, altitudes to ECEF positions.
+///
+/// \param[in] lla The latitudes, longitudes, altitudes.
+/// \param[out] ecef The ECEF positions. May be the same array as lla.
+/// \param[in] count The number of positions.
+void vn_proglib_DLLEXPORT lla2ecef(const vec3d* lla, vec3d* ecef, size_t count);
+
+/// \brief Converts ECEF positions to latitudes, longitudes, altitudes.
+///
+/// \param[in] ecef The ECEF positions.
+/// \param[out] lla The latitudes, longitudes, altitudes. May be the same
+///     array as ecef.
+/// \param[in] count The number of positions.
+void vn_proglib_DLLEXPORT ecef2lla(const vec3d* ecef, vec3d* lla, size_t count);
+
+/// \}
+
+/// \brief A north, east, down frame tangent to the ellipsoid at a reference
+///     position, e.g. where the vehicle first got a fix.
+///
+/// The reference position's ECEF coordinates and the rotation from ECEF to
+/// NED are worked out once on construction, so converting a position costs
+/// one \ref lla2ecef or \ref ecef2lla and a matrix product.
+class vn_proglib_DLLEXPORT LocalTangentPlane
+{
+
+public:
+
+	/// \brief Creates a frame at latitude, longitude and altitude 0.
+	LocalTangentPlane();
+
+	/// \brief Creates a frame at a reference position.
+	///
+	/// \param[in] referenceLla The reference latitude, longitude, altitude.
+	explicit LocalTangentPlane(vec3d referenceLla);
+
+	/// \brief Returns the reference position.
+	///
+	/// \return The reference latitude, longitude, altitude.
+	vec3d referenceLla() const;
+
+	/// \brief Returns the reference position in ECEF.
+	///
+	/// \return The reference ECEF position.
+	vec3d referenceEcef() const;
+
+	/// \brief Returns the rotation from ECEF to NED axes.
+	///
+	/// \return The direction cosine matrix, whose rows are the north, east and
+	///     down axes in ECEF.
+	mat3d ecef2nedDcm() const;
+
+	/// \brief Converts an ECEF position to NED.
+	///
+	/// \param[in] ecef The ECEF position.
+	/// \return The position in meters north, east and down of the reference.
+	vec3d ecef2ned(vec3d ecef) const;
+
+	/// \brief Converts a NED position to ECEF.
+	///
+	/// \param[in] ned The position in meters north, east and down of the
+	///     reference.
+	/// \return The ECEF position.
+	vec3d ned2ecef(vec3d ned) const;
+
+	/// \brief Converts a latitude, longitude, altitude to NED.
+	///
+	/// \param[in] lla The latitude, longitude, altitude.
+	/// \return The position in meters north, east and down of the reference.
+	vec3d lla2ned(vec3d lla) const;
+
+	/// \brief Converts a NED position to a latitude, longitude, altitude.
+	///
+	/// \param[in] ned The position in meters north, east and down of the
+	///     reference.
+	/// \return The latitude, longitude, altitude.
+	vec3d ned2lla(vec3d ned) const;
+
+	/// \brief Converts latitudes, longitudes, altitudes to NED.
+	///
+	/// \param[in] lla The latitudes, longitudes, altitudes.
+	/// \param[out] ned The NED positions. May be the same array as lla.
+	/// \param[in] count The number of positions.
+	void lla2ned(const vec3d* lla, vec3d* ned, size_t count) const;
+
+	/// \brief Converts NED positions to latitudes, longitudes, altitudes.
+	///
+	/// \param[in] ned The NED positions.
+	/// \param[out] lla The latitudes, longitudes, altitudes. May be the same
+	///     array as ned.
+	/// \param[in] count The number of positions.
+	void ned2lla(const vec3d* ned, vec3d* lla, size_t count) const;
+
+private:
+	void init(vec3d referenceLla);
+
+	vec3d _referenceLla;
+	vec3d _referenceEcef;
+	mat3d _ecef2ned;
+};
+
+}
+}
+
+#endif
@@ -102,8 +102,8 @@ public:
 	{
 		assert(row < m && col < n);
 
-		//return e[col * m + row];
-		return e[col + row * m];
+		// Elements are stored column by column, as in the specializations.
+		return e[col * m + row];
 	}
 
 	/// \brief Negates the matrix.
@@ -127,47 +127,6 @@ public:
 		return *this;
 	}
 
-	/// \brief Multiplies the matrix by another matrix
-	///
-	/// \param[in] rhs The other matrix.
-	/// \return The multiplied matrix.
-	template<size_t r, size_t s, typename S>
-	mat& operator*(const mat<r, s, S>& rhs)
-	{
-		// columns from the matrix must match rows of the input matrix
-		if (m != s)
-		{
-			return *this;
-		}
-
-		size_t row = 0;
-		size_t col = 0;
-		size_t cell = 0;
-
-		mat<r, n, T> return_mat = zero();
-
-		// Remember, this matrix is stored in column order
-		for (size_t row_index = 0; row_index < r; row_index++)
-		{
-			for (size_t col_index = 0; col_index < n; col_index++)
-			{
-
-				cell = row_index + (col_index * r);
-
-				for (size_t cell_index = 0; cell_index < m; cell_index++)
-				{
-					// calculated for the cell in the current row
-					row = (col_index * m) + cell_index;
-					// calculated for the cell in the current column
-					col = (cell_index * r) + row_index;
-					return_mat.e[cell] += this->e[row] * rhs.e[col];
-				}
-			}
-		}
-
-		return return_mat;
-	}
-
 	/// \brief Divides the matrix by a scalar.
 	///
 	/// \param[in] rhs The scalar.
@@ -864,34 +823,7 @@ public:
 	template<typename S>
 	mat& operator*=(const mat<3, 3, S>& rhs)
 	{
-		size_t counter = 0;
-		size_t row = 0;
-		size_t col = 0;
-		size_t cell = 0;
-		mat<3, 3, T> return_mat = zero();
-
-		// Remember, this matrix is stored in column order
-		for(size_t row_index = 0; row_index < 3; row_index++)
-		{
-			for(size_t col_index = 0; col_index < 3; col_index++)
-			{
-				cell = row_index + (col_index * 3);
-
-				for (size_t cell_index = 0; cell_index < 3; cell_index++)
-				{
-					// calculated for the cell in the current row
-					row = row_index + (cell_index * 3);
-					// calculated for the cell in the current column
-					col = cell_index + (col_index * 3);
-
-					return_mat.e[cell] += this->e[row] * rhs.e[col];
-				}
-			}
-		}
-
-		// std::copy(return_mat.e[0], return_mat.e[8], this->e[0]);
-		// std::copy(return_mat.e, return_mat.e + 7, this->e);
-		*this = return_mat;
+		*this = mult(rhs);
 
 		return *this;
 	}
@@ -1041,17 +973,125 @@ public:
 	/// \return The computed transpose.
 	mat<3, 3, T> transpose() const
 	{
-		mat<3, 3, T> nm;
+		return mat<3, 3, T>(
+			e00, e10, e20,
+			e01, e11, e21,
+			e02, e12, e22);
+	}
 
-		for (size_t row = 0; row < 3; row++)
+	/// \brief Multiplies the matrix by another matrix.
+	///
+	/// \param[in] rhs The right-side matrix.
+	/// \return The product of the matrix and rhs.
+	template<typename S>
+	mat<3, 3, T> mult(const mat<3, 3, S>& rhs) const
+	{
+		// Each column of the product is this matrix applied to the matching
+		// column of rhs. Written out so compilers keep every element in a
+		// register and can vectorize across the rows.
+		mat<3, 3, T> r;
+
+		for (size_t col = 0; col < 3; col++)
 		{
-			for (size_t col = 0; col < 3; col++)
-			{
-				nm.e[row * 3 + col] = e[col * 3 + row];
-			}
+			const S* b = rhs.e + col * 3;
+
+			r.e[col * 3 + 0] = e00 * b[0] + e01 * b[1] + e02 * b[2];
+			r.e[col * 3 + 1] = e10 * b[0] + e11 * b[1] + e12 * b[2];
+			r.e[col * 3 + 2] = e20 * b[0] + e21 * b[1] + e22 * b[2];
 		}
 
-		return nm;
+		return r;
+	}
+
+	/// \brief Multiplies a vector by the matrix, e.g. to rotate it from one
+	///     frame to another with a direction cosine matrix.
+	///
+	/// \param[in] v The vector.
+	/// \return The product of the matrix and v.
+	vec<3, T> mult(const vec<3, T>& v) const
+	{
+		return vec<3, T>(
+			e00 * v.x + e01 * v.y + e02 * v.z,
+			e10 * v.x + e11 * v.y + e12 * v.z,
+			e20 * v.x + e21 * v.y + e22 * v.z);
+	}
+
+	/// \brief Multiplies a vector by the transpose of the matrix, which for
+	///     a rotation is the rotation back.
+	///
+	/// \param[in] v The vector.
+	/// \return The product of the transposed matrix and v.
+	vec<3, T> transposeMult(const vec<3, T>& v) const
+	{
+		return vec<3, T>(
+			e00 * v.x + e10 * v.y + e20 * v.z,
+			e01 * v.x + e11 * v.y + e21 * v.z,
+			e02 * v.x + e12 * v.y + e22 * v.z);
+	}
+
+	/// \brief Multiplies the difference of two vectors by the matrix, e.g.
+	///     to express the offset between two positions in a local frame.
+	///
+	/// Same as <c>*this * (a - b)</c> without the intermediate vector.
+	///
+	/// \param[in] a The vector subtracted from.
+	/// \param[in] b The vector subtracted.
+	/// \return The product of the matrix and a - b.
+	vec<3, T> multDifference(const vec<3, T>& a, const vec<3, T>& b) const
+	{
+		T x = a.x - b.x;
+		T y = a.y - b.y;
+		T z = a.z - b.z;
+
+		return vec<3, T>(
+			e00 * x + e01 * y + e02 * z,
+			e10 * x + e11 * y + e12 * z,
+			e20 * x + e21 * y + e22 * z);
+	}
+
+	/// \brief Multiplies another matrix by the transpose of this one, e.g. to
+	///     find the rotation between two frames.
+	///
+	/// Same as <c>transpose() * rhs</c> without forming the transpose.
+	///
+	/// \param[in] rhs The right-side matrix.
+	/// \return The product of the transposed matrix and rhs.
+	template<typename S>
+	mat<3, 3, T> transposeMult(const mat<3, 3, S>& rhs) const
+	{
+		// Built through the element constructor rather than a loop over a
+		// local so the result is written once, straight to its destination.
+		return mat<3, 3, T>(
+			e00 * rhs.e00 + e10 * rhs.e10 + e20 * rhs.e20,
+			e00 * rhs.e01 + e10 * rhs.e11 + e20 * rhs.e21,
+			e00 * rhs.e02 + e10 * rhs.e12 + e20 * rhs.e22,
+			e01 * rhs.e00 + e11 * rhs.e10 + e21 * rhs.e20,
+			e01 * rhs.e01 + e11 * rhs.e11 + e21 * rhs.e21,
+			e01 * rhs.e02 + e11 * rhs.e12 + e21 * rhs.e22,
+			e02 * rhs.e00 + e12 * rhs.e10 + e22 * rhs.e20,
+			e02 * rhs.e01 + e12 * rhs.e11 + e22 * rhs.e21,
+			e02 * rhs.e02 + e12 * rhs.e12 + e22 * rhs.e22);
+	}
+
+	/// \brief Multiplies the matrix by the transpose of another.
+	///
+	/// Same as <c>*this * rhs.transpose()</c> without forming the transpose.
+	///
+	/// \param[in] rhs The matrix whose transpose is the right side.
+	/// \return The product of the matrix and the transpose of rhs.
+	template<typename S>
+	mat<3, 3, T> multTranspose(const mat<3, 3, S>& rhs) const
+	{
+		return mat<3, 3, T>(
+			e00 * rhs.e00 + e01 * rhs.e01 + e02 * rhs.e02,
+			e00 * rhs.e10 + e01 * rhs.e11 + e02 * rhs.e12,
+			e00 * rhs.e20 + e01 * rhs.e21 + e02 * rhs.e22,
+			e10 * rhs.e00 + e11 * rhs.e01 + e12 * rhs.e02,
+			e10 * rhs.e10 + e11 * rhs.e11 + e12 * rhs.e12,
+			e10 * rhs.e20 + e11 * rhs.e21 + e12 * rhs.e22,
+			e20 * rhs.e00 + e21 * rhs.e01 + e22 * rhs.e02,
+			e20 * rhs.e10 + e21 * rhs.e11 + e22 * rhs.e12,
+			e20 * rhs.e20 + e21 * rhs.e21 + e22 * rhs.e22);
 	}
 };
 
@@ -1503,15 +1543,51 @@ mat<m, n, T> operator*(const S& lhs, mat<m, n, T> rhs)
 /// \brief Multiplies two matrices together.
 ///
 /// \param[in] lhs The left-side matrix.
+/// \param[in] rhs The right-side matrix, with as many rows as lhs has
+///     columns.
+/// \return The result.
+template <size_t m, size_t n, typename T, size_t s, typename S>
+mat<m, s, T> operator*(const mat<m, n, T>& lhs, const mat<n, s, S>& rhs)
+{
+	// Elements are stored column by column.
+	mat<m, s, T> r;
+
+	for (size_t col = 0; col < s; col++)
+	{
+		for (size_t row = 0; row < m; row++)
+		{
+			T sum = 0;
+
+			for (size_t k = 0; k < n; k++)
+				sum += lhs.e[k * m + row] * rhs.e[col * n + k];
+
+			r.e[col * m + row] = sum;
+		}
+	}
+
+	return r;
+}
+
+/// \brief Multiplies two 3x3 matrices together.
+///
+/// \param[in] lhs The left-side matrix.
 /// \param[in] rhs The right-side matrix.
 /// \return The result.
-template <size_t m, size_t n, typename T, size_t r, size_t s, typename S>
-mat<m, n, T> operator*(mat<m, n, T>&lhs, const mat<r, s, S>& rhs)
+template <typename T, typename S>
+mat<3, 3, T> operator*(const mat<3, 3, T>& lhs, const mat<3, 3, S>& rhs)
 {
-	mat<m, n, T> tmp = lhs;
-	tmp *= rhs;
+	return lhs.mult(rhs);
+}
 
-	return tmp;
+/// \brief Multiplies a vector by a 3x3 matrix.
+///
+/// \param[in] lhs The matrix.
+/// \param[in] rhs The vector.
+/// \return The result.
+template <typename T>
+vec<3, T> operator*(const mat<3, 3, T>& lhs, const vec<3, T>& rhs)
+{
+	return lhs.mult(rhs);
 }
 
 /// \brief Divides a matrix by a scalar.
@@ -26,10 +26,27 @@ namespace util {
 
 /// \brief Useful test class for taking place where \ref vn::common::ISimplePort may be
 ///     used.
+///
+/// Data provided through \ref feed is buffered in an internal ring and read
+/// back through \ref read like data from a serial port, including partial
+/// reads. Fed data can be delivered immediately on the caller's thread, or
+/// from an internal delivery thread either as fast as possible or paced by
+/// the recorded timestamps of the chunks, which allows replaying a recording
+/// through a \ref vn::sensors::VnSensor deterministically and without a tty.
 class MemoryPort : public xplat::IPort, private NoCopy
 {
+public:
+
 	typedef void(*DataWrittenHandler)(void* userData, const char* rawData, size_t length);
 
+	/// \brief How fed data is delivered to readers.
+	enum Pacing
+	{
+		PACING_IMMEDIATE,			///< Delivered on the thread calling feed.
+		PACING_ASFASTASPOSSIBLE,	///< Delivered from the delivery thread without delay.
+		PACING_REALTIME				///< Delivered from the delivery thread at the recorded timestamps.
+	};
+
 	// Constructors ///////////////////////////////////////////////////////////
 
 public:
@@ -37,6 +54,12 @@ public:
 	/// \brief Creates a new \ref MemoryPort.
 	MemoryPort();
 
+	/// \brief Creates a new \ref MemoryPort with the specified receive
+	///     buffer size.
+	///
+	/// \param[in] bufferSize The size of the internal ring in bytes.
+	explicit MemoryPort(size_t bufferSize);
+
 	~MemoryPort();
 
 	// Public Methods /////////////////////////////////////////////////////////
@@ -68,6 +91,52 @@ public:
 	/// \brief Unregisters the registered callback method.
 	void unregisterDataWrittenHandler();
 
+	/// \brief Sets how fed data is delivered. Must be called while the port
+	///     is closed.
+	///
+	/// \param[in] pacing The pacing mode.
+	/// \param[in] speed For \ref PACING_REALTIME, the replay speed relative
+	///     to the recording, e.g. 2.0 replays twice as fast.
+	void setPacing(Pacing pacing, double speed = 1.0);
+
+	/// \brief Returns the current pacing mode.
+	///
+	/// \return The pacing mode.
+	Pacing pacing();
+
+	/// \brief Provides data to be read from the port.
+	///
+	/// \param[in] data Data buffer containing the data.
+	/// \param[in] length The number of data bytes.
+	void feed(const char data[], size_t length);
+
+	/// \brief Provides recorded data to be read from the port.
+	///
+	/// With \ref PACING_REALTIME the data is delivered when the same amount
+	/// of time has passed since the first timestamped chunk as was recorded.
+	///
+	/// \param[in] data Data buffer containing the data.
+	/// \param[in] length The number of data bytes.
+	/// \param[in] timestampNs The time the data was recorded in nanoseconds.
+	void feed(const char data[], size_t length, uint64_t timestampNs);
+
+	/// \brief Blocks until all fed data has been delivered and read.
+	///
+	/// \param[in] timeoutMs The maximum time to wait in milliseconds.
+	/// \return <c>true</c> if all data was consumed; <c>false</c> if timed out.
+	bool waitUntilDrained(uint32_t timeoutMs);
+
+	/// \brief Returns the number of bytes available for reading.
+	///
+	/// \return The number of bytes in the internal ring.
+	size_t bytesAvailable();
+
+	/// \brief Returns the number of bytes discarded because the internal
+	///     ring was full, similar to a UART overrun.
+	///
+	/// \return The number of bytes dropped.
+	size_t numOfBytesDropped();
+
 	/// \brief Sends data to the \ref MemoryPort which can then be read by
 	///     \ref read.
 	///
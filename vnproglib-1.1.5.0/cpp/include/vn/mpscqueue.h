@@ -0,0 +1,131 @@
+#ifndef _VNXPLAT_MPSCQUEUE_H_
+#define _VNXPLAT_MPSCQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+
+#include "nocopy.h"
+
+namespace vn {
+namespace xplat {
+
+/// \brief A bounded lock-free queue for many producers and a single
+///     consumer.
+///
+/// Producers never block: \ref tryPush fails when the queue is full. Every
+/// slot carries a sequence number telling producers and the consumer whether
+/// it is free or holds an item, so no locks are needed and no memory is
+/// allocated after construction.
+///
+/// \tparam T The item type. Items are copied in and out of preallocated
+///     slots, so T should be cheap to copy and default constructible.
+template<typename T>
+class MpscQueue : private util::NoCopy
+{
+
+public:
+
+	/// \brief Creates a new queue.
+	///
+	/// \param[in] capacity The maximum number of items, rounded up to a
+	///     power of two.
+	explicit MpscQueue(size_t capacity) :
+		_enqueuePos(0),
+		_dequeuePos(0)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+
+		_mask = size - 1;
+		_cells = new Cell[size];
+
+		for (size_t i = 0; i < size; i++)
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	~MpscQueue()
+	{
+		delete[] _cells;
+	}
+
+	/// \brief Adds an item. May be called from any number of threads.
+	///
+	/// \param[in] item The item to add.
+	/// \return <c>true</c> if the item was added; <c>false</c> if the queue
+	///     was full.
+	bool tryPush(const T& item)
+	{
+		size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+
+		while (true)
+		{
+			Cell& cell = _cells[pos & _mask];
+			size_t seq = cell.sequence.load(std::memory_order_acquire);
+			ptrdiff_t diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+
+			if (diff == 0)
+			{
+				if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell.data = item;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = _enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/// \brief Removes the oldest item. Must only be called from one thread
+	///     at a time.
+	///
+	/// \param[out] item The removed item.
+	/// \return <c>true</c> if an item was removed; <c>false</c> if the queue
+	///     was empty.
+	bool tryPop(T& item)
+	{
+		Cell& cell = _cells[_dequeuePos & _mask];
+		size_t seq = cell.sequence.load(std::memory_order_acquire);
+
+		if (static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(_dequeuePos + 1) < 0)
+			return false;
+
+		item = cell.data;
+		cell.sequence.store(_dequeuePos + _mask + 1, std::memory_order_release);
+		_dequeuePos++;
+
+		return true;
+	}
+
+private:
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T data;
+	};
+
+	Cell* _cells;
+	size_t _mask;
+
+	// Producers and the consumer work on different ends, so keep their
+	// positions on separate cache lines.
+	char _pad0[64];
+	std::atomic<size_t> _enqueuePos;
+	char _pad1[64];
+	size_t _dequeuePos;
+};
+
+}
+}
+
+#endif
@@ -55,6 +55,16 @@ struct vn_proglib_DLLEXPORT Packet
 	/// \return The packet data.
 	std::string datastr();
 
+	/// \brief Returns the encapsulated data without copying it.
+	///
+	/// \return Pointer to the packet data, valid while the packet is.
+	const char* data() const;
+
+	/// \brief Returns the number of bytes in the packet.
+	///
+	/// \return The packet length.
+	size_t length() const;
+
 	/// \brief Returns the type of packet.
 	///
 	/// \return The type of packet.
@@ -349,6 +359,15 @@ struct vn_proglib_DLLEXPORT Packet
 	/// \return The total number bytes in the generated command.
 	static size_t genKnownAccelerationDisturbance(ErrorDetectionMode errorDetectionMode, char *buffer, size_t size, bool isAccelerationDisturbancePresent);
 
+	/// \brief Generates a command to pause or resume the asynchronous outputs.
+	///
+	/// \param[in] errorDetectionMode The type of error-detection to use in generating the command.
+	/// \param[in] buffer Caller provided buffer to place the generated command.
+	/// \param[in] size Number of bytes available in the provided buffer.
+	/// \param[in] enable Indicates if the asynchronous outputs are resumed or paused.
+	/// \return The total number bytes in the generated command.
+	static size_t genAsyncOutputEnable(ErrorDetectionMode errorDetectionMode, char *buffer, size_t size, bool enable);
+
 	/// \brief Generates a command to set the gyro bias.
 	///
 	/// \param[in] errorDetectionMode The type of error-detection to use in generating the command.
@@ -66,6 +66,20 @@ public:
 	/// \param[in] timestamp The time when the data was received.
 	void processReceivedData(char data[], size_t length, xplat::TimeStamp timestamp);
 
+	/// \brief Adds new data to the internal buffers and processes the received
+	/// data to determine if any new received packets are available.
+	///
+	/// Each packet found is stamped with the time its start byte arrived,
+	/// estimated by back-dating from the last byte in the buffer using the
+	/// time it takes to transfer a byte on the wire.
+	///
+	/// \param[in] data The data buffer containing the received data.
+	/// \param[in] length The number of bytes of data in the buffer.
+	/// \param[in] timestampOfLastByte The time when the last byte in the
+	///     buffer was received.
+	/// \param[in] byteTimeNs The time to transfer a single byte in nanoseconds.
+	void processReceivedData(char data[], size_t length, xplat::TimeStamp timestampOfLastByte, uint32_t byteTimeNs);
+
 	#if PYTHON
 
 	void processReceivedData(boost::python::list data);
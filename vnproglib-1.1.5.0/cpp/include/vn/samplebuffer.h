@@ -0,0 +1,158 @@
+#ifndef _VNSENSORS_SAMPLEBUFFER_H_
+#define _VNSENSORS_SAMPLEBUFFER_H_
+
+#include <vector>
+
+#include "vn/int.h"
+#include "vn/export.h"
+#include "vn/nocopy.h"
+#include "vn/vector.h"
+#include "vn/compositedata.h"
+#include "vn/criticalsection.h"
+
+namespace vn {
+namespace sensors {
+
+/// \brief Keeps recent samples ordered by time so the sensor's state can be
+///     looked up at an arbitrary time, e.g. the exposure time of a camera.
+///
+/// Samples are keyed by a time in nanoseconds chosen by the caller, usually
+/// the sensor's <c>TimeStartup</c> or the corrected host time returned by
+/// \ref ClockSync::process. Lookups binary search the keys, which are kept in
+/// their own contiguous array apart from the sample values.
+///
+/// All methods may be called from any thread.
+class vn_proglib_DLLEXPORT SampleBuffer : private util::NoCopy
+{
+
+public:
+
+	/// \brief The values kept for each sample.
+	struct Sample
+	{
+		int64_t timeNs;							///< The sample's key.
+		bool hasQuaternion;
+		bool hasAngularRate;
+		bool hasAcceleration;
+		bool hasMagnetic;
+		bool hasVelocityEstimatedNed;
+		bool hasPositionEstimatedLla;
+		bool hasDeltaTheta;
+		bool hasDeltaVelocity;
+		math::vec4f quaternion;					///< Attitude quaternion, scalar last.
+		math::vec3f angularRate;				///< Compensated angular rate in rad/s.
+		math::vec3f acceleration;				///< Compensated acceleration in m/s^2.
+		math::vec3f magnetic;					///< Compensated magnetic field in Gauss.
+		math::vec3f velocityEstimatedNed;		///< Estimated NED velocity in m/s.
+		math::vec3d positionEstimatedLla;		///< Estimated latitude, longitude (degrees) and altitude (m).
+		math::vec3f deltaTheta;					///< Rotation since the previous output in degrees.
+		math::vec3f deltaVelocity;				///< Velocity change since the previous output in m/s.
+		float deltaTime;						///< Integration time of the deltas in seconds; 0 if unknown.
+
+		Sample();
+	};
+
+	/// \brief Creates a new buffer.
+	///
+	/// \param[in] capacity The number of samples to keep. Once full, each
+	///     new sample replaces the oldest.
+	/// \exception invalid_argument capacity is 0.
+	explicit SampleBuffer(size_t capacity);
+
+	/// \brief Adds a parsed packet keyed by its <c>TimeStartup</c>.
+	///
+	/// \param[in] cd The parsed packet.
+	/// \return <c>true</c> if the packet was added; <c>false</c> if it had
+	///     no <c>TimeStartup</c>.
+	bool add(CompositeData& cd);
+
+	/// \brief Adds a parsed packet with the provided key.
+	///
+	/// \param[in] cd The parsed packet.
+	/// \param[in] timeNs The packet's time in nanoseconds.
+	void add(CompositeData& cd, int64_t timeNs);
+
+	/// \brief Adds a sample.
+	///
+	/// Keys must increase. A key not after the newest one restarts the
+	/// buffer, e.g. after the sensor was reset.
+	///
+	/// \param[in] sample The sample.
+	void add(const Sample& sample);
+
+	/// \brief Returns the number of samples held.
+	///
+	/// \return The number of samples.
+	size_t size();
+
+	/// \brief Returns the number of samples that can be held.
+	///
+	/// \return The capacity.
+	size_t capacity();
+
+	/// \brief Discards all samples.
+	void clear();
+
+	/// \brief Returns the keys of the oldest and newest samples.
+	///
+	/// \param[out] oldestNs The key of the oldest sample.
+	/// \param[out] newestNs The key of the newest sample.
+	/// \return <c>true</c> if the buffer holds any samples.
+	bool timeSpan(int64_t& oldestNs, int64_t& newestNs);
+
+	/// \brief Returns the state at a time between two samples.
+	///
+	/// Vectors are interpolated linearly and the quaternion spherically
+	/// between the samples on either side of timeNs. A value is only
+	/// present if both samples have it. The deltas are those of the later
+	/// sample.
+	///
+	/// \param[in] timeNs The time to look up.
+	/// \param[out] sample The interpolated state, with the key timeNs.
+	/// \return <c>true</c> if timeNs lies within the buffered samples; no
+	///     extrapolation is done.
+	bool sampleAt(int64_t timeNs, Sample& sample);
+
+	/// \brief Sums the delta angles and delta velocities over a time span.
+	///
+	/// Each sample's deltas are taken to accrue evenly over its integration
+	/// time, so samples partly inside the span contribute in proportion.
+	/// The deltas are summed as vectors, which ignores coning and sculling
+	/// within the span.
+	///
+	/// \param[in] startNs The start of the span.
+	/// \param[in] endNs The end of the span.
+	/// \param[out] deltaTheta The rotation over the span in degrees.
+	/// \param[out] deltaVelocity The velocity change over the span in m/s.
+	/// \return <c>true</c> if the span is covered by samples with both
+	///     deltas; otherwise <c>false</c>.
+	bool integrate(int64_t startNs, int64_t endNs, math::vec3f& deltaTheta, math::vec3f& deltaVelocity);
+
+private:
+
+	// Index of the first sample with a key not before timeNs, or _count.
+	// Must be called with _cs held.
+	size_t lowerBound(int64_t timeNs) const;
+
+	// Must be called with _cs held.
+	size_t slot(size_t i) const
+	{
+		return (_start + i) % _samples.size();
+	}
+
+	// Start of the time the sample's deltas accrued over. Must be called
+	// with _cs held.
+	int64_t intervalStartNs(size_t i) const;
+
+private:
+	xplat::CriticalSection _cs;
+	std::vector<int64_t> _times;
+	std::vector<Sample> _samples;
+	size_t _start;
+	size_t _count;
+};
+
+}
+}
+
+#endif
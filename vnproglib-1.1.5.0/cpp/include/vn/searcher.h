@@ -16,6 +16,18 @@ class vn_proglib_DLLEXPORT Searcher
 
 public:
 
+	/// \brief Defines a callback handler that is notified as soon as a search
+	///     finds a sensor.
+	///
+	/// \param[in] userData Pointer to user data that was supplied to the
+	///     search.
+	/// \param[in] portName The serial port the sensor was found on.
+	/// \param[in] baudrate The baudrate the sensor is communicating at.
+	typedef void (*SensorFoundHandler)(void* userData, const std::string &portName, uint32_t baudrate);
+
+	/// \brief The time allowed by the searches that do not take a timeout.
+	static const uint32_t DefaultSearchTimeoutMs = 1000;
+
 	/// \brief Searches the serial port at all valid baudrates for a VectorNav
 	///     sensor.
 	///
@@ -47,6 +59,33 @@ public:
 	/// \return Collection of serial ports and baudrates for all found sensors.
 	static std::vector<std::pair<std::string, uint32_t> > search(std::vector<std::string>& portsToCheck);
 
+	/// \brief Checks the provided list of serial ports for any connected
+	///     VectorNav sensors within a fixed amount of time.
+	///
+	/// All ports are probed at once from a single event loop on the calling
+	/// thread. Each port cycles through the supported baudrates, sending a
+	/// read of the Model Number register at each and accepting any valid
+	/// packet in reply, and the time spent at each baudrate grows with every
+	/// pass. A port is dropped from the loop as soon as a sensor is found on
+	/// it, and the search returns when every port has a sensor or the
+	/// timeout expires. Every port is closed on return.
+	///
+	/// On Windows the ports are instead searched by jobs on
+	/// \ref xplat::ThreadPool::shared and the timeout is not enforced.
+	///
+	/// \param[in] portsToCheck List of serial ports to check for sensors.
+	/// \param[in] timeoutMs The maximum time to search for.
+	/// \param[in] handler Optional handler notified on the calling thread as
+	///     each sensor is found.
+	/// \param[in] userData Pointer to user data passed to the handler.
+	/// \return Collection of serial ports and baudrates for all found
+	///     sensors, in the order they were found.
+	static std::vector<std::pair<std::string, uint32_t> > search(
+		const std::vector<std::string>& portsToCheck,
+		uint32_t timeoutMs,
+		SensorFoundHandler handler = NULL,
+		void* userData = NULL);
+
 	/// \brief Tests if a sensor is connected to the serial port at the
 	///     specified baudrate.
 	///
@@ -54,6 +93,39 @@ public:
 	/// \param[in] baudrate The baudrate to test at.
 	/// \returns <c>true</c> if a sensor if found; otherwise <c>false</c>.
 	static bool test(std::string portName, uint32_t baudrate);
+
+	/// \brief Tests if a sensor is connected to the serial port at the
+	///     specified baudrate, with control over how long to wait.
+	///
+	/// The port is first watched for any valid packet, which a sensor with
+	/// asynchronous output enabled sends without being asked. If none is
+	/// seen, a read of the Model Number register is sent up to numOfProbes
+	/// times.
+	///
+	/// \param[in] portName The serial port to test.
+	/// \param[in] baudrate The baudrate to test at.
+	/// \param[in] listenMs How long to listen before sending anything.
+	/// \param[in] numOfProbes The number of reads to send. May be 0.
+	/// \param[in] probeTimeoutMs How long to wait for a response to each read.
+	/// \returns <c>true</c> if a sensor if found; otherwise <c>false</c>.
+	static bool test(std::string portName, uint32_t baudrate, uint32_t listenMs, size_t numOfProbes, uint32_t probeTimeoutMs);
+
+	/// \brief Searches the serial port for a VectorNav sensor, trying the
+	///     likely baudrates first and keeping every wait short.
+	///
+	/// Each likely baudrate is listened to and then probed. The remaining
+	/// supported baudrates are then listened to without sending anything,
+	/// since a streaming sensor identifies itself within a packet period,
+	/// and only then probed with short timeouts. The probe timeouts grow
+	/// with the time the command and response take on the wire.
+	///
+	/// \param[in] portName The serial port to search.
+	/// \param[in] likelyBaudrates Baudrates to try first, e.g. the last one
+	///     the sensor was found at.
+	/// \param[out] foundBaudrate If a sensor is found, this will be set to the
+	///     baudrate the sensor is communicating at.
+	/// \returns <c>true</c> if a sensor if found; otherwise <c>false</c>.
+	static bool quickSearch(const std::string &portName, const std::vector<uint32_t> &likelyBaudrates, uint32_t *foundBaudrate);
 };
 
 }
@@ -0,0 +1,113 @@
+#ifndef _VNSENSORS_SENSORHUB_H_
+#define _VNSENSORS_SENSORHUB_H_
+
+#include <cstddef>
+
+#include "vn/int.h"
+#include "vn/export.h"
+#include "vn/nocopy.h"
+#include "vn/sensors.h"
+
+namespace vn {
+namespace sensors {
+
+/// \brief Services the serial ports of many sensors from a few I/O threads.
+///
+/// Normally every connected \ref VnSensor has a notification thread of its
+/// own. Sensors added to a hub are instead waited on together with
+/// <c>epoll</c> by one of the hub's threads, which then runs each sensor's
+/// usual packet finding and dispatch. Every sensor keeps its own framing
+/// state, and each wakeup reads at most one buffer per sensor, starting at a
+/// different sensor every time, so a busy sensor cannot starve the others.
+///
+/// Sensors may be added before or after they are connected and stay on the
+/// hub across reconnects. A sensor must be removed from the hub before it is
+/// destroyed, or outlive the hub.
+class vn_proglib_DLLEXPORT SensorHub : private util::NoCopy
+{
+
+public:
+
+	/// \brief Counters for a sensor serviced by the hub.
+	struct SensorStats
+	{
+		/// \brief Number of times data from the sensor was handled.
+		uint64_t numOfNotifications;
+
+		/// \brief Number of times a port of the sensor was attached, e.g. on
+		///     connecting and reconnecting.
+		uint64_t numOfAttachments;
+
+		/// \brief Number of times the port reported an error or hangup and
+		///     stopped being waited on.
+		uint64_t numOfHangups;
+
+		/// \brief Total time spent handling the sensor's data.
+		uint64_t totalDispatchNs;
+
+		/// \brief Longest time spent handling the sensor's data once.
+		uint64_t maxDispatchNs;
+
+		/// \brief Longest time the sensor's data waited for other sensors to
+		///     be handled after the thread woke up.
+		uint64_t maxWaitNs;
+
+		SensorStats() :
+			numOfNotifications(0),
+			numOfAttachments(0),
+			numOfHangups(0),
+			totalDispatchNs(0),
+			maxDispatchNs(0),
+			maxWaitNs(0)
+		{ }
+	};
+
+	/// \brief Creates a hub and starts its threads.
+	///
+	/// \param[in] numOfThreads The number of I/O threads. Sensors are spread
+	///     evenly over them.
+	/// \param[in] cpu The CPU to pin the threads to, or -1 to leave them to
+	///     the scheduler.
+	/// \exception invalid_argument numOfThreads is 0.
+	/// \exception not_supported The platform does not provide <c>epoll</c>.
+	/// \exception unknown_error The threads could not be set up or pinned.
+	explicit SensorHub(size_t numOfThreads = 1, int cpu = -1);
+
+	/// \brief Removes all sensors, which go back to their own notification
+	///     threads, and stops the hub's threads.
+	~SensorHub();
+
+	/// \brief Starts servicing a sensor.
+	///
+	/// \param[in] sensor The sensor.
+	/// \exception invalid_operation The sensor was already added.
+	void add(VnSensor& sensor);
+
+	/// \brief Stops servicing a sensor. A connected sensor goes back to its
+	///     own notification thread.
+	///
+	/// \param[in] sensor The sensor.
+	/// \exception not_found The sensor was not added.
+	void remove(VnSensor& sensor);
+
+	/// \brief Returns the number of sensors serviced by the hub.
+	///
+	/// \return The number of sensors.
+	size_t size();
+
+	/// \brief Returns the counters for a sensor.
+	///
+	/// \param[in] sensor The sensor.
+	/// \return The counters.
+	/// \exception not_found The sensor was not added.
+	SensorStats stats(VnSensor& sensor);
+
+private:
+	struct Impl;
+	Impl *_pi;
+};
+
+}
+}
+
+#endif
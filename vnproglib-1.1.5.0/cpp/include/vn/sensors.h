@@ -7,12 +7,15 @@
 
 #include <string>
 #include <vector>
+#include <future>
 
 #include "int.h"
 #include "nocopy.h"
 #include "packetfinder.h"
 #include "export.h"
 #include "registers.h"
+#include "serialport.h"
+#include "configurationprofile.h"
 
 #if PYTHON
 	#include "vn/event.h"
@@ -106,6 +109,65 @@ public:
 	///     the packet.
 	typedef void(*AsyncPacketReceivedHandler)(void* userData, protocol::uart::Packet& asyncPacket, size_t packetStartRunningIndex);
 
+	/// \brief Defines the signature for a method that can receive
+	/// notifications of when a new asynchronous data packet is received along
+	/// with the time the packet arrived.
+	///
+	/// \param[in] userData Pointer to user data that was initially supplied
+	///     when the callback was registered via registerTimedAsyncPacketReceivedHandler.
+	/// \param[in] asyncPacket The asynchronous packet received.
+	/// \param[in] packetStartRunningIndex The running index of the start of
+	///     the packet.
+	/// \param[in] timestamp The time the start of the packet was received.
+	typedef void(*TimedAsyncPacketReceivedHandler)(void* userData, protocol::uart::Packet& asyncPacket, size_t packetStartRunningIndex, xplat::TimeStamp timestamp);
+
+	/// \brief Selects the asynchronous packets delivered to a subscriber of
+	///     \ref subscribeAsyncPackets.
+	struct vn_proglib_DLLEXPORT AsyncPacketFilter
+	{
+		/// \brief The packet type to deliver, or TYPE_UNKNOWN for any.
+		protocol::uart::Packet::Type type;
+
+		/// \brief For ASCII packets, the output type to deliver, or VNOFF
+		/// for any.
+		protocol::uart::AsciiAsync asciiType;
+
+		/// \brief Indicates if binary packets must have exactly the groups
+		/// and fields of \ref layout.
+		bool matchLayout;
+
+		/// \brief The binary layout to deliver when \ref matchLayout is set.
+		/// The asyncMode and rateDivisor fields are ignored.
+		BinaryOutputRegister layout;
+
+		/// \brief Creates a filter that delivers every packet.
+		AsyncPacketFilter();
+
+		/// \brief Creates a filter for ASCII packets.
+		///
+		/// \param[in] type The output type to deliver, or VNOFF for any.
+		/// \return The filter.
+		static AsyncPacketFilter ascii(protocol::uart::AsciiAsync type = protocol::uart::VNOFF);
+
+		/// \brief Creates a filter for any binary packet.
+		///
+		/// \return The filter.
+		static AsyncPacketFilter binary();
+
+		/// \brief Creates a filter for binary packets with a given layout,
+		///     e.g. those of one binary output register.
+		///
+		/// \param[in] layout The groups and fields to deliver.
+		/// \return The filter.
+		static AsyncPacketFilter binary(const BinaryOutputRegister& layout);
+
+		/// \brief Checks if a packet passes the filter.
+		///
+		/// \param[in] packet The asynchronous packet.
+		/// \return <c>true</c> if the packet is to be delivered.
+		bool matches(protocol::uart::Packet& packet) const;
+	};
+
 	/// \brief Defines the signature for a method that can receive
 	/// notifications when an error message is received.
 	///
@@ -119,6 +181,52 @@ public:
 	///     the packet.
 	typedef void(*ErrorPacketReceivedHandler)(void* userData, protocol::uart::Packet& errorPacket, size_t packetStartRunningIndex);
 
+	/// \brief Defines the signature for a method that is notified when a
+	/// command sent with \ref sendAsync completes.
+	///
+	/// The handler is called on the sensor's command thread, which also
+	/// delivers the responses for blocking calls, so it must not call
+	/// blocking VnSensor methods.
+	///
+	/// \param[in] userData Pointer to user data that was supplied to
+	///     \ref sendAsync.
+	/// \param[in] response The response received. This may be an error
+	///     response from the sensor.
+	/// \param[in] timedOut <c>true</c> if no response was received in time;
+	///     response is then empty.
+	typedef void(*ResponseReceivedHandler)(void* userData, protocol::uart::Packet& response, bool timedOut);
+
+	/// \brief Describes an automatic reconnection made by the supervisor.
+	struct ReconnectInfo
+	{
+		/// \brief The baudrate the connection was restored at.
+		uint32_t baudrate;
+
+		/// \brief Time from the last packet received before the loss until
+		/// the connection and configuration were restored.
+		double outageMs;
+
+		/// \brief Time from detecting the loss until the connection and
+		/// configuration were restored.
+		double reconnectMs;
+
+		/// \brief The registers of the profile that had to be rewritten.
+		std::vector<uint8_t> changedRegisters;
+
+		/// \brief Number of reconnections since the supervisor was enabled.
+		uint64_t numOfReconnects;
+	};
+
+	/// \brief Defines the signature for a method that is notified when the
+	/// supervisor has restored the connection to the sensor.
+	///
+	/// The handler is called on the supervisor's thread.
+	///
+	/// \param[in] userData Pointer to user data that was supplied to
+	///     \ref enableSupervisor.
+	/// \param[in] info Details of the reconnection.
+	typedef void(*ReconnectedHandler)(void* userData, const ReconnectInfo& info);
+
 	/// \brief The list of baudrates supported by VectorNav sensors.
 	static std::vector<uint32_t> supportedBaudrates();
 
@@ -138,6 +246,20 @@ public:
 	/// \return The port name.
 	std::string port();
 
+	/// \brief Returns the line statistics of the serial port connection.
+	///
+	/// \return The latest line statistics.
+	/// \exception invalid_operation Not connected to a serial port.
+	xplat::SerialPort::LineStatistics lineStatistics();
+
+	/// \brief Sets the driver that services the sensor's serial port in place
+	///     of the port's own notification thread. Applies to the current
+	///     connection and to every later connection by port name, including
+	///     reconnects by the supervisor. See \ref SensorHub.
+	///
+	/// \param[in] driver The driver, or <c>NULL</c> for a dedicated thread.
+	void setNotificationDriver(xplat::SerialPort::NotificationDriver* driver);
+
 	/// \defgroup vnSensorProperties VnSensor Properties
 	/// \brief This group of methods interface with the VnSensor properties.
 	///
@@ -183,6 +305,20 @@ public:
 	/// \param[in] delay The retransmit delay in milliseconds.
 	void setRetransmitDelayMs(uint16_t delay);
 
+	/// \brief Gets the maximum number of commands that may be awaiting a
+	/// response from the sensor at once. Default is 8.
+	///
+	/// \return The maximum number of commands in flight.
+	size_t maxCommandsInFlight();
+
+	/// \brief Sets the maximum number of commands that may be awaiting a
+	/// response from the sensor at once. A value of 1 sends each command only
+	/// after the previous one has been answered.
+	///
+	/// \param[in] count The maximum number of commands in flight.
+	/// \exception invalid_argument Thrown if count is 0.
+	void setMaxCommandsInFlight(size_t count);
+
 	/// \}
 
 	/// \brief Checks if we are able to send and receive communication with a sensor.
@@ -210,6 +346,58 @@ public:
 	///     currently open or closed.
 	void connect(xplat::IPort* port);
 
+	/// \brief Connects to a VectorNav sensor at whatever baudrate it is
+	///     currently using, finding it as quickly as possible.
+	///
+	/// The baudrate last recorded for this port in baudCacheFile is tried
+	/// first, then likelyBaudrate, then the remaining supported baudrates as
+	/// described by Searcher::quickSearch. The found baudrate is recorded in
+	/// the cache file, as is any later change made with \ref changeBaudRate,
+	/// so reconnecting after a restart normally takes a single attempt.
+	///
+	/// \param[in] portName The name of the serial port to connect to.
+	/// \param[in] baudCacheFile File recording the last known baudrate of
+	///     each port. May be empty to not use a cache.
+	/// \param[in] likelyBaudrate A baudrate to try early, e.g. the one the
+	///     sensor is configured for. May be 0.
+	/// \return The baudrate the sensor was found at.
+	/// \exception not_found Thrown if no sensor responds on the port.
+	uint32_t connectFast(const std::string &portName, const std::string &baudCacheFile, uint32_t likelyBaudrate = 0);
+
+	/// \brief Watches the connection and restores it when the sensor's data
+	///     stream is lost, e.g. when a USB-serial cable is unplugged.
+	///
+	/// The stream counts as lost when no valid packet arrives for
+	/// missedPeriods times expectedPeriodMs, or on Linux as soon as the
+	/// port's device node disappears. The supervisor then closes the port and,
+	/// once the device node is back, reopens it at the last baudrate (or finds
+	/// the sensor as \ref connectFast does), restores that baudrate if the
+	/// sensor came back at another one, and brings the registers back in line
+	/// with profile using \ref applyConfiguration, so only registers the
+	/// sensor lost are written.
+	///
+	/// Requires a connection made by port name and asynchronous output from
+	/// the sensor. Other calls made while the connection is down throw
+	/// invalid_operation or timeout.
+	///
+	/// \param[in] expectedPeriodMs The expected time between packets.
+	/// \param[in] missedPeriods Number of periods without packets that
+	///     count as a loss.
+	/// \param[in] profile The configuration to restore after reconnecting.
+	/// \param[in] handler Optional handler notified after each reconnection.
+	/// \param[in] userData Pointer to user data passed to the handler.
+	/// \exception invalid_operation Thrown if not connected to a serial port
+	///     or if the supervisor is already enabled.
+	void enableSupervisor(
+		uint32_t expectedPeriodMs,
+		uint32_t missedPeriods,
+		const ConfigurationProfile& profile,
+		ReconnectedHandler handler = NULL,
+		void* userData = NULL);
+
+	/// \brief Stops watching the connection. Called by \ref disconnect.
+	void disableSupervisor();
+
 	/// \brief Disconnects from the VectorNav sensor.
 	///
 	/// \exception invalid_operation Thrown if the VnSensor is not
@@ -256,6 +444,114 @@ public:
 		bool waitForReply = true,
 		protocol::uart::ErrorDetectionMode errorDetectionMode = protocol::uart::ERRORDETECTIONMODE_CHECKSUM);
 
+	/// \brief Sends several commands to the sensor without waiting for each
+	/// response before sending the next.
+	///
+	/// Up to \ref maxCommandsInFlight commands, counting those sent from
+	/// other threads and by \ref sendAsync, are outstanding at once and each
+	/// response is matched to its command by command type and register
+	/// ID. Every command is retransmitted and timed out on its own according
+	/// to \ref retransmitDelayMs and \ref responseTimeoutMs. The commands are
+	/// completed in the same way as \ref send.
+	///
+	/// \param[in] commands The commands to send.
+	/// \param[in] errorDetectionMode Indicates the error detection mode to
+	///     append to any packets to send.
+	/// \return The responses, in the same order as the commands.
+	/// \exception timeout Thrown if any command did not receive a response.
+	/// \exception sensor_error Thrown if the sensor rejected any command.
+	std::vector<std::string> sendBatch(
+		const std::vector<std::string>& commands,
+		protocol::uart::ErrorDetectionMode errorDetectionMode = protocol::uart::ERRORDETECTIONMODE_CHECKSUM);
+
+	/// \brief Sends a command to the sensor without blocking for its response.
+	///
+	/// The command is completed in the same way as \ref send. It is
+	/// retransmitted and timed out according to the current
+	/// \ref retransmitDelayMs and \ref responseTimeoutMs and counts against
+	/// \ref maxCommandsInFlight. Any register may be accessed this way by
+	/// using the protocol::uart::Packet::genRead.../genWrite... methods to
+	/// build the command and the protocol::uart::Packet::parse... methods on
+	/// the response.
+	///
+	/// The future is fulfilled on the sensor's command thread from responses
+	/// received on the thread that reads from the serial port, so do not
+	/// wait on it from a VnSensor callback.
+	///
+	/// \param[in] toSend The command to send.
+	/// \param[in] errorDetectionMode Indicates the error detection mode to
+	///     append to any packets to send.
+	/// \return A future for the response. Getting the value throws
+	///     \ref timeout or \ref sensor_error just as the blocking methods do.
+	/// \exception invalid_operation Thrown if the VnSensor is not connected.
+	std::future<protocol::uart::Packet> sendAsync(
+		const std::string& toSend,
+		protocol::uart::ErrorDetectionMode errorDetectionMode = protocol::uart::ERRORDETECTIONMODE_CHECKSUM);
+
+	/// \brief Sends a command to the sensor without blocking and notifies the
+	/// provided handler when it completes.
+	///
+	/// \param[in] toSend The command to send.
+	/// \param[in] handler The handler to call with the response or timeout.
+	/// \param[in] userData Pointer to user data passed to the handler.
+	/// \param[in] errorDetectionMode Indicates the error detection mode to
+	///     append to any packets to send.
+	/// \exception invalid_operation Thrown if the VnSensor is not connected.
+	void sendAsync(
+		const std::string& toSend,
+		ResponseReceivedHandler handler,
+		void* userData,
+		protocol::uart::ErrorDetectionMode errorDetectionMode = protocol::uart::ERRORDETECTIONMODE_CHECKSUM);
+
+	/// \brief Issues a tare command without blocking for the response.
+	///
+	/// \return A future for the sensor's response. See \ref sendAsync.
+	std::future<protocol::uart::Packet> tareAsync();
+
+	/// \brief Issues a set gyro bias command without blocking for the
+	/// response.
+	///
+	/// \return A future for the sensor's response. See \ref sendAsync.
+	std::future<protocol::uart::Packet> setGyroBiasAsync();
+
+	/// \brief Informs the sensor of a known magnetic disturbance without
+	/// blocking for the response.
+	///
+	/// \param[in] disturbancePresent Indicates the presence of a magnetic disturbance.
+	/// \return A future for the sensor's response. See \ref sendAsync.
+	std::future<protocol::uart::Packet> magneticDisturbancePresentAsync(bool disturbancePresent);
+
+	/// \brief Informs the sensor of a known acceleration disturbance without
+	/// blocking for the response.
+	///
+	/// \param[in] disturbancePresent Indicates the presence of an acceleration disturbance.
+	/// \return A future for the sensor's response. See \ref sendAsync.
+	std::future<protocol::uart::Packet> accelerationDisturbancePresentAsync(bool disturbancePresent);
+
+	/// \brief Writes the Filter Active Tuning Parameters register (the
+	/// disturbance gains) without blocking for the response.
+	///
+	/// \param[in] fields The register's fields.
+	/// \return A future for the sensor's response. See \ref sendAsync.
+	std::future<protocol::uart::Packet> writeFilterActiveTuningParametersAsync(FilterActiveTuningParametersRegister &fields);
+
+	/// \brief Brings the sensor's registers in line with a profile, writing
+	///     only the registers whose values differ.
+	///
+	/// All registers of the profile are read in one pipelined batch and
+	/// compared with ConfigurationProfile::fieldsMatch. The registers that
+	/// differ are then written in a second batch, in profile order, and if
+	/// any were written and the profile asks to persist, a Write Settings
+	/// command follows. A sensor that is already configured therefore sees
+	/// no writes at all and is not reinitialized.
+	///
+	/// \param[in] profile The desired register values.
+	/// \return Which registers changed and the time spent.
+	/// \exception timeout Thrown if a command did not receive a response.
+	/// \exception sensor_error Thrown if the sensor rejected a command, e.g.
+	///     for an invalid register or value.
+	ConfigurationResult applyConfiguration(const ConfigurationProfile& profile);
+
 	/// \brief Issues a tare command to the VectorNav Sensor.
 	///
 	/// \param[in] waitForReply Indicates if the method should wait for a
@@ -282,6 +578,19 @@ public:
 	///     response from the sensor.
 	void accelerationDisturbancePresent(bool disturbancePresent, bool waitForReply = true);
 
+	/// \brief Pauses or resumes the sensor's asynchronous outputs on the
+	///     connected port.
+	///
+	/// Prefer a \ref ConfigurationSession, which resumes the outputs even
+	/// when configuring fails. While paused, silence does not count as a loss
+	/// of the stream for the supervisor.
+	///
+	/// \param[in] enabled <c>true</c> to resume the outputs; <c>false</c> to
+	///     pause them.
+	/// \param[in] waitForReply Indicates if the method should wait for a
+	///     response from the sensor.
+	void setAsyncOutputsEnabled(bool enabled, bool waitForReply = true);
+
 	/// \brief Issues a Write Settings command to the VectorNav Sensor.
 	///
 	/// \param[in] waitForReply Indicates if the method should wait for a
@@ -388,6 +697,48 @@ public:
 	/// \brief Unregisters the registered callback method.
 	void unregisterAsyncPacketReceivedHandler();
 
+	/// \brief Registers a callback method for notification when a new
+	/// asynchronous data packet is received, including its receive timestamp.
+	///
+	/// When connected over a serial port, the timestamp is taken when the
+	/// notification thread wakes and back-dated to the arrival of the packet's
+	/// first byte using the current baudrate.
+	///
+	/// \param[in] userData Pointer to user data, which will be provided to the
+	///     callback method.
+	/// \param[in] handler The callback method.
+	void registerTimedAsyncPacketReceivedHandler(void* userData, TimedAsyncPacketReceivedHandler handler);
+
+	/// \brief Unregisters the registered callback method.
+	void unregisterTimedAsyncPacketReceivedHandler();
+
+	/// \brief Adds a subscriber for asynchronous packets.
+	///
+	/// Any number of subscribers can be added and removed at any time, also
+	/// from within a handler, without blocking the thread that receives the
+	/// packets: it works on an immutable snapshot of the subscribers which is
+	/// replaced on every change and freed once no dispatch uses it. Each
+	/// subscriber only receives packets passing its filter, after the
+	/// handlers registered with \ref registerAsyncPacketReceivedHandler and
+	/// \ref registerTimedAsyncPacketReceivedHandler.
+	///
+	/// \param[in] handler The callback method.
+	/// \param[in] userData Pointer to user data, which will be provided to the
+	///     callback method.
+	/// \param[in] filter Selects the packets delivered.
+	/// \return Identifies the subscription for \ref unsubscribeAsyncPackets.
+	size_t subscribeAsyncPackets(TimedAsyncPacketReceivedHandler handler, void* userData, const AsyncPacketFilter& filter = AsyncPacketFilter());
+
+	/// \brief Removes a subscriber added with \ref subscribeAsyncPackets.
+	///
+	/// Unless called from within a handler, this waits for any dispatch
+	/// still using the old subscribers to finish, so the handler is not
+	/// called anymore once this returns and its user data can be released.
+	///
+	/// \param[in] subscriptionId The value returned by \ref subscribeAsyncPackets.
+	/// \exception not_found Thrown if there is no such subscription.
+	void unsubscribeAsyncPackets(size_t subscriptionId);
+
 	/// \brief Registers a callback method for notification when an error
 	/// packet is received.
 	///
@@ -1434,6 +1785,47 @@ private:
 
 };
 
+/// \brief Pauses a sensor's asynchronous outputs for the lifetime of the
+///     object so a burst of commands does not compete with the data stream.
+///
+/// At high output rates every response has to be found between
+/// asynchronous packets, which costs bandwidth and makes responses late
+/// enough to be retransmitted. Configuring inside a session avoids both:
+///
+/// \code
+/// {
+///     ConfigurationSession session(sensor);
+///     sensor.applyConfiguration(profile);
+/// }   // Outputs resume here, also if applyConfiguration threw.
+/// \endcode
+class vn_proglib_DLLEXPORT ConfigurationSession : private util::NoCopy
+{
+
+public:
+
+	/// \brief Pauses the asynchronous outputs of the sensor.
+	///
+	/// \param[in] sensor The connected sensor to configure.
+	/// \exception timeout Thrown if the sensor did not acknowledge the pause.
+	explicit ConfigurationSession(VnSensor& sensor);
+
+	/// \brief Resumes the asynchronous outputs unless \ref resume was
+	///     already called. Errors are ignored.
+	~ConfigurationSession();
+
+	/// \brief Resumes the asynchronous outputs now, reporting any error.
+	///
+	/// If this throws, the outputs count as still paused, so resume can be
+	/// called again and the destructor makes a last attempt.
+	///
+	/// \exception timeout Thrown if the sensor did not acknowledge the resume.
+	void resume();
+
+private:
+	VnSensor& _sensor;
+	bool _paused;
+};
+
 }
 }
 
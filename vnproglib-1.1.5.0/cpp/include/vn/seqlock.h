@@ -0,0 +1,106 @@
+#ifndef _VNXPLAT_SEQLOCK_H_
+#define _VNXPLAT_SEQLOCK_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include "nocopy.h"
+
+namespace vn {
+namespace xplat {
+
+/// \brief Holds the latest value of a type published by one writer and read
+///     by any number of threads without locks.
+///
+/// The writer bumps a sequence number to odd before copying the value in
+/// and back to even after. Readers copy the value out and keep the copy
+/// only if the sequence number was even and unchanged around the copy.
+/// Neither side ever blocks: the writer does not wait for readers and a
+/// reader only repeats its copy if the writer published during it.
+///
+/// \tparam T The value type. Must be trivially copyable, since readers may
+///     copy it while it is being written and discard the torn copy.
+template<typename T>
+class SeqLock : private util::NoCopy
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires a trivially copyable type.");
+
+public:
+
+	/// \brief The number of copies \ref tryLoad attempts by default.
+	static const size_t DefaultMaxAttempts = 8;
+
+	/// \brief Creates a new cell holding a value-initialized T.
+	SeqLock() :
+		_sequence(0),
+		_value()
+	{ }
+
+	/// \brief Publishes a new value. Must only be called from one thread at
+	///     a time.
+	///
+	/// \param[in] value The new value.
+	void store(const T& value)
+	{
+		size_t seq = _sequence.load(std::memory_order_relaxed);
+
+		_sequence.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		std::memcpy(&_value, &value, sizeof(T));
+
+		_sequence.store(seq + 2, std::memory_order_release);
+	}
+
+	/// \brief Copies out the latest value. May be called from any thread.
+	///
+	/// A copy is only repeated when the writer published during it. Each
+	/// copy takes far less time than the writer needs to produce a value,
+	/// so a second attempt almost always succeeds; running out of attempts
+	/// means the reader was preempted mid-copy again and again. After
+	/// maxAttempts copies the method gives up rather than spin, so a reader
+	/// never waits on the writer for longer than maxAttempts copies.
+	///
+	/// \param[out] value The latest value. Unspecified if the method fails.
+	/// \param[in] maxAttempts The number of copies to attempt.
+	/// \return <c>true</c> if a consistent value was copied.
+	bool tryLoad(T& value, size_t maxAttempts = DefaultMaxAttempts) const
+	{
+		for (size_t i = 0; i < maxAttempts; i++)
+		{
+			size_t before = _sequence.load(std::memory_order_acquire);
+
+			if (before & 1)
+				// The writer is in the middle of publishing.
+				continue;
+
+			std::memcpy(&value, &_value, sizeof(T));
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (_sequence.load(std::memory_order_relaxed) == before)
+				return true;
+		}
+
+		return false;
+	}
+
+	/// \brief Returns the number of values published so far.
+	///
+	/// \return The number of values published.
+	size_t version() const
+	{
+		return _sequence.load(std::memory_order_acquire) / 2;
+	}
+
+private:
+	std::atomic<size_t> _sequence;
+	T _value;
+};
+
+}
+}
+
+#endif
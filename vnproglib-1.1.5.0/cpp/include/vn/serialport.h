@@ -17,6 +17,7 @@
 #include "port.h"
 #include "nocopy.h"
 #include "export.h"
+#include "vntime.h"
 
 namespace vn {
 namespace xplat {
@@ -44,6 +45,48 @@ public:
 		TWO_STOP_BITS
 	};
 
+	/// \brief Line counters reported by the UART driver.
+	struct LineCounters
+	{
+		uint32_t rx;			///< Bytes received.
+		uint32_t tx;			///< Bytes transmitted.
+		uint32_t frame;			///< Framing errors.
+		uint32_t parity;		///< Parity errors.
+		uint32_t brk;			///< Break conditions.
+		uint32_t overrun;		///< Hardware receive FIFO overruns.
+		uint32_t bufOverrun;	///< Driver receive buffer overruns.
+
+		LineCounters() :
+			rx(0), tx(0), frame(0), parity(0), brk(0), overrun(0), bufOverrun(0)
+		{ }
+
+		/// \brief Indicates if any receive error counter is non-zero.
+		///
+		/// \return <c>true</c> if bytes were lost or corrupted on the line.
+		bool hasErrors() const
+		{
+			return frame != 0 || parity != 0 || brk != 0 || overrun != 0 || bufOverrun != 0;
+		}
+	};
+
+	/// \brief Periodically sampled line statistics.
+	struct LineStatistics
+	{
+		/// \brief When the counters were last sampled.
+		xplat::TimeStamp timestamp;
+
+		/// \brief Change of the counters over the last sample interval.
+		LineCounters delta;
+
+		/// \brief Counters accumulated since the port was opened.
+		LineCounters total;
+
+		/// \brief The number of samples taken since the port was opened.
+		uint32_t numOfSamples;
+
+		LineStatistics() : numOfSamples(0) { }
+	};
+
 	// Constructors ///////////////////////////////////////////////////////////
 
 public:
@@ -106,6 +149,22 @@ public:
 	/// \param[in] stopBits The stop bit configuration.
 	void setStopBits(StopBits stopBits);
 
+	/// \brief Returns the time the notification thread was woken for the
+	/// data currently being reported.
+	///
+	/// The timestamp is taken before any data is read, so it closely tracks
+	/// when the last byte available arrived. It is only meaningful when
+	/// called from within a \ref DataReceivedHandler.
+	///
+	/// \return The receive timestamp, from CLOCKSOURCE_MONOTONIC.
+	xplat::TimeStamp dataReceivedTimestamp();
+
+	/// \brief Returns the time to transfer a single byte at the current
+	/// baudrate and stop bit configuration.
+	///
+	/// \return The byte time in nanoseconds.
+	uint32_t byteTimeNs();
+
 	/// \brief Indicates if the platforms supports event notifications.
 
 	/// \brief Returns the number of dropped sections of received data.
@@ -114,6 +173,81 @@ public:
 	///     not indicative of the total number of dropped bytes.
 	size_t NumberOfReceiveDataDroppedSections();
 
+	/// \brief Returns the most recent sample of the line counters.
+	///
+	/// While the port is open, the notification thread samples the driver's
+	/// counters (<c>TIOCGICOUNT</c> on Linux) every
+	/// \ref lineStatisticsSampleIntervalMs milliseconds.
+	///
+	/// \return The latest line statistics.
+	/// \exception not_implemented The platform does not provide line counters.
+	LineStatistics lineStatistics();
+
+	/// \brief Returns the interval between line counter samples.
+	///
+	/// \return The sample interval in milliseconds.
+	uint32_t lineStatisticsSampleIntervalMs();
+
+	/// \brief Sets the interval between line counter samples.
+	///
+	/// \param[in] intervalMs The sample interval in milliseconds.
+	void setLineStatisticsSampleIntervalMs(uint32_t intervalMs);
+
+	/// \brief Services serial ports in place of their own notification
+	///     threads, e.g. so one thread can wait on many ports.
+	///
+	/// While a port has a driver, opening it calls \ref portOpened instead of
+	/// starting the notification thread and the driver reports incoming data
+	/// with \ref SerialPort::notifyDataReceived.
+	class NotificationDriver
+	{
+
+	public:
+
+		virtual ~NotificationDriver() { }
+
+		/// \brief Called when the port is opened, or when the driver is set
+		///     on an open port.
+		///
+		/// \param[in] port The port.
+		/// \param[in] handle The file descriptor to wait on.
+		virtual void portOpened(SerialPort& port, int handle) = 0;
+
+		/// \brief Called before the port is closed, or when the driver is
+		///     removed from an open port.
+		///
+		/// Must not return while data for the port is being reported on
+		/// another thread.
+		///
+		/// \param[in] port The port.
+		virtual void portClosing(SerialPort& port) = 0;
+	};
+
+	/// \brief Hands the port to a driver, or back to its own notification
+	///     thread when <c>NULL</c>. May be called while the port is open.
+	///
+	/// \param[in] driver The driver, or <c>NULL</c>.
+	/// \exception not_supported The platform cannot wait on serial ports
+	///     from a driver.
+	void setNotificationDriver(NotificationDriver* driver);
+
+	/// \brief Returns the port's driver.
+	///
+	/// \return The driver, or <c>NULL</c> if the port has its own
+	///     notification thread.
+	NotificationDriver* notificationDriver();
+
+	/// \brief Reports that data is available. Called by the port's
+	///     \ref NotificationDriver from the thread that waited on the port.
+	///
+	/// \param[in] timestamp When the waiting thread woke up.
+	void notifyDataReceived(const xplat::TimeStamp& timestamp);
+
+	/// \brief Samples the line counters if the sample interval has elapsed.
+	///     Called by the port's \ref NotificationDriver while the port is
+	///     idle.
+	void pollLineStatistics();
+
 	/// \brief With regard to optimizing COM ports provided by FTDI drivers, this
 	/// method will check if the COM port has been optimized.
 	///
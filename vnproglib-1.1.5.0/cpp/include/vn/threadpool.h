@@ -0,0 +1,126 @@
+#ifndef _VNXPLAT_THREADPOOL_H_
+#define _VNXPLAT_THREADPOOL_H_
+
+#include <atomic>
+#include <cstddef>
+
+#include "nocopy.h"
+#include "export.h"
+#include "event.h"
+#include "criticalsection.h"
+#include "thread.h"
+
+namespace vn {
+namespace xplat {
+
+/// \brief Runs background jobs on a fixed set of reusable threads.
+///
+/// Every worker has a queue of its own. Jobs submitted from a worker go on
+/// that worker's queue and are run newest first, while jobs submitted from
+/// other threads are spread over the queues in turn. A worker whose queue is
+/// empty takes the oldest job from another worker's queue, so work spreads
+/// out without all threads contending for one queue.
+///
+/// Jobs that block for long periods, such as a loop reading a port, can ask
+/// for a dedicated thread instead so they do not hold up the pooled jobs.
+class vn_proglib_DLLEXPORT ThreadPool : private util::NoCopy
+{
+
+public:
+
+	/// \brief Where a job is run.
+	enum Placement
+	{
+		PLACEMENT_POOLED,		///< On one of the pool's workers.
+		PLACEMENT_DEDICATED		///< On a thread started for the job.
+	};
+
+	/// \brief Routine run for a range of indices by \ref parallelFor.
+	typedef void (*RangeRoutine)(void* userData, size_t begin, size_t end);
+
+	/// \brief Tracks the completion of a set of jobs.
+	///
+	/// Pass the same batch to each \ref submit, then to \ref wait. A batch
+	/// must outlive its jobs and may be reused once waited on.
+	class vn_proglib_DLLEXPORT Batch : private util::NoCopy
+	{
+
+	public:
+
+		Batch();
+
+		/// \brief Returns the number of jobs submitted with the batch that
+		///     have not finished.
+		///
+		/// \return The number of unfinished jobs.
+		size_t pending() const;
+
+	private:
+		friend class ThreadPool;
+
+		std::atomic<size_t> _pending;
+		Event _done;
+
+		// Held while a job finishes, so the waiter cannot return and destroy
+		// the batch before the last job is done signalling it.
+		CriticalSection _finishing;
+	};
+
+	/// \brief Creates a pool and starts its workers.
+	///
+	/// \param[in] numOfThreads The number of workers, or 0 for one per
+	///     processor.
+	/// \exception unknown_error The workers could not be started.
+	explicit ThreadPool(size_t numOfThreads = 0);
+
+	/// \brief Runs the jobs still queued, then stops the workers and joins
+	///     any dedicated threads.
+	~ThreadPool();
+
+	/// \brief Returns the pool shared by the library, created with one worker
+	///     per processor on first use.
+	///
+	/// \return The shared pool.
+	static ThreadPool& shared();
+
+	/// \brief Returns the number of workers.
+	///
+	/// \return The number of workers.
+	size_t numOfThreads() const;
+
+	/// \brief Queues a job.
+	///
+	/// \param[in] routine The routine to run.
+	/// \param[in] userData Pointer passed to the routine.
+	/// \param[in] batch Batch to count the job in, or <c>NULL</c>.
+	/// \param[in] placement Where to run the job.
+	void submit(Thread::ThreadStartRoutine routine, void* userData, Batch* batch = NULL, Placement placement = PLACEMENT_POOLED);
+
+	/// \brief Blocks until every job of a batch has finished.
+	///
+	/// The calling thread runs queued jobs while it waits, so a worker may
+	/// wait on jobs it submitted without tying up the pool.
+	///
+	/// \param[in] batch The batch.
+	void wait(Batch& batch);
+
+	/// \brief Splits <c>[0, count)</c> into chunks, runs the routine on each
+	///     from the pool and the calling thread, and returns when all are
+	///     done.
+	///
+	/// \param[in] count The number of indices.
+	/// \param[in] routine The routine to run for each chunk.
+	/// \param[in] userData Pointer passed to the routine.
+	/// \param[in] minChunk The smallest number of indices worth handing to
+	///     another thread.
+	void parallelFor(size_t count, RangeRoutine routine, void* userData, size_t minChunk = 1);
+
+private:
+	struct Impl;
+	Impl *_pi;
+};
+
+}
+}
+
+#endif
@@ -1275,6 +1275,52 @@ vec<tdim, T> operator/(vec<tdim, T> lhs, const S& rhs)
 	#pragma warning(pop)
 #endif
 
+/// \brief Rotates a vector by a quaternion, e.g. from the NED frame to the
+///     body frame with the sensor's attitude quaternion.
+///
+/// Same as multiplying by the direction cosine matrix from
+/// <c>quat2dcm(quat)</c>, without forming the matrix.
+///
+/// \param[in] quat The unit quaternion, scalar last.
+/// \param[in] v The vector.
+/// \return The rotated vector.
+template <typename T>
+vec<3, T> quatRotate(const vec<4, T>& quat, const vec<3, T>& v)
+{
+	// v + w t + t x u with t = 2 v x u, where u is the vector part.
+	T tx = 2 * (v.y * quat.z - v.z * quat.y);
+	T ty = 2 * (v.z * quat.x - v.x * quat.z);
+	T tz = 2 * (v.x * quat.y - v.y * quat.x);
+
+	return vec<3, T>(
+		v.x + quat.w * tx + (ty * quat.z - tz * quat.y),
+		v.y + quat.w * ty + (tz * quat.x - tx * quat.z),
+		v.z + quat.w * tz + (tx * quat.y - ty * quat.x));
+}
+
+/// \brief Rotates a vector by the inverse of a quaternion, e.g. from the body
+///     frame to the NED frame with the sensor's attitude quaternion.
+///
+/// Same as multiplying by the transpose of the direction cosine matrix from
+/// <c>quat2dcm(quat)</c>, without forming the matrix.
+///
+/// \param[in] quat The unit quaternion, scalar last.
+/// \param[in] v The vector.
+/// \return The rotated vector.
+template <typename T>
+vec<3, T> quatRotateInverse(const vec<4, T>& quat, const vec<3, T>& v)
+{
+	// v + w t + u x t with t = 2 u x v, where u is the vector part.
+	T tx = 2 * (quat.y * v.z - quat.z * v.y);
+	T ty = 2 * (quat.z * v.x - quat.x * v.z);
+	T tz = 2 * (quat.x * v.y - quat.y * v.x);
+
+	return vec<3, T>(
+		v.x + quat.w * tx + (quat.y * tz - quat.z * ty),
+		v.y + quat.w * ty + (quat.z * tx - quat.x * tz),
+		v.z + quat.w * tz + (quat.x * ty - quat.y * tx));
+}
+
 // Specific Typedefs //////////////////////////////////////////////////////////
 
 /// \brief 2-component vector using <c>float</c> as its underlying data type.
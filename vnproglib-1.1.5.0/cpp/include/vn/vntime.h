@@ -10,24 +10,74 @@ namespace xplat {
 struct vn_proglib_DLLEXPORT TimeStamp
 {
 public:
+
+	/// \brief The clocks a TimeStamp can be taken from.
+	enum ClockSource
+	{
+		CLOCKSOURCE_REALTIME,		///< Wall-clock time. Jumps when the system time is set.
+		CLOCKSOURCE_MONOTONIC,		///< Monotonic time. Slewed by NTP but never jumps.
+		CLOCKSOURCE_MONOTONIC_RAW	///< Monotonic hardware time not adjusted by NTP.
+	};
+
 	TimeStamp();
 
 private:
 	TimeStamp(int64_t sec, uint64_t usec);
 
+	TimeStamp(int64_t sec, uint32_t nsec, ClockSource clock);
+
 public:
 
-	// \brief Returns a timestamp.
-	//
-	// \return The timestamp.
+	/// \brief Returns a timestamp from the wall clock, CLOCKSOURCE_REALTIME.
+	///
+	/// Use \ref get(ClockSource) with CLOCKSOURCE_MONOTONIC to measure
+	/// intervals.
+	///
+	/// \return The timestamp.
 	static TimeStamp get();
 
+	/// \brief Returns a timestamp from the specified clock source.
+	///
+	/// \param[in] clock The clock to read.
+	/// \return The timestamp.
+	static TimeStamp get(ClockSource clock);
+
+	/// \brief Creates a timestamp from a number of nanoseconds.
+	///
+	/// \param[in] ns Nanoseconds since the clock's epoch.
+	/// \param[in] clock The clock the value belongs to.
+	/// \return The timestamp.
+	static TimeStamp fromNs(int64_t ns, ClockSource clock = CLOCKSOURCE_MONOTONIC);
+
+	/// \brief Returns the clock this timestamp was taken from.
+	///
+	/// \return The clock source.
+	ClockSource clockSource() const;
+
+	/// \brief Returns the timestamp in nanoseconds.
+	///
+	/// \return Nanoseconds since the clock's epoch.
+	int64_t totalNs() const;
+
+	/// \brief Returns the timestamp in seconds.
+	///
+	/// \return Seconds since the clock's epoch.
+	double totalSec() const;
+
+	/// \brief Returns a copy of this timestamp shifted by the specified amount.
+	///
+	/// \param[in] ns The number of nanoseconds to add. May be negative.
+	/// \return The shifted timestamp.
+	TimeStamp addNs(int64_t ns) const;
+
 // HACK: Current values are made public until the TimeStamp interface
 // is fully worked out.
 //private:
 public:
 	int64_t _sec;		// Seconds.
 	uint64_t _usec;		// Microseconds.
+	uint32_t _nsec;		// Nanoseconds within the second.
+	ClockSource _clock;	// The clock the timestamp was taken from.
 };
 
 /// \brief Provides simple timing capabilities.
@@ -0,0 +1,632 @@
+#include "vn/batchconversions.h"
+#include "vn/compiler.h"
+#include "vn/consts.h"
+#include "vn/conversions.h"
+#include "vn/threadpool.h"
+
+#if VN_HAVE_SSE2
+	#include <emmintrin.h>
+#else
+	#include <cmath>
+#endif
+
+using namespace vn::xplat;
+
+namespace vn {
+namespace math {
+
+namespace
+{
+	// Below this many values the conversions are quicker than handing them
+	// to other threads.
+	const size_t ParallelMinCount = 8192;
+	const size_t ParallelMinChunk = 2048;
+
+	const float Rad2Deg = 180.0f / PIf;
+	const float Deg2Rad = PIf / 180.0f;
+
+	#if VN_HAVE_SSE2
+
+	// pi/2 split so the first two parts times a quadrant number are exact,
+	// keeping the reduction of large angles accurate.
+	const float PiHalfHi = 1.5703125f;
+	const float PiHalfMid = 4.837512969970703125e-4f;
+	const float PiHalfLo = 7.54978995489188216e-8f;
+
+	// tan(pi/8), below which atan's polynomial is used without shifting.
+	const float TanPiOver8 = 0.4142135623730950f;
+
+	// Four floats, and the result of comparing them.
+	typedef __m128 f4;
+	typedef __m128 m4;
+
+	inline f4 set1(float v) { return _mm_set1_ps(v); }
+	inline f4 load(const float* p) { return _mm_loadu_ps(p); }
+	inline void store(float* p, f4 v) { _mm_storeu_ps(p, v); }
+
+	inline f4 add(f4 a, f4 b) { return _mm_add_ps(a, b); }
+	inline f4 sub(f4 a, f4 b) { return _mm_sub_ps(a, b); }
+	inline f4 mul(f4 a, f4 b) { return _mm_mul_ps(a, b); }
+	inline f4 div(f4 a, f4 b) { return _mm_div_ps(a, b); }
+	inline f4 sqrt(f4 a) { return _mm_sqrt_ps(a); }
+	inline f4 min(f4 a, f4 b) { return _mm_min_ps(a, b); }
+	inline f4 max(f4 a, f4 b) { return _mm_max_ps(a, b); }
+	inline f4 abs(f4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+	inline m4 lt(f4 a, f4 b) { return _mm_cmplt_ps(a, b); }
+	inline m4 gt(f4 a, f4 b) { return _mm_cmpgt_ps(a, b); }
+
+	// m ? a : b, per lane.
+	inline f4 select(m4 m, f4 a, f4 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+	// -a where m is set.
+	inline f4 negateWhere(m4 m, f4 a) { return _mm_xor_ps(a, _mm_and_ps(m, _mm_set1_ps(-0.0f))); }
+
+	// |a| with the sign of s.
+	inline f4 copySign(f4 a, f4 s)
+	{
+		f4 signBit = _mm_set1_ps(-0.0f);
+
+		return _mm_or_ps(_mm_andnot_ps(signBit, a), _mm_and_ps(signBit, s));
+	}
+
+	// Rounds x / (pi/2) to the nearest quadrant number n and flags the
+	// quadrants where sine and cosine swap or change sign.
+	inline void quadrant(f4 x, f4& n, m4& swap, m4& negateSin, m4& negateCos)
+	{
+		__m128i one = _mm_set1_epi32(1);
+		__m128i two = _mm_set1_epi32(2);
+		__m128i j = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(2.0f / PIf)));
+
+		n = _mm_cvtepi32_ps(j);
+		swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, one), one));
+		negateSin = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, two), two));
+		negateCos = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_add_epi32(j, one), two), two));
+	}
+
+	// Sine and cosine of four angles, after Cephes' sinf and cosf.
+	void sincos(f4 x, f4& s, f4& c)
+	{
+		f4 n;
+		m4 swap, negateSin, negateCos;
+
+		quadrant(x, n, swap, negateSin, negateCos);
+
+		// r = x - n * pi/2, in [-pi/4, pi/4].
+		f4 r = sub(x, mul(n, set1(PiHalfHi)));
+		r = sub(r, mul(n, set1(PiHalfMid)));
+		r = sub(r, mul(n, set1(PiHalfLo)));
+
+		f4 z = mul(r, r);
+
+		f4 ps = set1(-1.9515295891e-4f);
+		ps = add(mul(ps, z), set1(8.3321608736e-3f));
+		ps = add(mul(ps, z), set1(-1.6666654611e-1f));
+		ps = add(mul(mul(ps, z), r), r);
+
+		f4 pc = set1(2.443315711809948e-5f);
+		pc = add(mul(pc, z), set1(-1.388731625493765e-3f));
+		pc = add(mul(pc, z), set1(4.166664568298827e-2f));
+		pc = add(sub(mul(mul(pc, z), z), mul(set1(0.5f), z)), set1(1.0f));
+
+		s = negateWhere(negateSin, select(swap, pc, ps));
+		c = negateWhere(negateCos, select(swap, ps, pc));
+	}
+
+	// atan2 of four pairs, using Cephes' atanf polynomial on the ratio of the
+	// smaller to the larger magnitude.
+	f4 atan2(f4 y, f4 x)
+	{
+		f4 zero = set1(0.0f);
+		f4 ax = abs(x);
+		f4 ay = abs(y);
+		f4 hi = max(ax, ay);
+		f4 a = select(gt(hi, zero), div(min(ax, ay), hi), zero);
+
+		// atan(a) = pi/4 + atan((a - 1) / (a + 1)) keeps the polynomial's
+		// argument within tan(pi/8).
+		m4 shift = gt(a, set1(TanPiOver8));
+		f4 t = select(shift, div(sub(a, set1(1.0f)), add(a, set1(1.0f))), a);
+		f4 z = mul(t, t);
+
+		f4 p = set1(8.05374449538e-2f);
+		p = add(mul(p, z), set1(-1.38776856032e-1f));
+		p = add(mul(p, z), set1(1.99777106478e-1f));
+		p = add(mul(p, z), set1(-3.33329491539e-1f));
+		p = add(mul(mul(p, z), t), t);
+
+		f4 r = add(p, select(shift, set1(PIf / 4.0f), zero));
+
+		r = select(gt(ay, ax), sub(set1(PIHf), r), r);
+		r = select(lt(x, zero), sub(set1(PIf), r), r);
+
+		return copySign(r, y);
+	}
+
+	f4 asin(f4 v)
+	{
+		f4 one = set1(1.0f);
+
+		v = min(max(v, set1(-1.0f)), one);
+
+		return atan2(v, sqrt(mul(sub(one, v), add(one, v))));
+	}
+
+	#else
+
+	// Without SSE2 the lanes are plain floats and the trigonometry is the
+	// standard library's, as in conversions.cpp, which beats evaluating the
+	// polynomials a lane at a time.
+	struct f4 { float v[4]; };
+
+	inline f4 set1(float v) { f4 r; for (size_t i = 0; i < 4; i++) r.v[i] = v; return r; }
+	inline f4 load(const float* p) { f4 r; for (size_t i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+	inline void store(float* p, f4 a) { for (size_t i = 0; i < 4; i++) p[i] = a.v[i]; }
+
+	inline f4 add(f4 a, f4 b) { for (size_t i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+	inline f4 sub(f4 a, f4 b) { for (size_t i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+	inline f4 mul(f4 a, f4 b) { for (size_t i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+
+	void sincos(f4 x, f4& s, f4& c)
+	{
+		for (size_t i = 0; i < 4; i++)
+		{
+			s.v[i] = static_cast<float>(std::sin(static_cast<double>(x.v[i])));
+			c.v[i] = static_cast<float>(std::cos(static_cast<double>(x.v[i])));
+		}
+	}
+
+	f4 atan2(f4 y, f4 x)
+	{
+		for (size_t i = 0; i < 4; i++)
+			y.v[i] = static_cast<float>(std::atan2(static_cast<double>(y.v[i]), static_cast<double>(x.v[i])));
+
+		return y;
+	}
+
+	f4 asin(f4 v)
+	{
+		for (size_t i = 0; i < 4; i++)
+			v.v[i] = static_cast<float>(std::asin(v.v[i] < -1.0f ? -1.0 : v.v[i] > 1.0f ? 1.0 : static_cast<double>(v.v[i])));
+
+		return v;
+	}
+
+	#endif
+
+	// Lane k of the block of four starting at i, repeating the last value
+	// past the end.
+	inline size_t lane(size_t i, size_t k, size_t end)
+	{
+		return i + k < end ? i + k : end - 1;
+	}
+
+	// Loads the block of four values starting at i of an array holding N
+	// floats per value, one component per f4.
+	template<size_t N>
+	void gather(const float* in, size_t i, size_t end, f4 (&lanes)[N])
+	{
+		float t[N][4];
+
+		for (size_t k = 0; k < 4; k++)
+		{
+			const float* v = in + lane(i, k, end) * N;
+
+			for (size_t c = 0; c < N; c++)
+				t[c][k] = v[c];
+		}
+
+		for (size_t c = 0; c < N; c++)
+			lanes[c] = load(t[c]);
+	}
+
+	template<size_t N>
+	void scatter(float* out, size_t i, size_t end, const f4 (&lanes)[N])
+	{
+		float t[N][4];
+
+		for (size_t c = 0; c < N; c++)
+			store(t[c], lanes[c]);
+
+		for (size_t k = 0; k < 4 && i + k < end; k++)
+		{
+			float* v = out + (i + k) * N;
+
+			for (size_t c = 0; c < N; c++)
+				v[c] = t[c][k];
+		}
+	}
+
+	f4 loadBlock(const float* in, size_t i, size_t end)
+	{
+		if (end - i >= 4)
+			return load(in + i);
+
+		float t[4];
+
+		for (size_t k = 0; k < 4; k++)
+			t[k] = in[lane(i, k, end)];
+
+		return load(t);
+	}
+
+	void storeBlock(float* out, size_t i, size_t end, f4 v)
+	{
+		if (end - i >= 4)
+		{
+			store(out + i, v);
+			return;
+		}
+
+		float t[4];
+
+		store(t, v);
+
+		for (size_t k = 0; i + k < end; k++)
+			out[i + k] = t[k];
+	}
+
+	// The conversions of conversions.cpp, four values at a time. Angles are
+	// multiplied by scale on the way in or out to handle degrees.
+
+	void quat2Ypr(f4 q1, f4 q2, f4 q3, f4 q0, f4 scale, f4& yaw, f4& pitch, f4& roll)
+	{
+		f4 two = set1(2.0f);
+		f4 q00 = mul(q0, q0);
+		f4 q11 = mul(q1, q1);
+		f4 q22 = mul(q2, q2);
+		f4 q33 = mul(q3, q3);
+
+		yaw = atan2(
+			mul(two, add(mul(q1, q2), mul(q0, q3))),
+			sub(sub(add(q00, q11), q22), q33));
+		pitch = asin(mul(set1(-2.0f), sub(mul(q1, q3), mul(q0, q2))));
+		roll = atan2(
+			mul(two, add(mul(q2, q3), mul(q0, q1))),
+			add(sub(sub(q00, q11), q22), q33));
+
+		yaw = mul(yaw, scale);
+		pitch = mul(pitch, scale);
+		roll = mul(roll, scale);
+	}
+
+	void ypr2Quat(f4 yaw, f4 pitch, f4 roll, f4 scale, f4& x, f4& y, f4& z, f4& w)
+	{
+		f4 half = mul(scale, set1(0.5f));
+		f4 s1, c1, s2, c2, s3, c3;
+
+		sincos(mul(yaw, half), s1, c1);
+		sincos(mul(pitch, half), s2, c2);
+		sincos(mul(roll, half), s3, c3);
+
+		f4 c1c2 = mul(c1, c2);
+		f4 s1s2 = mul(s1, s2);
+		f4 c1s2 = mul(c1, s2);
+		f4 s1c2 = mul(s1, c2);
+
+		x = sub(mul(c1c2, s3), mul(s1s2, c3));
+		y = add(mul(c1s2, c3), mul(s1c2, s3));
+		z = sub(mul(s1c2, c3), mul(c1s2, s3));
+		w = add(mul(c1c2, c3), mul(s1s2, s3));
+	}
+
+	// Fills the elements in mat3f's storage order, column by column.
+	void ypr2Dcm(f4 yaw, f4 pitch, f4 roll, f4 scale, f4 (&e)[9])
+	{
+		f4 st1, ct1, st2, ct2, st3, ct3;
+
+		sincos(mul(yaw, scale), st1, ct1);
+		sincos(mul(pitch, scale), st2, ct2);
+		sincos(mul(roll, scale), st3, ct3);
+
+		f4 st2ct1 = mul(st2, ct1);
+		f4 st2st1 = mul(st2, st1);
+
+		e[0] = mul(ct2, ct1);
+		e[1] = sub(mul(st3, st2ct1), mul(ct3, st1));
+		e[2] = add(mul(ct3, st2ct1), mul(st3, st1));
+		e[3] = mul(ct2, st1);
+		e[4] = add(mul(st3, st2st1), mul(ct3, ct1));
+		e[5] = sub(mul(ct3, st2st1), mul(st3, ct1));
+		e[6] = sub(set1(0.0f), st2);
+		e[7] = mul(st3, ct2);
+		e[8] = mul(ct3, ct2);
+	}
+
+	// Takes the elements in mat3f's storage order.
+	void dcm2Ypr(const f4 (&e)[9], f4 scale, f4& yaw, f4& pitch, f4& roll)
+	{
+		yaw = mul(atan2(e[3], e[0]), scale);
+		pitch = mul(asin(sub(set1(0.0f), e[6])), scale);
+		roll = mul(atan2(e[7], e[8]), scale);
+	}
+
+	// Range routines for ThreadPool::parallelFor.
+
+	template<typename In, typename Out>
+	struct AosJob
+	{
+		const In* in;
+		Out* out;
+		float scale;
+	};
+
+	void quat2YprAos(void* userData, size_t begin, size_t end)
+	{
+		AosJob<vec4f, vec3f>* j = static_cast<AosJob<vec4f, vec3f>*>(userData);
+		const float* in = j->in[0].c;
+		float* out = j->out[0].c;
+		f4 scale = set1(j->scale);
+
+		for (size_t i = begin; i < end; i += 4)
+		{
+			f4 q[4];
+			f4 ypr[3];
+
+			gather(in, i, end, q);
+			quat2Ypr(q[0], q[1], q[2], q[3], scale, ypr[0], ypr[1], ypr[2]);
+			scatter(out, i, end, ypr);
+		}
+	}
+
+	void ypr2QuatAos(void* userData, size_t begin, size_t end)
+	{
+		AosJob<vec3f, vec4f>* j = static_cast<AosJob<vec3f, vec4f>*>(userData);
+		const float* in = j->in[0].c;
+		float* out = j->out[0].c;
+		f4 scale = set1(j->scale);
+
+		for (size_t i = begin; i < end; i += 4)
+		{
+			f4 ypr[3];
+			f4 q[4];
+
+			gather(in, i, end, ypr);
+			ypr2Quat(ypr[0], ypr[1], ypr[2], scale, q[0], q[1], q[2], q[3]);
+			scatter(out, i, end, q);
+		}
+	}
+
+	void ypr2DcmAos(void* userData, size_t begin, size_t end)
+	{
+		AosJob<vec3f, mat3f>* j = static_cast<AosJob<vec3f, mat3f>*>(userData);
+		const float* in = j->in[0].c;
+		float* out = j->out[0].e;
+		f4 scale = set1(j->scale);
+
+		for (size_t i = begin; i < end; i += 4)
+		{
+			f4 ypr[3];
+			f4 e[9];
+
+			gather(in, i, end, ypr);
+			ypr2Dcm(ypr[0], ypr[1], ypr[2], scale, e);
+			scatter(out, i, end, e);
+		}
+	}
+
+	void dcm2YprAos(void* userData, size_t begin, size_t end)
+	{
+		AosJob<mat3f, vec3f>* j = static_cast<AosJob<mat3f, vec3f>*>(userData);
+		const float* in = j->in[0].e;
+		float* out = j->out[0].c;
+		f4 scale = set1(j->scale);
+
+		for (size_t i = begin; i < end; i += 4)
+		{
+			f4 e[9];
+			f4 ypr[3];
+
+			gather(in, i, end, e);
+			dcm2Ypr(e, scale, ypr[0], ypr[1], ypr[2]);
+			scatter(out, i, end, ypr);
+		}
+	}
+
+	// Conversions without trigonometry gain little from lanes, so just run
+	// the single-value versions.
+	template<typename In, typename Out, Out (*convert)(In)>
+	void convertEachAos(void* userData, size_t begin, size_t end)
+	{
+		AosJob<In, Out>* j = static_cast<AosJob<In, Out>*>(userData);
+
+		for (size_t i = begin; i < end; i++)
+			j->out[i] = convert(j->in[i]);
+	}
+
+	struct SoaJob
+	{
+		const float* in[4];
+		float* out[4];
+		float scale;
+	};
+
+	void quat2YprSoa(void* userData, size_t begin, size_t end)
+	{
+		SoaJob* j = static_cast<SoaJob*>(userData);
+		f4 scale = set1(j->scale);
+
+		for (size_t i = begin; i < end; i += 4)
+		{
+			f4 yaw, pitch, roll;
+
+			quat2Ypr(
+				loadBlock(j->in[0], i, end),
+				loadBlock(j->in[1], i, end),
+				loadBlock(j->in[2], i, end),
+				loadBlock(j->in[3], i, end),
+				scale, yaw, pitch, roll);
+
+			storeBlock(j->out[0], i, end, yaw);
+			storeBlock(j->out[1], i, end, pitch);
+			storeBlock(j->out[2], i, end, roll);
+		}
+	}
+
+	void ypr2QuatSoa(void* userData, size_t begin, size_t end)
+	{
+		SoaJob* j = static_cast<SoaJob*>(userData);
+		f4 scale = set1(j->scale);
+
+		for (size_t i = begin; i < end; i += 4)
+		{
+			f4 x, y, z, w;
+
+			ypr2Quat(
+				loadBlock(j->in[0], i, end),
+				loadBlock(j->in[1], i, end),
+				loadBlock(j->in[2], i, end),
+				scale, x, y, z, w);
+
+			storeBlock(j->out[0], i, end, x);
+			storeBlock(j->out[1], i, end, y);
+			storeBlock(j->out[2], i, end, z);
+			storeBlock(j->out[3], i, end, w);
+		}
+	}
+
+	void run(ThreadPool::RangeRoutine routine, void* userData, size_t count, ThreadPool* pool)
+	{
+		if (count == 0)
+			return;
+
+		if (pool != NULL && count >= ParallelMinCount)
+			pool->parallelFor(count, routine, userData, ParallelMinChunk);
+		else
+			routine(userData, 0, count);
+	}
+
+	template<typename In, typename Out>
+	void runAos(ThreadPool::RangeRoutine routine, const In* in, Out* out, size_t count, float scale, ThreadPool* pool)
+	{
+		AosJob<In, Out> j;
+		j.in = in;
+		j.out = out;
+		j.scale = scale;
+
+		run(routine, &j, count, pool);
+	}
+
+	void runQuat2YprSoa(
+		const float* qx, const float* qy, const float* qz, const float* qw,
+		float* yaw, float* pitch, float* roll,
+		size_t count, float scale, ThreadPool* pool)
+	{
+		SoaJob j;
+		j.in[0] = qx;
+		j.in[1] = qy;
+		j.in[2] = qz;
+		j.in[3] = qw;
+		j.out[0] = yaw;
+		j.out[1] = pitch;
+		j.out[2] = roll;
+		j.out[3] = NULL;
+		j.scale = scale;
+
+		run(quat2YprSoa, &j, count, pool);
+	}
+
+	void runYpr2QuatSoa(
+		const float* yaw, const float* pitch, const float* roll,
+		float* qx, float* qy, float* qz, float* qw,
+		size_t count, float scale, ThreadPool* pool)
+	{
+		SoaJob j;
+		j.in[0] = yaw;
+		j.in[1] = pitch;
+		j.in[2] = roll;
+		j.in[3] = NULL;
+		j.out[0] = qx;
+		j.out[1] = qy;
+		j.out[2] = qz;
+		j.out[3] = qw;
+		j.scale = scale;
+
+		run(ypr2QuatSoa, &j, count, pool);
+	}
+}
+
+void quat2YprInDegs(const vec4f* quats, vec3f* yprs, size_t count, ThreadPool* pool)
+{
+	runAos(quat2YprAos, quats, yprs, count, Rad2Deg, pool);
+}
+
+void quat2YprInRads(const vec4f* quats, vec3f* yprs, size_t count, ThreadPool* pool)
+{
+	runAos(quat2YprAos, quats, yprs, count, 1.0f, pool);
+}
+
+void yprInDegs2Quat(const vec3f* yprs, vec4f* quats, size_t count, ThreadPool* pool)
+{
+	runAos(ypr2QuatAos, yprs, quats, count, Deg2Rad, pool);
+}
+
+void yprInRads2Quat(const vec3f* yprs, vec4f* quats, size_t count, ThreadPool* pool)
+{
+	runAos(ypr2QuatAos, yprs, quats, count, 1.0f, pool);
+}
+
+void yprInDegs2Dcm(const vec3f* yprs, mat3f* dcms, size_t count, ThreadPool* pool)
+{
+	runAos(ypr2DcmAos, yprs, dcms, count, Deg2Rad, pool);
+}
+
+void yprInRads2Dcm(const vec3f* yprs, mat3f* dcms, size_t count, ThreadPool* pool)
+{
+	runAos(ypr2DcmAos, yprs, dcms, count, 1.0f, pool);
+}
+
+void dcm2YprInDegs(const mat3f* dcms, vec3f* yprs, size_t count, ThreadPool* pool)
+{
+	runAos(dcm2YprAos, dcms, yprs, count, Rad2Deg, pool);
+}
+
+void dcm2YprInRads(const mat3f* dcms, vec3f* yprs, size_t count, ThreadPool* pool)
+{
+	runAos(dcm2YprAos, dcms, yprs, count, 1.0f, pool);
+}
+
+void quat2dcm(const vec4f* quats, mat3f* dcms, size_t count, ThreadPool* pool)
+{
+	runAos(convertEachAos<vec4f, mat3f, quat2dcm>, quats, dcms, count, 1.0f, pool);
+}
+
+void dcm2quat(const mat3f* dcms, vec4f* quats, size_t count, ThreadPool* pool)
+{
+	runAos(convertEachAos<mat3f, vec4f, dcm2quat>, dcms, quats, count, 1.0f, pool);
+}
+
+void quat2YprInDegs(
+	const float* qx, const float* qy, const float* qz, const float* qw,
+	float* yaw, float* pitch, float* roll,
+	size_t count, ThreadPool* pool)
+{
+	runQuat2YprSoa(qx, qy, qz, qw, yaw, pitch, roll, count, Rad2Deg, pool);
+}
+
+void quat2YprInRads(
+	const float* qx, const float* qy, const float* qz, const float* qw,
+	float* yaw, float* pitch, float* roll,
+	size_t count, ThreadPool* pool)
+{
+	runQuat2YprSoa(qx, qy, qz, qw, yaw, pitch, roll, count, 1.0f, pool);
+}
+
+void yprInDegs2Quat(
+	const float* yaw, const float* pitch, const float* roll,
+	float* qx, float* qy, float* qz, float* qw,
+	size_t count, ThreadPool* pool)
+{
+	runYpr2QuatSoa(yaw, pitch, roll, qx, qy, qz, qw, count, Deg2Rad, pool);
+}
+
+void yprInRads2Quat(
+	const float* yaw, const float* pitch, const float* roll,
+	float* qx, float* qy, float* qz, float* qw,
+	size_t count, ThreadPool* pool)
+{
+	runYpr2QuatSoa(yaw, pitch, roll, qx, qy, qz, qw, count, 1.0f, pool);
+}
+
+}
+}
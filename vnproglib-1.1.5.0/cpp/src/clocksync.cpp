@@ -0,0 +1,190 @@
+#include "vn/clocksync.h"
+
+#include <cmath>
+
+#include "vn/exceptions.h"
+
+using namespace std;
+using namespace vn::xplat;
+
+namespace vn {
+namespace sensors {
+
+namespace
+{
+	// Restart the model if host and sensor time disagree by more than this,
+	// e.g. after the sensor was reconnected.
+	const double MaxDisagreementSec = 1.0;
+
+	// Restart the model if the sensor time goes back by more than this, e.g.
+	// when the sensor restarted. Smaller steps back, and time standing still
+	// as TimeGps does before a fix, only skip the sample.
+	const double MaxBackwardStepSec = 1.0;
+}
+
+ClockSync::ClockSync(double windowSec, double minSpanSec) :
+	_windowSec(windowSec),
+	_minSpanSec(minSpanSec),
+	_haveOrigin(false),
+	_originSensorNs(0),
+	_originHostNs(0),
+	_hostClock(TimeStamp::CLOCKSOURCE_MONOTONIC),
+	_last(0, 0),
+	_synchronized(false),
+	_intercept(0),
+	_slope(1),
+	_numOfResets(0)
+{ }
+
+TimeStamp ClockSync::process(uint64_t sensorTimeNs, TimeStamp hostTime)
+{
+	if (!_haveOrigin)
+	{
+		restart(sensorTimeNs, hostTime);
+
+		return hostTime;
+	}
+
+	if (hostTime.clockSource() != _hostClock)
+	{
+		_numOfResets++;
+		restart(sensorTimeNs, hostTime);
+
+		return hostTime;
+	}
+
+	Point p(
+		static_cast<int64_t>(sensorTimeNs - _originSensorNs) / 1e9,
+		(hostTime.totalNs() - _originHostNs) / 1e9);
+
+	if (p.x <= _last.x && _last.x - p.x <= MaxBackwardStepSec)
+		return hostTime;
+
+	if (p.x <= _last.x || fabs((p.y - _last.y) - (p.x - _last.x)) > MaxDisagreementSec)
+	{
+		_numOfResets++;
+		restart(sensorTimeNs, hostTime);
+
+		return hostTime;
+	}
+
+	_last = p;
+	addToHull(p);
+	updateModel();
+
+	if (!_synchronized)
+		return hostTime;
+
+	return toHostTime(sensorTimeNs);
+}
+
+bool ClockSync::process(CompositeData& cd, TimeStamp hostTime, TimeStamp& correctedTime)
+{
+	correctedTime = hostTime;
+
+	if (cd.hasTimeStartup())
+		correctedTime = process(cd.timeStartup(), hostTime);
+	else if (cd.hasTimeGps())
+		correctedTime = process(cd.timeGps(), hostTime);
+	else
+		return false;
+
+	return true;
+}
+
+TimeStamp ClockSync::toHostTime(uint64_t sensorTimeNs) const
+{
+	if (!_synchronized)
+		throw invalid_operation();
+
+	double x = (static_cast<int64_t>(sensorTimeNs - _originSensorNs)) / 1e9;
+	double y = _intercept + _slope * x;
+
+	return TimeStamp::fromNs(_originHostNs + static_cast<int64_t>(y * 1e9), _hostClock);
+}
+
+bool ClockSync::isSynchronized() const
+{
+	return _synchronized;
+}
+
+double ClockSync::drift() const
+{
+	return _slope - 1.0;
+}
+
+uint64_t ClockSync::numOfResets() const
+{
+	return _numOfResets;
+}
+
+void ClockSync::reset()
+{
+	_haveOrigin = false;
+	_hull.clear();
+	_synchronized = false;
+	_intercept = 0;
+	_slope = 1;
+}
+
+void ClockSync::restart(uint64_t sensorTimeNs, TimeStamp hostTime)
+{
+	reset();
+
+	_haveOrigin = true;
+	_originSensorNs = sensorTimeNs;
+	_originHostNs = hostTime.totalNs();
+	_hostClock = hostTime.clockSource();
+	_last = Point(0, 0);
+	_hull.push_back(_last);
+}
+
+void ClockSync::addToHull(const Point& p)
+{
+	// Remove points that are no longer on the lower hull. A point is removed
+	// if it lies on or above the line from its predecessor to the new point.
+	while (_hull.size() >= 2)
+	{
+		const Point& a = _hull[_hull.size() - 2];
+		const Point& b = _hull[_hull.size() - 1];
+
+		double cross = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+
+		if (cross > 0)
+			break;
+
+		_hull.pop_back();
+	}
+
+	_hull.push_back(p);
+
+	// Slide the window. Points dropped here only approximate the hull of the
+	// windowed samples, which is adequate since drift changes slowly.
+	while (_hull.size() > 2 && p.x - _hull[1].x > _windowSec)
+		_hull.pop_front();
+}
+
+void ClockSync::updateModel()
+{
+	if (_hull.size() < 2 || _hull.back().x - _hull.front().x < _minSpanSec)
+		return;
+
+	// Use the hull edge under the middle of the window. Every edge of the
+	// lower hull lies below all samples, and the middle one is fit over the
+	// longest baseline.
+	double mid = (_hull.front().x + _hull.back().x) / 2;
+
+	size_t i = 0;
+	while (i + 2 < _hull.size() && _hull[i + 1].x < mid)
+		i++;
+
+	const Point& a = _hull[i];
+	const Point& b = _hull[i + 1];
+
+	_slope = (b.y - a.y) / (b.x - a.x);
+	_intercept = a.y - _slope * a.x;
+	_synchronized = true;
+}
+
+}
+}
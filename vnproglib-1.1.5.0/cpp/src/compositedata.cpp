@@ -904,13 +904,13 @@ CompositeData::~CompositeData()
 
 CompositeData& CompositeData::operator=(const CompositeData& RHS)
 {
-	if (NULL != _i)
-	{
-		delete _i;
-	}
+	// Reuses the existing Impl so copying samples around, e.g. through the
+	// history ring, does not allocate.
+	if (NULL == _i)
+		_i = new Impl();
 
-	_i = new Impl();
-	(*_i) = (*RHS._i);
+	if (this != &RHS)
+		(*_i) = (*RHS._i);
 
 	return *this;
 }
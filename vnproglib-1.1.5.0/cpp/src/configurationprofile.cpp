@@ -0,0 +1,238 @@
+#include "vn/configurationprofile.h"
+
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <stdio.h>
+
+#include "vn/exceptions.h"
+
+using namespace std;
+using namespace vn::protocol::uart;
+
+namespace vn {
+namespace sensors {
+
+namespace
+{
+	// The sensor reports floats with 6 significant decimals or so, and the
+	// profile may be written with fewer.
+	const double DecimalTolerance = 1e-5;
+
+	string toString(uint32_t value)
+	{
+		char buffer[16];
+
+		#if VN_HAVE_SECURE_CRT
+		sprintf_s(buffer, sizeof(buffer), "%u", value);
+		#else
+		sprintf(buffer, "%u", value);
+		#endif
+
+		return buffer;
+	}
+
+	string toHexString(uint32_t value)
+	{
+		char buffer[16];
+
+		#if VN_HAVE_SECURE_CRT
+		sprintf_s(buffer, sizeof(buffer), "%X", value);
+		#else
+		sprintf(buffer, "%X", value);
+		#endif
+
+		return buffer;
+	}
+
+	string trim(const string& s)
+	{
+		size_t first = 0;
+		size_t last = s.size();
+
+		while (first < last && isspace(static_cast<unsigned char>(s[first])))
+			first++;
+		while (last > first && isspace(static_cast<unsigned char>(s[last - 1])))
+			last--;
+
+		return s.substr(first, last - first);
+	}
+
+	vector<string> split(const string& s)
+	{
+		vector<string> fields;
+		size_t start = 0;
+
+		while (true)
+		{
+			size_t comma = s.find(',', start);
+
+			fields.push_back(trim(s.substr(start, comma == string::npos ? string::npos : comma - start)));
+
+			if (comma == string::npos)
+				return fields;
+
+			start = comma + 1;
+		}
+	}
+
+	bool equalsIgnoreCase(const string& a, const string& b)
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i])))
+				return false;
+		}
+
+		return true;
+	}
+
+	bool parseDecimal(const string& s, double& value)
+	{
+		if (s.empty())
+			return false;
+
+		char* end;
+		value = strtod(s.c_str(), &end);
+
+		return *end == '\0';
+	}
+
+	bool parseHex(const string& s, unsigned long& value)
+	{
+		if (s.empty())
+			return false;
+
+		char* end;
+		value = strtoul(s.c_str(), &end, 16);
+
+		return *end == '\0';
+	}
+
+	// Indicates if a field is a real number, i.e. has a decimal point or a
+	// signed exponent. A bare "00E4" is a hexadecimal field, not 0e4.
+	bool isReal(const string& s)
+	{
+		if (s.find('.') != string::npos)
+			return true;
+
+		size_t e = s.find_first_of("eE");
+
+		return e != string::npos && e + 1 < s.size() && (s[e + 1] == '+' || s[e + 1] == '-');
+	}
+
+	bool fieldMatches(const string& a, const string& b)
+	{
+		if (equalsIgnoreCase(a, b))
+			return true;
+
+		// Only real numbers are rounded by the sensor; integers must match
+		// exactly, however large.
+		double da, db;
+		if ((isReal(a) || isReal(b)) && parseDecimal(a, da) && parseDecimal(b, db))
+			return fabs(da - db) <= DecimalTolerance * (1 + fabs(da) + fabs(db));
+
+		unsigned long ha, hb;
+		if (parseHex(a, ha) && parseHex(b, hb))
+			return ha == hb;
+
+		if (parseDecimal(a, da) && parseDecimal(b, db))
+			return da == db;
+
+		return false;
+	}
+}
+
+ConfigurationProfile::ConfigurationProfile() :
+	_persist(false)
+{ }
+
+void ConfigurationProfile::set(uint8_t registerId, const string& fields)
+{
+	for (size_t i = 0; i < _entries.size(); i++)
+	{
+		if (_entries[i].registerId == registerId)
+		{
+			_entries[i].fields = fields;
+			return;
+		}
+	}
+
+	_entries.push_back(Entry(registerId, fields));
+}
+
+void ConfigurationProfile::setAsyncDataOutputType(AsciiAsync ador)
+{
+	set(6, toString(ador));
+}
+
+void ConfigurationProfile::setAsyncDataOutputFrequency(uint32_t adof)
+{
+	set(7, toString(adof));
+}
+
+void ConfigurationProfile::setBinaryOutput(uint8_t binaryOutputNumber, const BinaryOutputRegister& fields)
+{
+	if (binaryOutputNumber < 1 || binaryOutputNumber > 3)
+		throw invalid_argument("binaryOutputNumber");
+
+	// Same layout as VnSensor::writeBinaryOutput1..3 use.
+	uint16_t groups = 0;
+	string groupFields;
+
+	const uint16_t groupValues[] = { static_cast<uint16_t>(fields.commonField), static_cast<uint16_t>(fields.timeField), static_cast<uint16_t>(fields.imuField), static_cast<uint16_t>(fields.gpsField), static_cast<uint16_t>(fields.attitudeField), static_cast<uint16_t>(fields.insField), static_cast<uint16_t>(fields.gps2Field) };
+
+	for (size_t i = 0; i < sizeof(groupValues) / sizeof(groupValues[0]); i++)
+	{
+		if (groupValues[i] == 0)
+			continue;
+
+		groups |= 1 << i;
+		groupFields += "," + toHexString(groupValues[i]);
+	}
+
+	set(74 + binaryOutputNumber, toString(fields.asyncMode) + "," + toString(fields.rateDivisor) + "," + toHexString(groups) + groupFields);
+}
+
+bool ConfigurationProfile::persist() const
+{
+	return _persist;
+}
+
+void ConfigurationProfile::setPersist(bool persist)
+{
+	_persist = persist;
+}
+
+const vector<ConfigurationProfile::Entry>& ConfigurationProfile::entries() const
+{
+	return _entries;
+}
+
+void ConfigurationProfile::clear()
+{
+	_entries.clear();
+}
+
+bool ConfigurationProfile::fieldsMatch(const string& a, const string& b)
+{
+	vector<string> fa = split(a);
+	vector<string> fb = split(b);
+
+	if (fa.size() != fb.size())
+		return false;
+
+	for (size_t i = 0; i < fa.size(); i++)
+	{
+		if (!fieldMatches(fa[i], fb[i]))
+			return false;
+	}
+
+	return true;
+}
+
+}
+}
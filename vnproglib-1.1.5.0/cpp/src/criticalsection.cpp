@@ -2,7 +2,11 @@
 
 #if _WIN32
 	#include <Windows.h>
-#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+#elif __linux__
+	#include <unistd.h>
+	#include <sys/syscall.h>
+	#include <linux/futex.h>
+#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 	#include <pthread.h>
 #else
 	#error "Unknown System"
@@ -15,11 +19,65 @@ using namespace std;
 namespace vn {
 namespace xplat {
 
+#if __linux__
+
+namespace
+{
+	// Futex states of a critical section.
+	const int Unlocked = 0;
+	const int Locked = 1;
+	const int LockedMaybeWaiters = 2;
+
+	void futexWait(std::atomic<int>* address, int value)
+	{
+		syscall(SYS_futex, reinterpret_cast<int*>(address), FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+	}
+
+	void futexWake(std::atomic<int>* address)
+	{
+		syscall(SYS_futex, reinterpret_cast<int*>(address), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	}
+}
+
+CriticalSection::CriticalSection() :
+	_state(Unlocked)
+{ }
+
+CriticalSection::~CriticalSection()
+{ }
+
+void CriticalSection::enter()
+{
+	// Taking a free lock is a single compare-and-swap.
+	int c = Unlocked;
+	if (_state.compare_exchange_strong(c, Locked, memory_order_acquire))
+		return;
+
+	// Mark the lock as contended so the holder wakes us when leaving, and
+	// sleep until we are the one who took it.
+	if (c != LockedMaybeWaiters)
+		c = _state.exchange(LockedMaybeWaiters, memory_order_acquire);
+
+	while (c != Unlocked)
+	{
+		futexWait(&_state, LockedMaybeWaiters);
+		c = _state.exchange(LockedMaybeWaiters, memory_order_acquire);
+	}
+}
+
+void CriticalSection::leave()
+{
+	if (_state.exchange(Unlocked, memory_order_release) == LockedMaybeWaiters)
+		futexWake(&_state);
+}
+
+#else
+
 struct CriticalSection::Impl
 {
 	#if _WIN32
 	CRITICAL_SECTION CriticalSection;
-	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 	pthread_mutex_t CriticalSection;
 	#else
 	#error "Unknown System"
@@ -35,7 +93,7 @@ CriticalSection::CriticalSection() :
 {
 	#if _WIN32
 	InitializeCriticalSection(&_pi->CriticalSection);
-	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 	pthread_mutex_init(&_pi->CriticalSection, NULL);
 	#else
 	#error "Unknown System"
@@ -46,7 +104,7 @@ CriticalSection::~CriticalSection()
 {
 	#if _WIN32
 	DeleteCriticalSection(&_pi->CriticalSection);
-	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 	pthread_mutex_destroy(&_pi->CriticalSection);
 	#else
 	#error "Unknown System"
@@ -59,7 +117,7 @@ void CriticalSection::enter()
 {
 	#if _WIN32
 	EnterCriticalSection(&_pi->CriticalSection);
-	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 	pthread_mutex_lock(&_pi->CriticalSection);
 	#else
 	#error "Unknown System"
@@ -70,12 +128,14 @@ void CriticalSection::leave()
 {
 	#if _WIN32
 	LeaveCriticalSection(&_pi->CriticalSection);
-	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 	pthread_mutex_unlock(&_pi->CriticalSection);
 	#else
 	#error "Unknown System"
 	#endif
 }
 
+#endif
+
 }
 }
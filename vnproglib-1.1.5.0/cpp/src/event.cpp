@@ -3,7 +3,14 @@
 
 #if _WIN32
 	#include <Windows.h>
-#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+#elif __linux__
+	#include <atomic>
+	#include <errno.h>
+	#include <time.h>
+	#include <unistd.h>
+	#include <sys/syscall.h>
+	#include <linux/futex.h>
+#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 	#include <errno.h>
 	#include <pthread.h>
 	#include <time.h>
@@ -23,11 +30,76 @@ using namespace std;
 namespace vn {
 namespace xplat {
 
+#if __linux__
+
+namespace
+{
+	// Futex states of an event.
+	const int NotSignaled = 0;
+	const int Signaled = 1;
+	const int NotSignaledMaybeWaiters = 2;
+
+	int futexWait(std::atomic<int>* address, int value, const timespec* timeout)
+	{
+		return syscall(SYS_futex, reinterpret_cast<int*>(address), FUTEX_WAIT_PRIVATE, value, timeout, NULL, 0);
+	}
+
+	void futexWake(std::atomic<int>* address)
+	{
+		syscall(SYS_futex, reinterpret_cast<int*>(address), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+	}
+
+	int64_t monotonicNs()
+	{
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+	}
+}
+
+Event::Event() :
+	_state(NotSignaled)
+{ }
+
+Event::~Event()
+{ }
+
+Event::WaitResult Event::waitNs(int64_t timeoutNs)
+{
+	int expected = Signaled;
+	if (_state.compare_exchange_strong(expected, NotSignaled))
+		return WAIT_SIGNALED;
+
+	// Futex timeouts are relative and measured on CLOCK_MONOTONIC, so wall
+	// clock changes do not affect them.
+	int64_t deadlineNs = monotonicNs() + timeoutNs;
+
+	while (_state.exchange(NotSignaledMaybeWaiters) != Signaled)
+	{
+		int64_t remainingNs = deadlineNs - monotonicNs();
+
+		if (remainingNs <= 0)
+			return WAIT_TIMEDOUT;
+
+		timespec timeout;
+		timeout.tv_sec = static_cast<time_t>(remainingNs / 1000000000);
+		timeout.tv_nsec = static_cast<long>(remainingNs % 1000000000);
+
+		if (futexWait(&_state, NotSignaledMaybeWaiters, &timeout) == -1 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+			throw unknown_error();
+	}
+
+	return WAIT_SIGNALED;
+}
+
+#else
+
 struct Event::Impl
 {
 	#if _WIN32
 	HANDLE EventHandle;
-	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 	pthread_mutex_t Mutex;
 	pthread_cond_t Condition;
 	bool IsTriggered;
@@ -38,7 +110,7 @@ struct Event::Impl
 	Impl() :
 		#if _WIN32
 		EventHandle(NULL)
-		#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+		#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 		IsTriggered(false)
 		#else
 		#error "Unknown System"
@@ -55,7 +127,7 @@ struct Event::Impl
 		if (EventHandle == NULL)
 			throw unknown_error();
 
-		#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+		#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 
 		pthread_mutex_init(&Mutex, NULL);
 
@@ -82,6 +154,8 @@ Event::~Event()
 	delete _pi;
 }
 
+#endif
+
 void Event::wait()
 {
 	#if _WIN32
@@ -95,13 +169,33 @@ void Event::wait()
 	if (result == WAIT_OBJECT_0)
 		return;
 
-	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#elif __linux__
+
+	int expected = Signaled;
+	if (_state.compare_exchange_strong(expected, NotSignaled))
+		return;
+
+	while (_state.exchange(NotSignaledMaybeWaiters) != Signaled)
+	{
+		if (futexWait(&_state, NotSignaledMaybeWaiters, NULL) == -1 && errno != EAGAIN && errno != EINTR)
+			throw unknown_error();
+	}
+
+	return;
+
+	#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 
 	pthread_mutex_lock(&_pi->Mutex);
 
-	int errorCode = pthread_cond_wait(
-		&_pi->Condition,
-		&_pi->Mutex);
+	int errorCode = 0;
+	while (!_pi->IsTriggered && errorCode == 0)
+	{
+		errorCode = pthread_cond_wait(
+			&_pi->Condition,
+			&_pi->Mutex);
+	}
+
+	_pi->IsTriggered = false;
 
 	pthread_mutex_unlock(&_pi->Mutex);
 
@@ -133,7 +227,11 @@ Event::WaitResult Event::waitUs(uint32_t timeoutInMicroSec)
 	if (result == WAIT_TIMEOUT)
 		return WAIT_TIMEDOUT;
 
-	#elif __linux__ || __CYGWIN__ || __QNXNTO__
+	#elif __linux__
+
+	return waitNs(static_cast<int64_t>(timeoutInMicroSec) * 1000);
+
+	#elif __CYGWIN__ || __QNXNTO__
 
 	pthread_mutex_lock(&_pi->Mutex);
 
@@ -152,14 +250,23 @@ Event::WaitResult Event::waitUs(uint32_t timeoutInMicroSec)
 		now.tv_sec++;
 	}
 
-	int errorCode = pthread_cond_timedwait(
-		&_pi->Condition,
-		&_pi->Mutex,
-		&now);
+	// Consume a signal that arrived before we started waiting, and keep
+	// waiting through spurious wakeups.
+	int errorCode = 0;
+	while (!_pi->IsTriggered && errorCode == 0)
+	{
+		errorCode = pthread_cond_timedwait(
+			&_pi->Condition,
+			&_pi->Mutex,
+			&now);
+	}
+
+	bool wasTriggered = _pi->IsTriggered;
+	_pi->IsTriggered = false;
 
 	pthread_mutex_unlock(&_pi->Mutex);
 
-	if (errorCode == 0)
+	if (wasTriggered)
 		return WAIT_SIGNALED;
 
 	if (errorCode == ETIMEDOUT)
@@ -191,14 +298,23 @@ Event::WaitResult Event::waitUs(uint32_t timeoutInMicroSec)
 		now.tv_sec++;
 	}
 
-	int errorCode = pthread_cond_timedwait(
-		&_pi->Condition,
-		&_pi->Mutex,
-		&now);
+	// Consume a signal that arrived before we started waiting, and keep
+	// waiting through spurious wakeups.
+	int errorCode = 0;
+	while (!_pi->IsTriggered && errorCode == 0)
+	{
+		errorCode = pthread_cond_timedwait(
+			&_pi->Condition,
+			&_pi->Mutex,
+			&now);
+	}
+
+	bool wasTriggered = _pi->IsTriggered;
+	_pi->IsTriggered = false;
 
 	pthread_mutex_unlock(&_pi->Mutex);
 
-	if (errorCode == 0)
+	if (wasTriggered)
 		return WAIT_SIGNALED;
 
 	if (errorCode == ETIMEDOUT)
@@ -229,7 +345,11 @@ Event::WaitResult Event::waitMs(uint32_t timeoutInMs)
 	if (result == WAIT_TIMEOUT)
 		return WAIT_TIMEDOUT;
 
-	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#elif __linux__
+
+	return waitNs(static_cast<int64_t>(timeoutInMs) * 1000000);
+
+	#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 
 	return waitUs(timeoutInMs * 1000);
 	
@@ -249,7 +369,12 @@ void Event::signal()
 	if (!SetEvent(_pi->EventHandle))
 		throw unknown_error();
 
-	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#elif __linux__
+
+	if (_state.exchange(Signaled) == NotSignaledMaybeWaiters)
+		futexWake(&_state);
+
+	#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
 
 	pthread_mutex_lock(&_pi->Mutex);
 
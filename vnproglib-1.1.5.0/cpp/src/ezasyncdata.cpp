@@ -1,5 +1,7 @@
 #include "vn/ezasyncdata.h"
 
+#include "vn/exceptions.h"
+
 using namespace std;
 
 namespace vn {
@@ -30,19 +32,105 @@ void EzAsyncData::asyncPacketReceivedHandler(void* userData, protocol::uart::Pac
 	CompositeData::parse(p, d);
 	ez->_mainCS.leave();
 
+	// Only this thread modifies _persistentData, so it can be read here
+	// without the lock.
+	ez->publishSample();
+
 	ez->_copyCS.enter();
+
 	ez->_nextData = nd;
+
+	// The consumer only waits when the history is empty, so it is only
+	// woken for the first sample of a batch.
+	bool wakeConsumer = !ez->_history.empty() && ez->_historyCount == 0;
+
+	if (!ez->_history.empty())
+	{
+		size_t capacity = ez->_history.size();
+
+		if (ez->_historyCount == capacity)
+		{
+			ez->_historyStart = (ez->_historyStart + 1) % capacity;
+			ez->_historyCount--;
+			ez->_historyOverflows++;
+		}
+
+		ez->_history[(ez->_historyStart + ez->_historyCount) % capacity] = nd;
+		ez->_historyCount++;
+	}
+
 	ez->_copyCS.leave();
 
 	ez->_newDataEvent.signal();
+
+	if (wakeConsumer)
+		ez->_historyEvent.signal();
 }
 
 #if defined (_MSC_VER)
 	#pragma warning(pop)
 #endif
 
+void EzAsyncData::publishSample()
+{
+	CompositeData& cd = _persistentData;
+	Sample s;
+
+	s.numOfPackets = ++_numOfPackets;
+
+	s.hasTimeStartup = cd.hasTimeStartup();
+	s.timeStartup = s.hasTimeStartup ? cd.timeStartup() : 0;
+
+	s.hasYawPitchRoll = cd.hasYawPitchRoll();
+	if (s.hasYawPitchRoll)
+		s.yawPitchRoll = cd.yawPitchRoll();
+
+	s.hasQuaternion = cd.hasQuaternion();
+	if (s.hasQuaternion)
+		s.quaternion = cd.quaternion();
+
+	s.hasAngularRate = cd.hasAngularRate();
+	if (s.hasAngularRate)
+		s.angularRate = cd.angularRate();
+
+	s.hasAcceleration = cd.hasAcceleration();
+	if (s.hasAcceleration)
+		s.acceleration = cd.acceleration();
+
+	s.hasMagnetic = cd.hasMagnetic();
+	if (s.hasMagnetic)
+		s.magnetic = cd.magnetic();
+
+	s.hasTemperature = cd.hasTemperature();
+	s.temperature = s.hasTemperature ? cd.temperature() : 0;
+
+	s.hasPressure = cd.hasPressure();
+	s.pressure = s.hasPressure ? cd.pressure() : 0;
+
+	s.hasPositionEstimatedLla = cd.hasPositionEstimatedLla();
+	if (s.hasPositionEstimatedLla)
+		s.positionEstimatedLla = cd.positionEstimatedLla();
+
+	s.hasVelocityEstimatedNed = cd.hasVelocityEstimatedNed();
+	if (s.hasVelocityEstimatedNed)
+		s.velocityEstimatedNed = cd.velocityEstimatedNed();
+
+	s.hasVelocityEstimatedBody = cd.hasVelocityEstimatedBody();
+	if (s.hasVelocityEstimatedBody)
+		s.velocityEstimatedBody = cd.velocityEstimatedBody();
+
+	s.hasInsStatus = cd.hasInsStatus();
+	s.insStatus = s.hasInsStatus ? cd.insStatus() : protocol::uart::InsStatus();
+
+	_latest.store(s);
+}
+
 EzAsyncData::EzAsyncData(VnSensor* sensor) :
-	_sensor(sensor)
+	_sensor(sensor),
+	_numOfPackets(0),
+	_historyStart(0),
+	_historyCount(0),
+	_historyOverflows(0)
 {
 	_sensor->registerAsyncPacketReceivedHandler(this, &EzAsyncData::asyncPacketReceivedHandler);
 }
@@ -90,6 +178,92 @@ CompositeData EzAsyncData::currentData()
 	return CompositeData(cd);
 }
 
+bool EzAsyncData::latestSample(Sample& sample, size_t maxAttempts)
+{
+	return _latest.tryLoad(sample, maxAttempts);
+}
+
+size_t EzAsyncData::historyCapacity()
+{
+	_copyCS.enter();
+	size_t capacity = _history.size();
+	_copyCS.leave();
+
+	return capacity;
+}
+
+void EzAsyncData::setHistoryCapacity(size_t capacity)
+{
+	// Allocated outside the lock so the packet handler is not held up.
+	vector<CompositeData> history(capacity);
+
+	_copyCS.enter();
+	_history.swap(history);
+	_historyStart = 0;
+	_historyCount = 0;
+	_copyCS.leave();
+}
+
+size_t EzAsyncData::getNextBatch(vector<CompositeData>& batch, size_t maxCount, int timeoutMs)
+{
+	xplat::Stopwatch sw;
+
+	_copyCS.enter();
+
+	if (_history.empty())
+	{
+		_copyCS.leave();
+		throw invalid_operation("The history is disabled.");
+	}
+
+	while (_historyCount == 0)
+	{
+		_copyCS.leave();
+
+		float elapsedMs = sw.elapsedMs();
+		uint32_t remainingMs = elapsedMs < static_cast<uint32_t>(timeoutMs) ? static_cast<uint32_t>(timeoutMs) - static_cast<uint32_t>(elapsedMs) : 0;
+
+		if (_historyEvent.waitMs(remainingMs) == xplat::Event::WAIT_TIMEDOUT)
+			throw timeout();
+
+		_copyCS.enter();
+	}
+
+	size_t count = _historyCount < maxCount ? _historyCount : maxCount;
+	size_t capacity = _history.size();
+
+	if (batch.size() < count)
+		batch.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+		batch[i] = _history[(_historyStart + i) % capacity];
+
+	_historyStart = (_historyStart + count) % capacity;
+	_historyCount -= count;
+
+	_copyCS.leave();
+
+	return count;
+}
+
+vector<CompositeData> EzAsyncData::getNextBatch(size_t maxCount, int timeoutMs)
+{
+	vector<CompositeData> batch;
+
+	batch.resize(getNextBatch(batch, maxCount, timeoutMs));
+
+	return batch;
+}
+
+uint64_t EzAsyncData::numOfHistoryOverflows()
+{
+	_copyCS.enter();
+	uint64_t overflows = _historyOverflows;
+	_copyCS.leave();
+
+	return overflows;
+}
+
 CompositeData EzAsyncData::getNextData()
 {
 	return getNextData(0xFFFFFFFF);
@@ -0,0 +1,108 @@
+#include "vn/gapdetector.h"
+
+using namespace std;
+using namespace vn::xplat;
+
+namespace vn {
+namespace sensors {
+
+GapDetector::GapDetector(uint64_t expectedPeriodNs) :
+	_expectedPeriodNs(expectedPeriodNs),
+	_learnedPeriodNs(0),
+	_haveTimeStartup(false),
+	_haveSyncInCnt(false),
+	_lastTimeStartup(0),
+	_lastSyncInCnt(0)
+{ }
+
+bool GapDetector::process(CompositeData& cd)
+{
+	bool gapFound = false;
+
+	_stats.numOfPackets++;
+
+	if (cd.hasTimeStartup())
+		gapFound |= checkTimeStartup(cd.timeStartup());
+
+	if (cd.hasSyncInCnt())
+		checkSyncInCnt(cd.syncInCnt());
+
+	if (gapFound)
+		_stats.lastGap = TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC);
+
+	return gapFound;
+}
+
+bool GapDetector::checkTimeStartup(uint64_t timeStartup)
+{
+	bool gapFound = false;
+
+	if (_haveTimeStartup)
+	{
+		if (timeStartup <= _lastTimeStartup)
+		{
+			// The sensor was reset or this is a duplicate, start over.
+			_stats.sensorResets++;
+			_learnedPeriodNs = 0;
+		}
+		else
+		{
+			uint64_t delta = timeStartup - _lastTimeStartup;
+
+			if (_expectedPeriodNs == 0 && (_learnedPeriodNs == 0 || delta < _learnedPeriodNs))
+				_learnedPeriodNs = delta;
+
+			uint64_t period = periodNs();
+
+			// Allow half a period of jitter before calling it a gap.
+			if (period != 0 && delta > period + period / 2)
+			{
+				_stats.timeStartupGaps++;
+				_stats.missingPackets += (delta + period / 2) / period - 1;
+				gapFound = true;
+			}
+		}
+	}
+
+	_lastTimeStartup = timeStartup;
+	_haveTimeStartup = true;
+
+	return gapFound;
+}
+
+void GapDetector::checkSyncInCnt(uint32_t syncInCnt)
+{
+	// Sensor resets are told from TimeStartup; a SyncIn counter going
+	// backwards is only restarted from.
+	if (_haveSyncInCnt && syncInCnt > _lastSyncInCnt && syncInCnt - _lastSyncInCnt > 1)
+	{
+		_stats.syncInCntGaps++;
+		_stats.missingSyncInCnts += syncInCnt - _lastSyncInCnt - 1;
+	}
+
+	_lastSyncInCnt = syncInCnt;
+	_haveSyncInCnt = true;
+}
+
+GapDetector::Statistics GapDetector::statistics() const
+{
+	return _stats;
+}
+
+uint64_t GapDetector::periodNs() const
+{
+	return _expectedPeriodNs != 0 ? _expectedPeriodNs : _learnedPeriodNs;
+}
+
+void GapDetector::reset()
+{
+	_learnedPeriodNs = 0;
+	_haveTimeStartup = false;
+	_haveSyncInCnt = false;
+	_lastTimeStartup = 0;
+	_lastSyncInCnt = 0;
+	_stats = Statistics();
+}
+
+}
+}
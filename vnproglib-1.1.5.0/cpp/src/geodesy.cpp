@@ -0,0 +1,188 @@
+#include "vn/geodesy.h"
+#include "vn/consts.h"
+
+#include <cmath>
+
+using namespace std;
+
+namespace vn {
+namespace math {
+
+namespace
+{
+	const double Deg2Rad = PId / 180.0;
+	const double Rad2Deg = 180.0 / PId;
+
+	// Terms of Olson's ECEF to LLA conversion that depend only on the
+	// ellipsoid.
+	const double OlsonA1 = WGS84_A * WGS84_E2;
+	const double OlsonA2 = OlsonA1 * OlsonA1;
+	const double OlsonA3 = OlsonA1 * WGS84_E2 / 2.0;
+	const double OlsonA4 = 2.5 * OlsonA2;
+	const double OlsonA5 = OlsonA1 + OlsonA3;
+	const double OlsonA6 = 1.0 - WGS84_E2;
+}
+
+vec3d lla2ecef(vec3d lla)
+{
+	double lat = lla.x * Deg2Rad;
+	double lon = lla.y * Deg2Rad;
+	double sinLat = sin(lat);
+	double cosLat = cos(lat);
+
+	// Prime vertical radius of curvature.
+	double n = WGS84_A / sqrt(1.0 - WGS84_E2 * sinLat * sinLat);
+	double nh = (n + lla.z) * cosLat;
+
+	return vec3d(
+		nh * cos(lon),
+		nh * sin(lon),
+		(n * (1.0 - WGS84_E2) + lla.z) * sinLat);
+}
+
+// Olson, D. K. "Converting Earth-Centered, Earth-Fixed Coordinates to
+// Geodetic Coordinates", IEEE Transactions on Aerospace and Electronic
+// Systems 32(1), 1996. Finds the latitude of the geocentric direction,
+// corrected for the ellipsoid, then applies one Newton step.
+vec3d ecef2lla(vec3d ecef)
+{
+	double x = ecef.x;
+	double y = ecef.y;
+	double z = ecef.z;
+	double zp = fabs(z);
+	double w2 = x * x + y * y;
+	double w = sqrt(w2);
+	double r2 = w2 + z * z;
+	double r = sqrt(r2);
+
+	if (r == 0)
+		return vec3d(0, 0, -WGS84_B);
+
+	double lon = atan2(y, x);
+	double s2 = z * z / r2;
+	double c2 = w2 / r2;
+	double u = OlsonA2 / r;
+	double v = OlsonA3 - OlsonA4 / r;
+	double s, c, ss, lat;
+
+	// Work from whichever of the sine and cosine is better conditioned.
+	if (c2 > 0.3)
+	{
+		s = (zp / r) * (1.0 + c2 * (OlsonA1 + u + s2 * v) / r);
+		lat = asin(s);
+		ss = s * s;
+		c = sqrt(1.0 - ss);
+	}
+	else
+	{
+		c = (w / r) * (1.0 - s2 * (OlsonA5 - u - c2 * v) / r);
+		lat = acos(c);
+		ss = 1.0 - c * c;
+		s = sqrt(ss);
+	}
+
+	double g = 1.0 - WGS84_E2 * ss;
+	double rg = WGS84_A / sqrt(g);
+	double rf = OlsonA6 * rg;
+	u = w - rg * c;
+	v = zp - rf * s;
+	double f = c * u + s * v;
+	double m = c * v - s * u;
+	double p = m / (rf / g + f);
+
+	lat += p;
+
+	if (z < 0)
+		lat = -lat;
+
+	return vec3d(lat * Rad2Deg, lon * Rad2Deg, f + m * p / 2.0);
+}
+
+void lla2ecef(const vec3d* lla, vec3d* ecef, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		ecef[i] = lla2ecef(lla[i]);
+}
+
+void ecef2lla(const vec3d* ecef, vec3d* lla, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		lla[i] = ecef2lla(ecef[i]);
+}
+
+LocalTangentPlane::LocalTangentPlane()
+{
+	init(vec3d::zero());
+}
+
+LocalTangentPlane::LocalTangentPlane(vec3d referenceLla)
+{
+	init(referenceLla);
+}
+
+void LocalTangentPlane::init(vec3d referenceLla)
+{
+	double lat = referenceLla.x * Deg2Rad;
+	double lon = referenceLla.y * Deg2Rad;
+	double sinLat = sin(lat);
+	double cosLat = cos(lat);
+	double sinLon = sin(lon);
+	double cosLon = cos(lon);
+
+	_referenceLla = referenceLla;
+	_referenceEcef = lla2ecef(referenceLla);
+	_ecef2ned = mat3d(
+		-sinLat * cosLon, -sinLat * sinLon, cosLat,
+		-sinLon, cosLon, 0.0,
+		-cosLat * cosLon, -cosLat * sinLon, -sinLat);
+}
+
+vec3d LocalTangentPlane::referenceLla() const
+{
+	return _referenceLla;
+}
+
+vec3d LocalTangentPlane::referenceEcef() const
+{
+	return _referenceEcef;
+}
+
+mat3d LocalTangentPlane::ecef2nedDcm() const
+{
+	return _ecef2ned;
+}
+
+vec3d LocalTangentPlane::ecef2ned(vec3d ecef) const
+{
+	return _ecef2ned.multDifference(ecef, _referenceEcef);
+}
+
+vec3d LocalTangentPlane::ned2ecef(vec3d ned) const
+{
+	return _ecef2ned.transposeMult(ned) + _referenceEcef;
+}
+
+vec3d LocalTangentPlane::lla2ned(vec3d lla) const
+{
+	return ecef2ned(lla2ecef(lla));
+}
+
+vec3d LocalTangentPlane::ned2lla(vec3d ned) const
+{
+	return ecef2lla(ned2ecef(ned));
+}
+
+void LocalTangentPlane::lla2ned(const vec3d* lla, vec3d* ned, size_t count) const
+{
+	for (size_t i = 0; i < count; i++)
+		ned[i] = ecef2ned(lla2ecef(lla[i]));
+}
+
+void LocalTangentPlane::ned2lla(const vec3d* ned, vec3d* lla, size_t count) const
+{
+	for (size_t i = 0; i < count; i++)
+		lla[i] = ecef2lla(ned2ecef(ned[i]));
+}
+
+}
+}
@@ -1,8 +1,15 @@
 #include "vn/memoryport.h"
 #include "vn/criticalsection.h"
+#include "vn/event.h"
 #include "vn/exceptions.h"
+#include "vn/thread.h"
+#include "vn/vntime.h"
 
+#include <atomic>
+#include <deque>
 #include <list>
+#include <stdexcept>
+#include <vector>
 
 using namespace std;
 using namespace vn::xplat;
@@ -12,6 +19,21 @@ namespace util {
 
 struct MemoryPort::Impl
 {
+	static const size_t DefaultBufferSize = 64 * 1024;
+
+	// Maximum time the delivery thread sleeps while pacing data before
+	// checking if it should stop, and between checks in waitUntilDrained,
+	// since reading the data does not signal DrainedEvent.
+	static const uint32_t MaxDeliveryWaitUs = 10000;
+
+	// A chunk of fed data waiting for the delivery thread.
+	struct Chunk
+	{
+		vector<char> Data;
+		bool HasTimestamp;
+		uint64_t TimestampNs;
+	};
+
 	// Indiates if the serial port is open.
 	bool IsOpen;
 
@@ -24,34 +46,247 @@ struct MemoryPort::Impl
 	DataWrittenHandler _dataWrittenHandler;
 	void* _dataWrittenUserData;
 
-	const uint8_t* DataAvailableForRead;
-
-	size_t DataAvailableForReadLength;
+	// Ring buffer of data available for reading. Guarded by DataCS.
+	CriticalSection DataCS;
+	vector<uint8_t> Ring;
+	size_t RingHead;
+	size_t RingCount;
+	size_t NumOfBytesDropped;
+
+	// Chunks waiting for delivery. Guarded by DataCS.
+	deque<Chunk> Pending;
+	bool Delivering;
+
+	Pacing PacingMode;
+	double Speed;
+	Thread *pDeliveryThread;
+	atomic<bool> ContinueDelivering;
+	Event NewChunkEvent;
+	Event DrainedEvent;
+
+	// Maps the first timestamped chunk onto the monotonic clock.
+	bool HaveTimeOrigin;
+	uint64_t FirstTimestampNs;
+	int64_t StartNs;
 
 	MemoryPort *BackReference;
 
-	explicit Impl(MemoryPort* backReference) :
+	Impl(MemoryPort* backReference, size_t bufferSize) :
 		IsOpen(false),
 		_dataReceivedHandler(NULL),
 		_dataReceivedUserData(NULL),
 		_dataWrittenHandler(NULL),
 		_dataWrittenUserData(NULL),
-		DataAvailableForRead(NULL),
-		DataAvailableForReadLength(0),
+		Ring(bufferSize),
+		RingHead(0),
+		RingCount(0),
+		NumOfBytesDropped(0),
+		Delivering(false),
+		PacingMode(PACING_IMMEDIATE),
+		Speed(1.0),
+		pDeliveryThread(NULL),
+		ContinueDelivering(false),
+		HaveTimeOrigin(false),
+		FirstTimestampNs(0),
+		StartNs(0),
 		BackReference(backReference)
 	{ }
 
-	void OnDataReceived()
+	// Appends data to the ring, dropping what does not fit.
+	void Append(const char* data, size_t length)
 	{
-		if (_dataReceivedHandler == NULL)
-			return;
+		DataCS.enter();
+
+		size_t space = Ring.size() - RingCount;
+		if (length > space)
+		{
+			NumOfBytesDropped += length - space;
+			length = space;
+		}
+
+		size_t tail = (RingHead + RingCount) % Ring.size();
+		for (size_t i = 0; i < length; i++)
+		{
+			Ring[tail] = static_cast<uint8_t>(data[i]);
+			if (++tail == Ring.size())
+				tail = 0;
+		}
+		RingCount += length;
+
+		DataCS.leave();
+	}
+
+	size_t Take(char* buffer, size_t length)
+	{
+		DataCS.enter();
+
+		if (length > RingCount)
+			length = RingCount;
+
+		// Copy in at most two contiguous pieces.
+		size_t first = Ring.size() - RingHead;
+		if (first > length)
+			first = length;
+
+		copy(Ring.begin() + RingHead, Ring.begin() + RingHead + first, buffer);
+		copy(Ring.begin(), Ring.begin() + (length - first), buffer + first);
+
+		RingHead = (RingHead + length) % Ring.size();
+		RingCount -= length;
 
+		DataCS.leave();
+
+		return length;
+	}
+
+	size_t Available()
+	{
+		DataCS.enter();
+		size_t count = RingCount;
+		DataCS.leave();
+
+		return count;
+	}
+
+	void OnDataReceived()
+	{
 		ObserversCriticalSection.enter();
 
-		_dataReceivedHandler(_dataReceivedUserData);
+		// Like a serial port, keep notifying while data remains and the
+		// handler is making progress.
+		size_t available = Available();
+		while (_dataReceivedHandler != NULL && available != 0)
+		{
+			_dataReceivedHandler(_dataReceivedUserData);
+
+			size_t remaining = Available();
+			if (remaining >= available)
+				break;
+
+			available = remaining;
+		}
 
 		ObserversCriticalSection.leave();
 	}
+
+	static void DeliveryThread(void* data)
+	{
+		static_cast<Impl*>(data)->DeliveryThread();
+	}
+
+	void DeliveryThread()
+	{
+		while (ContinueDelivering)
+		{
+			DataCS.enter();
+
+			if (Pending.empty())
+			{
+				DataCS.leave();
+				DrainedEvent.signal();
+
+				// Feed and StopDeliveryThread signal after changing what
+				// we check, and the event remembers it, so no wake-up is
+				// missed.
+				NewChunkEvent.wait();
+				continue;
+			}
+
+			Chunk c = Pending.front();
+			Pending.pop_front();
+			Delivering = true;
+
+			DataCS.leave();
+
+			if (PacingMode == PACING_REALTIME && c.HasTimestamp)
+				WaitForTimestamp(c.TimestampNs);
+
+			if (!ContinueDelivering)
+				break;
+
+			Append(&c.Data[0], c.Data.size());
+			OnDataReceived();
+
+			DataCS.enter();
+			Delivering = false;
+			DataCS.leave();
+		}
+
+		Delivering = false;
+	}
+
+	void WaitForTimestamp(uint64_t timestampNs)
+	{
+		if (!HaveTimeOrigin)
+		{
+			HaveTimeOrigin = true;
+			FirstTimestampNs = timestampNs;
+			StartNs = TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC).totalNs();
+
+			return;
+		}
+
+		if (timestampNs <= FirstTimestampNs)
+			return;
+
+		int64_t dueNs = StartNs + static_cast<int64_t>((timestampNs - FirstTimestampNs) / Speed);
+
+		while (ContinueDelivering)
+		{
+			int64_t remainingNs = dueNs - TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC).totalNs();
+
+			if (remainingNs <= 0)
+				return;
+
+			uint32_t sleepUs = remainingNs / 1000 > MaxDeliveryWaitUs ? MaxDeliveryWaitUs : static_cast<uint32_t>(remainingNs / 1000);
+			Thread::sleepUs(sleepUs == 0 ? 1 : sleepUs);
+		}
+	}
+
+	void StartDeliveryThread()
+	{
+		HaveTimeOrigin = false;
+		ContinueDelivering = true;
+		pDeliveryThread = Thread::startNew(DeliveryThread, this);
+	}
+
+	void StopDeliveryThread()
+	{
+		if (pDeliveryThread == NULL)
+			return;
+
+		ContinueDelivering = false;
+		NewChunkEvent.signal();
+		pDeliveryThread->join();
+
+		delete pDeliveryThread;
+		pDeliveryThread = NULL;
+	}
+
+	void Feed(const char data[], size_t length, bool hasTimestamp, uint64_t timestampNs)
+	{
+		if (length == 0)
+			return;
+
+		if (PacingMode == PACING_IMMEDIATE)
+		{
+			Append(data, length);
+			OnDataReceived();
+
+			return;
+		}
+
+		Chunk c;
+		c.Data.assign(data, data + length);
+		c.HasTimestamp = hasTimestamp;
+		c.TimestampNs = timestampNs;
+
+		DataCS.enter();
+		Pending.push_back(c);
+		DataCS.leave();
+
+		NewChunkEvent.signal();
+	}
 };
 
 #if defined(_MSC_VER)
@@ -60,16 +295,28 @@ struct MemoryPort::Impl
 #endif
 
 MemoryPort::MemoryPort() :
-	_pi(new Impl(this))
+	_pi(new Impl(this, Impl::DefaultBufferSize))
 {
 }
 
+MemoryPort::MemoryPort(size_t bufferSize) :
+	_pi(new Impl(this, bufferSize))
+{
+	if (bufferSize == 0)
+	{
+		delete _pi;
+		throw invalid_argument("bufferSize");
+	}
+}
+
 #if defined (_MSC_VER)
 	#pragma warning(pop)
 #endif
 
 MemoryPort::~MemoryPort()
 {
+	_pi->StopDeliveryThread();
+
 	delete _pi;
 }
 
@@ -79,6 +326,9 @@ void MemoryPort::open()
 		throw invalid_operation();
 
 	_pi->IsOpen = true;
+
+	if (_pi->PacingMode != PACING_IMMEDIATE)
+		_pi->StartDeliveryThread();
 }
 
 void MemoryPort::close()
@@ -86,6 +336,8 @@ void MemoryPort::close()
 	if (!_pi->IsOpen)
 		throw invalid_operation();
 
+	_pi->StopDeliveryThread();
+
 	_pi->IsOpen = false;
 }
 
@@ -108,13 +360,7 @@ void MemoryPort::read(char dataBuffer[], size_t numOfBytesToRead, size_t &numOfB
 	if (!_pi->IsOpen)
 		throw invalid_operation();
 
-	if (numOfBytesToRead < _pi->DataAvailableForReadLength)
-		// Don't support less than full read for now.
-		throw not_implemented();
-
-	copy(_pi->DataAvailableForRead, _pi->DataAvailableForRead + _pi->DataAvailableForReadLength, dataBuffer);
-
-	numOfBytesActuallyRead = _pi->DataAvailableForReadLength;
+	numOfBytesActuallyRead = _pi->Take(dataBuffer, numOfBytesToRead);
 }
 
 void MemoryPort::registerDataReceivedHandler(void* userData, DataReceivedHandler handler)
@@ -161,10 +407,70 @@ void MemoryPort::unregisterDataWrittenHandler()
 	_pi->_dataWrittenUserData = NULL;
 }
 
+void MemoryPort::setPacing(Pacing pacing, double speed)
+{
+	if (_pi->IsOpen)
+		throw invalid_operation();
+
+	if (speed <= 0)
+		throw invalid_argument("speed");
+
+	_pi->PacingMode = pacing;
+	_pi->Speed = speed;
+}
+
+MemoryPort::Pacing MemoryPort::pacing()
+{
+	return _pi->PacingMode;
+}
+
+void MemoryPort::feed(const char data[], size_t length)
+{
+	_pi->Feed(data, length, false, 0);
+}
+
+void MemoryPort::feed(const char data[], size_t length, uint64_t timestampNs)
+{
+	_pi->Feed(data, length, true, timestampNs);
+}
+
+bool MemoryPort::waitUntilDrained(uint32_t timeoutMs)
+{
+	Stopwatch sw;
+
+	while (true)
+	{
+		_pi->DataCS.enter();
+		bool drained = _pi->Pending.empty() && !_pi->Delivering && _pi->RingCount == 0;
+		_pi->DataCS.leave();
+
+		if (drained)
+			return true;
+
+		if (sw.elapsedMs() >= timeoutMs)
+			return false;
+
+		_pi->DrainedEvent.waitUs(Impl::MaxDeliveryWaitUs);
+	}
+}
+
+size_t MemoryPort::bytesAvailable()
+{
+	return _pi->Available();
+}
+
+size_t MemoryPort::numOfBytesDropped()
+{
+	_pi->DataCS.enter();
+	size_t dropped = _pi->NumOfBytesDropped;
+	_pi->DataCS.leave();
+
+	return dropped;
+}
+
 void MemoryPort::SendDataBackDoor(const uint8_t data[], size_t length)
 {
-	_pi->DataAvailableForRead = data;
-	_pi->DataAvailableForReadLength = length;
+	_pi->Append(reinterpret_cast<const char*>(data), length);
 
 	_pi->OnDataReceived();
 }
@@ -120,6 +120,16 @@ string Packet::datastr()
 	return string(_data, _length);
 }
 
+const char* Packet::data() const
+{
+	return _data;
+}
+
+size_t Packet::length() const
+{
+	return _length;
+}
+
 Packet::Type Packet::type()
 {
 	if (_length < 1)
@@ -874,6 +884,17 @@ size_t Packet::genKnownAccelerationDisturbance(ErrorDetectionMode errorDetection
 	return finalizeCommand(errorDetectionMode, buffer, length);
 }
 
+size_t Packet::genAsyncOutputEnable(ErrorDetectionMode errorDetectionMode, char *buffer, size_t size, bool enable)
+{
+	#if VN_HAVE_SECURE_CRT
+	size_t length = sprintf_s(buffer, size, "$VNASY,%d", enable ? 1 : 0);
+	#else
+	size_t length = sprintf(buffer, "$VNASY,%d", enable ? 1 : 0);
+	#endif
+
+	return finalizeCommand(errorDetectionMode, buffer, length);
+}
+
 size_t Packet::genSetGyroBias(ErrorDetectionMode errorDetectionMode, char *buffer, size_t size)
 {
 	#if VN_HAVE_SECURE_CRT
@@ -2979,40 +3000,40 @@ void Packet::parseBinaryOutput(
 
 	*asyncMode = ATOU16; NEXT
 	*rateDivisor = ATOU16; NEXT
-	*outputGroup = ATOU16;
+	*outputGroup = ATOU16X;
 	if (*outputGroup & 0x0001)
 	{
 		NEXT
-		*commonField = ATOU16;
+		*commonField = ATOU16X;
 	}
 	if (*outputGroup & 0x0002)
 	{
 		NEXT
-		*timeField = ATOU16;
+		*timeField = ATOU16X;
 	}
 	if (*outputGroup & 0x0004)
 	{
 		NEXT
-		*imuField = ATOU16;
+		*imuField = ATOU16X;
 	}
 	if (*outputGroup & 0x0008)
 	{
 		NEXT
-		*gpsField = ATOU16;
+		*gpsField = ATOU16X;
 	}
 	if (*outputGroup & 0x0010)
 	{
 		NEXT
-		*attitudeField = ATOU16;
+		*attitudeField = ATOU16X;
 	}
 	if (*outputGroup & 0x0020)
 	{
 		NEXT
-		*insField = ATOU16;
+		*insField = ATOU16X;
 	}
   if(*outputGroup & 0x0040) {
     NEXT
-      *gps2Field = ATOU16;
+      *gps2Field = ATOU16X;
   }
 }
 
@@ -138,7 +138,17 @@ struct PacketFinder::Impl
 		_bufferAppendLocation = 0;
 	}
 
-	void dataReceived(uint8_t data[], size_t length, TimeStamp timestamp)
+	// Returns the time the byte at the provided index arrived, given the time
+	// of the last byte in the buffer.
+	static TimeStamp timeOfByte(TimeStamp timestampOfLastByte, size_t index, size_t length, uint32_t byteTimeNs)
+	{
+		if (byteTimeNs == 0)
+			return timestampOfLastByte;
+
+		return timestampOfLastByte.addNs(-static_cast<int64_t>(length - 1 - index) * byteTimeNs);
+	}
+
+	void dataReceived(uint8_t data[], size_t length, TimeStamp timestamp, uint32_t byteTimeNs)
 	{
 		bool asciiStartFoundInProvidedBuffer = false;
 
@@ -152,7 +162,7 @@ struct PacketFinder::Impl
 				_asciiOnDeck.currentlyBuildingAsciiPacket = true;
 				_asciiOnDeck.possibleStartOfPacketIndex = i;
 				_asciiOnDeck.runningDataIndexOfStart = _runningDataIndex;
-				_asciiOnDeck.timeFound = timestamp;
+				_asciiOnDeck.timeFound = timeOfByte(timestamp, i, length, byteTimeNs);
 
 				asciiStartFoundInProvidedBuffer = true;
 			}
@@ -373,7 +383,7 @@ struct PacketFinder::Impl
 			if (data[i] == BinaryStartChar)
 			{
 				// Possible start of a binary packet.
-				_binaryOnDeck.push_back(BinaryTracker(i, _runningDataIndex, timestamp));
+				_binaryOnDeck.push_back(BinaryTracker(i, _runningDataIndex, timeOfByte(timestamp, i, length, byteTimeNs)));
 			}
 		}
 
@@ -484,7 +494,12 @@ void PacketFinder::processReceivedData(char data[], size_t length)
 
 void PacketFinder::processReceivedData(char data[], size_t length, TimeStamp timestamp)
 {
-	_pi->dataReceived(reinterpret_cast<uint8_t*>(data), length, timestamp);
+	_pi->dataReceived(reinterpret_cast<uint8_t*>(data), length, timestamp, 0);
+}
+
+void PacketFinder::processReceivedData(char data[], size_t length, TimeStamp timestampOfLastByte, uint32_t byteTimeNs)
+{
+	_pi->dataReceived(reinterpret_cast<uint8_t*>(data), length, timestampOfLastByte, byteTimeNs);
 }
 
 #if PYTHON
@@ -0,0 +1,373 @@
+#include "vn/samplebuffer.h"
+
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace vn::math;
+
+namespace vn {
+namespace sensors {
+
+namespace
+{
+	// Below this angle between the quaternions slerp is replaced by a
+	// normalized lerp, which is indistinguishable and avoids dividing by a
+	// vanishing sine.
+	const double SlerpMinAngleRad = 1e-4;
+
+	// Integration times and sample spacing jitter slightly, so a sample's
+	// interval may start a little after the previous sample without there
+	// being a gap.
+	const double GapToleranceFraction = 0.25;
+
+	template<size_t tdim, typename T>
+	vec<tdim, T> lerp(const vec<tdim, T>& a, const vec<tdim, T>& b, double f)
+	{
+		vec<tdim, T> r;
+
+		for (size_t i = 0; i < tdim; i++)
+			r[i] = static_cast<T>(a[i] + (b[i] - a[i]) * f);
+
+		return r;
+	}
+
+	vec4f slerp(const vec4f& a, const vec4f& b, double f)
+	{
+		double dot = static_cast<double>(a.x) * b.x + static_cast<double>(a.y) * b.y + static_cast<double>(a.z) * b.z + static_cast<double>(a.w) * b.w;
+
+		// q and -q are the same rotation; take the shorter way round.
+		double sign = 1.0;
+		if (dot < 0)
+		{
+			dot = -dot;
+			sign = -1.0;
+		}
+
+		double wa, wb;
+		double angle = acos(dot > 1.0 ? 1.0 : dot);
+
+		if (angle < SlerpMinAngleRad)
+		{
+			wa = 1.0 - f;
+			wb = f;
+		}
+		else
+		{
+			double s = sin(angle);
+
+			wa = sin((1.0 - f) * angle) / s;
+			wb = sin(f * angle) / s;
+		}
+
+		wb *= sign;
+
+		double x = wa * a.x + wb * b.x;
+		double y = wa * a.y + wb * b.y;
+		double z = wa * a.z + wb * b.z;
+		double w = wa * a.w + wb * b.w;
+		double m = sqrt(x * x + y * y + z * z + w * w);
+
+		return vec4f(static_cast<float>(x / m), static_cast<float>(y / m), static_cast<float>(z / m), static_cast<float>(w / m));
+	}
+}
+
+SampleBuffer::Sample::Sample() :
+	timeNs(0),
+	hasQuaternion(false),
+	hasAngularRate(false),
+	hasAcceleration(false),
+	hasMagnetic(false),
+	hasVelocityEstimatedNed(false),
+	hasPositionEstimatedLla(false),
+	hasDeltaTheta(false),
+	hasDeltaVelocity(false),
+	quaternion(vec4f::zero()),
+	angularRate(vec3f::zero()),
+	acceleration(vec3f::zero()),
+	magnetic(vec3f::zero()),
+	velocityEstimatedNed(vec3f::zero()),
+	positionEstimatedLla(vec3d::zero()),
+	deltaTheta(vec3f::zero()),
+	deltaVelocity(vec3f::zero()),
+	deltaTime(0)
+{ }
+
+SampleBuffer::SampleBuffer(size_t capacity) :
+	_start(0),
+	_count(0)
+{
+	if (capacity == 0)
+		throw invalid_argument("capacity");
+
+	_times.resize(capacity);
+	_samples.resize(capacity);
+}
+
+bool SampleBuffer::add(CompositeData& cd)
+{
+	if (!cd.hasTimeStartup())
+		return false;
+
+	add(cd, static_cast<int64_t>(cd.timeStartup()));
+
+	return true;
+}
+
+void SampleBuffer::add(CompositeData& cd, int64_t timeNs)
+{
+	Sample s;
+
+	s.timeNs = timeNs;
+
+	if ((s.hasQuaternion = cd.hasQuaternion()))
+		s.quaternion = cd.quaternion();
+
+	if ((s.hasAngularRate = cd.hasAngularRate()))
+		s.angularRate = cd.angularRate();
+
+	if ((s.hasAcceleration = cd.hasAcceleration()))
+		s.acceleration = cd.acceleration();
+
+	if ((s.hasMagnetic = cd.hasMagnetic()))
+		s.magnetic = cd.magnetic();
+
+	if ((s.hasVelocityEstimatedNed = cd.hasVelocityEstimatedNed()))
+		s.velocityEstimatedNed = cd.velocityEstimatedNed();
+
+	if ((s.hasPositionEstimatedLla = cd.hasPositionEstimatedLla()))
+		s.positionEstimatedLla = cd.positionEstimatedLla();
+
+	if ((s.hasDeltaTheta = cd.hasDeltaTheta()))
+		s.deltaTheta = cd.deltaTheta();
+
+	if ((s.hasDeltaVelocity = cd.hasDeltaVelocity()))
+		s.deltaVelocity = cd.deltaVelocity();
+
+	if (cd.hasDeltaTime())
+		s.deltaTime = cd.deltaTime();
+
+	add(s);
+}
+
+void SampleBuffer::add(const Sample& sample)
+{
+	_cs.enter();
+
+	if (_count > 0 && sample.timeNs <= _times[slot(_count - 1)])
+	{
+		_start = 0;
+		_count = 0;
+	}
+
+	if (_count == _samples.size())
+	{
+		_start = (_start + 1) % _samples.size();
+		_count--;
+	}
+
+	size_t i = slot(_count);
+
+	_times[i] = sample.timeNs;
+	_samples[i] = sample;
+	_count++;
+
+	_cs.leave();
+}
+
+size_t SampleBuffer::size()
+{
+	_cs.enter();
+	size_t count = _count;
+	_cs.leave();
+
+	return count;
+}
+
+size_t SampleBuffer::capacity()
+{
+	return _samples.size();
+}
+
+void SampleBuffer::clear()
+{
+	_cs.enter();
+	_start = 0;
+	_count = 0;
+	_cs.leave();
+}
+
+bool SampleBuffer::timeSpan(int64_t& oldestNs, int64_t& newestNs)
+{
+	_cs.enter();
+
+	if (_count == 0)
+	{
+		_cs.leave();
+		return false;
+	}
+
+	oldestNs = _times[slot(0)];
+	newestNs = _times[slot(_count - 1)];
+
+	_cs.leave();
+
+	return true;
+}
+
+size_t SampleBuffer::lowerBound(int64_t timeNs) const
+{
+	size_t lo = 0;
+	size_t hi = _count;
+
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (_times[slot(mid)] < timeNs)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+int64_t SampleBuffer::intervalStartNs(size_t i) const
+{
+	const Sample& s = _samples[slot(i)];
+
+	if (s.deltaTime > 0)
+		return s.timeNs - static_cast<int64_t>(s.deltaTime * 1e9 + 0.5);
+
+	// Without an integration time the deltas are assumed to span the time
+	// since the previous sample.
+	if (i > 0)
+		return _times[slot(i - 1)];
+
+	return s.timeNs;
+}
+
+bool SampleBuffer::sampleAt(int64_t timeNs, Sample& sample)
+{
+	_cs.enter();
+
+	size_t i = lowerBound(timeNs);
+
+	if (i == _count || (i == 0 && _times[slot(0)] != timeNs))
+	{
+		_cs.leave();
+		return false;
+	}
+
+	const Sample& b = _samples[slot(i)];
+
+	if (b.timeNs == timeNs)
+	{
+		sample = b;
+
+		_cs.leave();
+		return true;
+	}
+
+	const Sample& a = _samples[slot(i - 1)];
+	double f = static_cast<double>(timeNs - a.timeNs) / static_cast<double>(b.timeNs - a.timeNs);
+
+	Sample r;
+
+	r.timeNs = timeNs;
+
+	if ((r.hasQuaternion = a.hasQuaternion && b.hasQuaternion))
+		r.quaternion = slerp(a.quaternion, b.quaternion, f);
+
+	if ((r.hasAngularRate = a.hasAngularRate && b.hasAngularRate))
+		r.angularRate = lerp(a.angularRate, b.angularRate, f);
+
+	if ((r.hasAcceleration = a.hasAcceleration && b.hasAcceleration))
+		r.acceleration = lerp(a.acceleration, b.acceleration, f);
+
+	if ((r.hasMagnetic = a.hasMagnetic && b.hasMagnetic))
+		r.magnetic = lerp(a.magnetic, b.magnetic, f);
+
+	if ((r.hasVelocityEstimatedNed = a.hasVelocityEstimatedNed && b.hasVelocityEstimatedNed))
+		r.velocityEstimatedNed = lerp(a.velocityEstimatedNed, b.velocityEstimatedNed, f);
+
+	if ((r.hasPositionEstimatedLla = a.hasPositionEstimatedLla && b.hasPositionEstimatedLla))
+		r.positionEstimatedLla = lerp(a.positionEstimatedLla, b.positionEstimatedLla, f);
+
+	r.hasDeltaTheta = b.hasDeltaTheta;
+	r.deltaTheta = b.deltaTheta;
+	r.hasDeltaVelocity = b.hasDeltaVelocity;
+	r.deltaVelocity = b.deltaVelocity;
+	r.deltaTime = b.deltaTime;
+
+	_cs.leave();
+
+	sample = r;
+
+	return true;
+}
+
+bool SampleBuffer::integrate(int64_t startNs, int64_t endNs, vec3f& deltaTheta, vec3f& deltaVelocity)
+{
+	if (endNs < startNs)
+		return false;
+
+	_cs.enter();
+
+	if (_count == 0 || endNs > _times[slot(_count - 1)] || startNs < intervalStartNs(0))
+	{
+		_cs.leave();
+		return false;
+	}
+
+	// The first sample whose interval can overlap the span ends after it
+	// starts.
+	size_t i = lowerBound(startNs);
+
+	if (i < _count && _times[slot(i)] == startNs)
+		i++;
+
+	vec3f dTheta = vec3f::zero();
+	vec3f dVelocity = vec3f::zero();
+	int64_t coveredUntilNs = startNs;
+
+	for (; i < _count; i++)
+	{
+		const Sample& s = _samples[slot(i)];
+		int64_t from = intervalStartNs(i);
+
+		if (from >= endNs)
+			break;
+
+		if (!s.hasDeltaTheta || !s.hasDeltaVelocity || s.timeNs <= from
+			|| from - coveredUntilNs > GapToleranceFraction * (s.timeNs - from))
+		{
+			// Missing deltas or a gap between samples.
+			_cs.leave();
+			return false;
+		}
+
+		int64_t overlapStart = from > startNs ? from : startNs;
+		int64_t overlapEnd = s.timeNs < endNs ? s.timeNs : endNs;
+		double f = static_cast<double>(overlapEnd - overlapStart) / static_cast<double>(s.timeNs - from);
+
+		dTheta += s.deltaTheta * static_cast<float>(f);
+		dVelocity += s.deltaVelocity * static_cast<float>(f);
+
+		coveredUntilNs = s.timeNs;
+	}
+
+	_cs.leave();
+
+	if (coveredUntilNs < endNs && startNs != endNs)
+		return false;
+
+	deltaTheta = dTheta;
+	deltaVelocity = dVelocity;
+
+	return true;
+}
+
+}
+}
@@ -2,9 +2,21 @@
 #include "vn/serialport.h"
 #include "vn/event.h"
 #include "vn/thread.h"
+#include "vn/threadpool.h"
 #include "vn/packetfinder.h"
+#include "vn/vntime.h"
 
 #include <list>
+#include <algorithm>
+#include <cstring>
+
+#if __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#include <fcntl.h>
+	#include <errno.h>
+	#include <termios.h>
+	#include <unistd.h>
+	#include <poll.h>
+#endif
 
 using namespace std;
 using namespace vn::xplat;
@@ -27,10 +39,9 @@ struct TestHelper
 
 struct SearchHelper
 {
-	Event finishedSearchingPort;
 	bool sensorFound;
 	string portName;
-	int32_t foundBaudrate;
+	uint32_t foundBaudrate;
 
 	explicit SearchHelper(const string &portName) :
 		sensorFound(false),
@@ -78,30 +89,41 @@ vector<pair<string, uint32_t> > Searcher::search()
 }
 
 vector<pair<string, uint32_t> > Searcher::search(vector<string>& portsToCheck)
+{
+	return search(const_cast<const vector<string>&>(portsToCheck), DefaultSearchTimeoutMs);
+}
+
+#if _WIN32
+
+vector<pair<string, uint32_t> > Searcher::search(const vector<string>& portsToCheck, uint32_t timeoutMs, SensorFoundHandler handler, void* userData)
 {
 	list<SearchHelper*> helpers;
 	vector<pair<string, uint32_t> > result;
+	ThreadPool::Batch batch;
 
-	// Start threads to test each port.
+	// Test the ports on the shared pool rather than starting a thread for
+	// each of them.
 	for (vector<string>::const_iterator it = portsToCheck.begin(); it != portsToCheck.end(); ++it)
 	{
 		SearchHelper *sh = new SearchHelper(*it);
 
 		helpers.push_back(sh);
 
-		Thread::startNew(searchThread, sh);
+		ThreadPool::shared().submit(searchThread, sh, &batch);
 	}
 
-	// Wait for each thread to finish.
+	ThreadPool::shared().wait(batch);
+
 	for (list<SearchHelper*>::const_iterator it = helpers.begin(); it != helpers.end(); ++it)
 	{
 		SearchHelper* sh = (*it);
 
-		sh->finishedSearchingPort.wait();
-
 		if (sh->sensorFound)
 		{
 			result.push_back(pair<string, uint32_t>(sh->portName, sh->foundBaudrate));
+
+			if (handler != NULL)
+				handler(userData, sh->portName, sh->foundBaudrate);
 		}
 
 		delete sh;
@@ -110,7 +132,318 @@ vector<pair<string, uint32_t> > Searcher::search(vector<string>& portsToCheck)
 	return result;
 }
 
+#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+
+// Approximate size of a Model Number read and its response.
+const uint32_t ProbeRoundTripBytes = 48;
+
+// Time spent at each baudrate on the first pass over all baudrates. Later
+// passes wait longer.
+const float ProbeWindowMs = 8;
+
+// The state of one port in the search event loop.
+struct PortProbe
+{
+	string portName;
+	int fd;
+	size_t baudrateIndex;
+	size_t pass;
+	bool started;
+	float windowEndMs;
+	bool found;
+	PacketFinder* packetFinder;
+
+	explicit PortProbe(const string &portName) :
+		portName(portName),
+		fd(-1),
+		baudrateIndex(0),
+		pass(0),
+		started(false),
+		windowEndMs(0),
+		found(false),
+		packetFinder(NULL)
+	{ }
+
+	~PortProbe()
+	{
+		delete packetFinder;
+
+		if (fd != -1)
+			::close(fd);
+	}
+};
+
+void probeValidPacketFoundHandler(void *userData, Packet &packet, size_t runningIndexOfPacketStart, TimeStamp timestamp);
+
+bool toBaudrateFlag(uint32_t baudrate, speed_t &flag)
+{
+	switch (baudrate)
+	{
+		case 9600: flag = B9600; return true;
+		case 19200: flag = B19200; return true;
+		case 38400: flag = B38400; return true;
+		case 57600: flag = B57600; return true;
+		case 115200: flag = B115200; return true;
+		#if !defined(__QNXNTO__)
+		case 230400: flag = B230400; return true;
+		#if !defined(__APPLE__)
+		case 460800: flag = B460800; return true;
+		case 921600: flag = B921600; return true;
+		#endif
+		#endif
+		default: return false;
+	}
+}
+
+// Moves the port on to its next baudrate, sends a probe and starts the wait
+// for a reply. Baudrates the platform does not support are skipped.
+bool startNextProbe(PortProbe &probe, const vector<uint32_t> &baudrates, float nowMs)
+{
+	for (size_t attempts = 0; attempts < baudrates.size(); attempts++)
+	{
+		if (probe.started && ++probe.baudrateIndex == baudrates.size())
+		{
+			probe.baudrateIndex = 0;
+			probe.pass++;
+		}
+
+		probe.started = true;
+
+		uint32_t baudrate = baudrates[probe.baudrateIndex];
+		speed_t flag;
+
+		if (!toBaudrateFlag(baudrate, flag))
+			continue;
+
+		termios portSettings;
+		memset(&portSettings, 0, sizeof(termios));
+
+		#if __linux__ || __CYGWIN__ || __QNXNTO__
+		portSettings.c_cflag = flag;
+		#elif __APPLE__
+		cfsetspeed(&portSettings, flag);
+		#endif
+		portSettings.c_cflag |= CS8 | CLOCAL | CREAD;
+		portSettings.c_iflag = IGNPAR;
+		portSettings.c_oflag = 0;
+		portSettings.c_cc[VTIME] = 0;
+		portSettings.c_cc[VMIN] = 0;
+
+		if (tcsetattr(probe.fd, TCSANOW, &portSettings) != 0 || tcflush(probe.fd, TCIOFLUSH) != 0)
+			return false;
+
+		// Anything buffered so far was received at the previous baudrate.
+		delete probe.packetFinder;
+		probe.packetFinder = new PacketFinder();
+		probe.packetFinder->registerPossiblePacketFoundHandler(&probe, probeValidPacketFoundHandler);
+
+		if (::write(probe.fd, "$VNRRG,01*XX\r\n", 14) != 14)
+			return false;
+
+		probe.windowEndMs = nowMs + ProbeWindowMs * (probe.pass + 1) + ProbeRoundTripBytes * 10 * 1000.f / baudrate;
+
+		return true;
+	}
+
+	return false;
+}
+
+vector<pair<string, uint32_t> > Searcher::search(const vector<string>& portsToCheck, uint32_t timeoutMs, SensorFoundHandler handler, void* userData)
+{
+	#if __cplusplus < 201103L
+	vector<uint32_t> TestBaudrates(TestBaudratesRaw, TestBaudratesRaw + sizeof(TestBaudratesRaw) / sizeof(TestBaudratesRaw[0]));
+	#endif
+
+	vector<pair<string, uint32_t> > result;
+	vector<PortProbe*> probes;
+	Stopwatch sw;
+
+	for (vector<string>::const_iterator it = portsToCheck.begin(); it != portsToCheck.end(); ++it)
+	{
+		PortProbe* probe = new PortProbe(*it);
+
+		probe->fd = ::open(it->c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+		if (probe->fd == -1 || !startNextProbe(*probe, TestBaudrates, sw.elapsedMs()))
+		{
+			// Missing, busy or not a serial port.
+			delete probe;
+			continue;
+		}
+
+		probes.push_back(probe);
+	}
+
+	vector<pollfd> fds;
+
+	while (!probes.empty())
+	{
+		float nowMs = sw.elapsedMs();
+
+		if (nowMs >= timeoutMs)
+			break;
+
+		// Wait for data on any port or until the nearest probe window ends.
+		float waitMs = timeoutMs - nowMs;
+
+		fds.resize(probes.size());
+
+		for (size_t i = 0; i < probes.size(); i++)
+		{
+			fds[i].fd = probes[i]->fd;
+			fds[i].events = POLLIN;
+			fds[i].revents = 0;
+
+			if (probes[i]->windowEndMs - nowMs < waitMs)
+				waitMs = probes[i]->windowEndMs - nowMs;
+		}
+
+		int ready = poll(&fds[0], fds.size(), waitMs > 0 ? static_cast<int>(waitMs) + 1 : 0);
+
+		if (ready < 0 && errno != EINTR)
+			break;
+
+		nowMs = sw.elapsedMs();
+
+		for (size_t i = 0; i < probes.size(); )
+		{
+			PortProbe* probe = probes[i];
+			bool drop = false;
+
+			if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+			{
+				drop = true;
+			}
+			else if (fds[i].revents & POLLIN)
+			{
+				char buffer[0x100];
+				ssize_t numOfBytesRead;
+
+				while ((numOfBytesRead = ::read(probe->fd, buffer, sizeof(buffer))) > 0 && !probe->found)
+					probe->packetFinder->processReceivedData(buffer, numOfBytesRead);
+			}
+
+			if (probe->found)
+			{
+				uint32_t baudrate = TestBaudrates[probe->baudrateIndex];
+
+				result.push_back(pair<string, uint32_t>(probe->portName, baudrate));
+
+				if (handler != NULL)
+					handler(userData, probe->portName, baudrate);
+
+				drop = true;
+			}
+			else if (!drop && nowMs >= probe->windowEndMs)
+			{
+				drop = !startNextProbe(*probe, TestBaudrates, nowMs);
+			}
+
+			if (drop)
+			{
+				delete probe;
+				probes.erase(probes.begin() + i);
+				fds.erase(fds.begin() + i);
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < probes.size(); i++)
+		delete probes[i];
+
+	return result;
+}
+
+#if defined(_MSC_VER)
+	#pragma warning(push)
+
+	// Disable warnings about unused parameters.
+	#pragma warning(disable:4100)
+#endif
+
+void probeValidPacketFoundHandler(void *userData, Packet &packet, size_t runningIndexOfPacketStart, TimeStamp timestamp)
+{
+	static_cast<PortProbe*>(userData)->found = true;
+}
+
+#if defined (_MSC_VER)
+	#pragma warning(pop)
+#endif
+
+#else
+#error "Unknown System"
+#endif
+
 bool Searcher::test(string portName, uint32_t baudrate)
+{
+	return test(portName, baudrate, 50, 9, 50);
+}
+
+// Timing used by quickSearch. A sensor streaming asynchronous output at its
+// 40 Hz default sends a complete packet within about two periods.
+const uint32_t QuickListenMs = 30;
+const size_t QuickNumOfProbes = 2;
+const uint32_t QuickProbeTimeoutMs = 15;
+
+bool Searcher::quickSearch(const string &portName, const vector<uint32_t> &likelyBaudrates, uint32_t *foundBaudrate)
+{
+	#if __cplusplus < 201103L
+	vector<uint32_t> TestBaudrates(TestBaudratesRaw, TestBaudratesRaw + sizeof(TestBaudratesRaw) / sizeof(TestBaudratesRaw[0]));
+	#endif
+
+	vector<uint32_t> likely;
+	vector<uint32_t> remaining;
+
+	for (vector<uint32_t>::const_iterator it = likelyBaudrates.begin(); it != likelyBaudrates.end(); ++it)
+	{
+		if (*it != 0 && find(likely.begin(), likely.end(), *it) == likely.end())
+			likely.push_back(*it);
+	}
+
+	for (vector<uint32_t>::const_iterator it = TestBaudrates.begin(); it != TestBaudrates.end(); ++it)
+	{
+		if (find(likely.begin(), likely.end(), *it) == likely.end())
+			remaining.push_back(*it);
+	}
+
+	for (vector<uint32_t>::const_iterator it = likely.begin(); it != likely.end(); ++it)
+	{
+		if (test(portName, *it, QuickListenMs, QuickNumOfProbes, QuickProbeTimeoutMs + ProbeRoundTripBytes * 10 * 1000 / *it))
+		{
+			*foundBaudrate = *it;
+
+			return true;
+		}
+	}
+
+	for (vector<uint32_t>::const_iterator it = remaining.begin(); it != remaining.end(); ++it)
+	{
+		if (test(portName, *it, QuickListenMs, 0, 0))
+		{
+			*foundBaudrate = *it;
+
+			return true;
+		}
+	}
+
+	for (vector<uint32_t>::const_iterator it = remaining.begin(); it != remaining.end(); ++it)
+	{
+		if (test(portName, *it, 0, QuickNumOfProbes, QuickProbeTimeoutMs + ProbeRoundTripBytes * 10 * 1000 / *it))
+		{
+			*foundBaudrate = *it;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool Searcher::test(string portName, uint32_t baudrate, uint32_t listenMs, size_t numOfProbes, uint32_t probeTimeoutMs)
 {
 	SerialPort sp(portName, baudrate);
 	PacketFinder pf;
@@ -138,7 +471,7 @@ bool Searcher::test(string portName, uint32_t baudrate)
 
 	// Wait for a few milliseconds to see if we receive any asynchronous
 	// data packets.
-	if (th.waitForCheckingOnPort.waitMs(50) == Event::WAIT_SIGNALED)
+	if (listenMs > 0 && th.waitForCheckingOnPort.waitMs(listenMs) == Event::WAIT_SIGNALED)
 	{
 		sp.close();
 
@@ -147,11 +480,11 @@ bool Searcher::test(string portName, uint32_t baudrate)
 
 	// We have received any asynchronous data packets so let's try sending
 	// some commands.
-	for (size_t i = 0; i < 9; i++)
+	for (size_t i = 0; i < numOfProbes; i++)
 	{
 		sp.write("$VNRRG,01*XX\r\n", 14);
 
-		if (th.waitForCheckingOnPort.waitMs(50) == Event::WAIT_SIGNALED)
+		if (th.waitForCheckingOnPort.waitMs(probeTimeoutMs) == Event::WAIT_SIGNALED)
 		{
 			sp.close();
 
@@ -168,9 +501,7 @@ void searchThread(void* routineData)
 {
 	SearchHelper *sh = static_cast<SearchHelper*>(routineData);
 
-	sh->sensorFound = Searcher::search(sh->portName, &sh->foundBaudrate);
-
-	sh->finishedSearchingPort.signal();
+	sh->sensorFound = Searcher::quickSearch(sh->portName, vector<uint32_t>(), &sh->foundBaudrate);
 }
 
 void testDataReceivedHandler(void* userData)
@@ -0,0 +1,645 @@
+#include "vn/sensorhub.h"
+
+#if __linux__
+	#include <errno.h>
+	#include <sched.h>
+	#include <unistd.h>
+	#include <sys/epoll.h>
+	#include <sys/eventfd.h>
+#endif
+
+#include <atomic>
+#include <map>
+#include <vector>
+#include <stdexcept>
+
+#include "vn/thread.h"
+#include "vn/criticalsection.h"
+#include "vn/event.h"
+#include "vn/exceptions.h"
+#include "vn/vntime.h"
+
+using namespace std;
+using namespace vn::xplat;
+
+namespace vn {
+namespace sensors {
+
+#if __linux__
+
+namespace
+{
+	const int MaxEventsPerWait = 16;
+
+	// Line counters are sampled this often while ports are quiet.
+	const int IdleWaitMs = 100;
+
+	const uint32_t DetachPollUs = 50;
+
+	// Event data of the eventfd used to wake a loop. Channel IDs start at 1.
+	const uint64_t WakeId = 0;
+
+	int64_t monotonicNs()
+	{
+		return TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC).totalNs();
+	}
+}
+
+struct SensorHub::Impl
+{
+	struct Loop;
+
+	// Services one sensor's serial port on a loop. The channel stays with
+	// the sensor across reconnects while ports come and go.
+	struct Channel : public SerialPort::NotificationDriver
+	{
+		Loop* Owner;
+		VnSensor* Sensor;
+		uint64_t Id;
+
+		// The rest is guarded by Owner->CS.
+		SerialPort* Port;
+		int Handle;
+		bool Registered;
+		SensorStats Stats;
+
+		Channel(Loop* owner, VnSensor* sensor, uint64_t id) :
+			Owner(owner),
+			Sensor(sensor),
+			Id(id),
+			Port(NULL),
+			Handle(-1),
+			Registered(false)
+		{ }
+
+		void portOpened(SerialPort& port, int handle)
+		{
+			Owner->attach(this, port, handle);
+		}
+
+		void portClosing(SerialPort&)
+		{
+			Owner->detach(this);
+		}
+	};
+
+	struct Loop
+	{
+		int EpollFd;
+		int WakeFd;
+		int Cpu;
+		bool Started;
+		Thread* pThread;
+		atomic<bool> Continue;
+		Event StartedEvent;
+
+		// Guards the channels and Dispatching. Never held while a sensor's
+		// data is handled, so handlers may connect, disconnect and add or
+		// remove sensors.
+		CriticalSection CS;
+		map<uint64_t, Channel*> Channels;
+		Channel* Dispatching;
+
+		explicit Loop(int cpu) :
+			EpollFd(-1),
+			WakeFd(-1),
+			Cpu(cpu),
+			Started(false),
+			pThread(NULL),
+			Continue(true),
+			Dispatching(NULL)
+		{ }
+
+		~Loop()
+		{
+			if (pThread != NULL)
+			{
+				Continue = false;
+				wake();
+
+				pThread->join();
+				delete pThread;
+			}
+
+			if (WakeFd != -1)
+				close(WakeFd);
+
+			if (EpollFd != -1)
+				close(EpollFd);
+		}
+
+		void start()
+		{
+			EpollFd = epoll_create1(EPOLL_CLOEXEC);
+			WakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+			if (EpollFd == -1 || WakeFd == -1)
+				throw unknown_error();
+
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.u64 = WakeId;
+
+			if (epoll_ctl(EpollFd, EPOLL_CTL_ADD, WakeFd, &ev) == -1)
+				throw unknown_error();
+
+			pThread = Thread::startNew(run, this);
+
+			StartedEvent.wait();
+
+			if (!Started)
+				throw unknown_error();
+		}
+
+		void wake()
+		{
+			uint64_t one = 1;
+
+			if (::write(WakeFd, &one, sizeof(one)) == -1) { }
+		}
+
+		static Loop*& currentLoop()
+		{
+			static thread_local Loop* loop = NULL;
+
+			return loop;
+		}
+
+		void attach(Channel* channel, SerialPort& port, int handle)
+		{
+			CS.enter();
+
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.u64 = channel->Id;
+
+			if (epoll_ctl(EpollFd, EPOLL_CTL_ADD, handle, &ev) == -1)
+			{
+				CS.leave();
+
+				throw unknown_error();
+			}
+
+			channel->Port = &port;
+			channel->Handle = handle;
+			channel->Registered = true;
+			channel->Stats.numOfAttachments++;
+
+			CS.leave();
+		}
+
+		void detach(Channel* channel)
+		{
+			CS.enter();
+
+			unregister(channel);
+			channel->Port = NULL;
+			channel->Handle = -1;
+
+			// A handler closing its own port is already done with it.
+			if (currentLoop() != this)
+			{
+				while (Dispatching == channel)
+				{
+					CS.leave();
+					Thread::sleepUs(DetachPollUs);
+					CS.enter();
+				}
+			}
+
+			CS.leave();
+		}
+
+		// Must be called with CS held.
+		void unregister(Channel* channel)
+		{
+			if (!channel->Registered)
+				return;
+
+			epoll_ctl(EpollFd, EPOLL_CTL_DEL, channel->Handle, NULL);
+			channel->Registered = false;
+		}
+
+		static void run(void* data)
+		{
+			static_cast<Loop*>(data)->run();
+		}
+
+		void run()
+		{
+			currentLoop() = this;
+
+			if (Cpu >= 0)
+			{
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				CPU_SET(Cpu, &set);
+
+				if (sched_setaffinity(0, sizeof(set), &set) == -1)
+				{
+					StartedEvent.signal();
+					return;
+				}
+			}
+
+			Started = true;
+			StartedEvent.signal();
+
+			epoll_event events[MaxEventsPerWait];
+			size_t rotation = 0;
+
+			while (Continue)
+			{
+				int n = epoll_wait(EpollFd, events, MaxEventsPerWait, IdleWaitMs);
+
+				if (n == -1)
+				{
+					if (errno == EINTR)
+						continue;
+
+					// Something unexpected happened.
+					break;
+				}
+
+				if (n == 0)
+				{
+					pollLineStatistics();
+					continue;
+				}
+
+				TimeStamp woke = TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC);
+				int64_t wokeNs = monotonicNs();
+
+				// Start with a different sensor every time so none of them
+				// always waits behind the others.
+				rotation++;
+
+				for (int i = 0; i < n; i++)
+				{
+					epoll_event& ev = events[(i + rotation) % n];
+
+					if (ev.data.u64 == WakeId)
+					{
+						uint64_t count;
+						if (::read(WakeFd, &count, sizeof(count)) == -1) { }
+
+						continue;
+					}
+
+					dispatch(ev.data.u64, ev.events, woke, wokeNs);
+				}
+			}
+
+			currentLoop() = NULL;
+		}
+
+		void dispatch(uint64_t id, uint32_t events, const TimeStamp& woke, int64_t wokeNs)
+		{
+			CS.enter();
+
+			map<uint64_t, Channel*>::iterator it = Channels.find(id);
+
+			// The channel or its port may have gone since the wait returned.
+			if (it == Channels.end() || it->second->Port == NULL)
+			{
+				CS.leave();
+				return;
+			}
+
+			Channel* channel = it->second;
+			SerialPort* port = channel->Port;
+			bool hungUp = (events & (EPOLLERR | EPOLLHUP)) != 0;
+
+			if (hungUp)
+			{
+				// The port stays open until the sensor is disconnected, but
+				// would be reported ready on every wait from now on.
+				unregister(channel);
+				channel->Stats.numOfHangups++;
+			}
+
+			if (!(events & EPOLLIN))
+			{
+				CS.leave();
+				return;
+			}
+
+			Dispatching = channel;
+
+			CS.leave();
+
+			int64_t startNs = monotonicNs();
+
+			try
+			{
+				port->notifyDataReceived(woke);
+			}
+			catch (...)
+			{
+				// Don't want user-code exceptions stopping the thread.
+			}
+
+			int64_t endNs = monotonicNs();
+
+			CS.enter();
+
+			Dispatching = NULL;
+
+			// The handler may have removed the sensor from the hub.
+			it = Channels.find(id);
+
+			if (it != Channels.end())
+			{
+				SensorStats& s = it->second->Stats;
+				uint64_t dispatchNs = static_cast<uint64_t>(endNs - startNs);
+				uint64_t waitNs = static_cast<uint64_t>(startNs - wokeNs);
+
+				s.numOfNotifications++;
+				s.totalDispatchNs += dispatchNs;
+
+				if (dispatchNs > s.maxDispatchNs)
+					s.maxDispatchNs = dispatchNs;
+
+				if (waitNs > s.maxWaitNs)
+					s.maxWaitNs = waitNs;
+			}
+
+			CS.leave();
+		}
+
+		void pollLineStatistics()
+		{
+			CS.enter();
+
+			for (map<uint64_t, Channel*>::iterator it = Channels.begin(); it != Channels.end(); ++it)
+			{
+				Channel* channel = it->second;
+
+				if (channel->Port == NULL)
+					continue;
+
+				Dispatching = channel;
+
+				SerialPort* port = channel->Port;
+
+				CS.leave();
+
+				try
+				{
+					port->pollLineStatistics();
+				}
+				catch (...) { }
+
+				CS.enter();
+
+				Dispatching = NULL;
+
+				// The channels may have changed while CS was released.
+				it = Channels.find(channel->Id);
+				if (it == Channels.end())
+					break;
+			}
+
+			CS.leave();
+		}
+	};
+
+	vector<Loop*> Loops;
+
+	// Guards Channels and NextId.
+	CriticalSection CS;
+	vector<Channel*> Channels;
+	uint64_t NextId;
+
+	Impl() :
+		NextId(WakeId + 1)
+	{ }
+
+	~Impl()
+	{
+		for (size_t i = 0; i < Loops.size(); i++)
+			delete Loops[i];
+	}
+
+	// Must be called with CS held.
+	vector<Channel*>::iterator find(VnSensor& sensor)
+	{
+		for (vector<Channel*>::iterator it = Channels.begin(); it != Channels.end(); ++it)
+		{
+			if ((*it)->Sensor == &sensor)
+				return it;
+		}
+
+		return Channels.end();
+	}
+
+	// Must be called with CS held.
+	Loop* leastLoadedLoop()
+	{
+		Loop* best = Loops[0];
+		size_t bestCount = Channels.size() + 1;
+
+		for (size_t i = 0; i < Loops.size(); i++)
+		{
+			size_t count = 0;
+
+			for (size_t j = 0; j < Channels.size(); j++)
+			{
+				if (Channels[j]->Owner == Loops[i])
+					count++;
+			}
+
+			if (count < bestCount)
+			{
+				best = Loops[i];
+				bestCount = count;
+			}
+		}
+
+		return best;
+	}
+
+	void remove(Channel* channel)
+	{
+		// Hands a connected port back to its own thread. Detaching waits for
+		// the loop to finish with the port.
+		channel->Sensor->setNotificationDriver(NULL);
+
+		Loop* loop = channel->Owner;
+
+		loop->CS.enter();
+		loop->Channels.erase(channel->Id);
+		loop->CS.leave();
+
+		delete channel;
+	}
+};
+
+SensorHub::SensorHub(size_t numOfThreads, int cpu) :
+	_pi(new Impl())
+{
+	if (numOfThreads == 0)
+	{
+		delete _pi;
+		throw invalid_argument("numOfThreads");
+	}
+
+	try
+	{
+		for (size_t i = 0; i < numOfThreads; i++)
+		{
+			_pi->Loops.push_back(new Impl::Loop(cpu));
+			_pi->Loops.back()->start();
+		}
+	}
+	catch (...)
+	{
+		delete _pi;
+		throw;
+	}
+}
+
+SensorHub::~SensorHub()
+{
+	while (!_pi->Channels.empty())
+	{
+		Impl::Channel* channel = _pi->Channels.back();
+		_pi->Channels.pop_back();
+
+		_pi->remove(channel);
+	}
+
+	delete _pi;
+}
+
+void SensorHub::add(VnSensor& sensor)
+{
+	_pi->CS.enter();
+
+	if (_pi->find(sensor) != _pi->Channels.end())
+	{
+		_pi->CS.leave();
+		throw invalid_operation("The sensor was already added.");
+	}
+
+	Impl::Loop* loop = _pi->leastLoadedLoop();
+	Impl::Channel* channel = new Impl::Channel(loop, &sensor, _pi->NextId++);
+
+	_pi->Channels.push_back(channel);
+
+	_pi->CS.leave();
+
+	loop->CS.enter();
+	loop->Channels[channel->Id] = channel;
+	loop->CS.leave();
+
+	try
+	{
+		sensor.setNotificationDriver(channel);
+	}
+	catch (...)
+	{
+		_pi->CS.enter();
+		_pi->Channels.erase(_pi->find(sensor));
+		_pi->CS.leave();
+
+		_pi->remove(channel);
+
+		throw;
+	}
+}
+
+void SensorHub::remove(VnSensor& sensor)
+{
+	_pi->CS.enter();
+
+	vector<Impl::Channel*>::iterator it = _pi->find(sensor);
+
+	if (it == _pi->Channels.end())
+	{
+		_pi->CS.leave();
+		throw not_found("The sensor was not added.");
+	}
+
+	Impl::Channel* channel = *it;
+	_pi->Channels.erase(it);
+
+	_pi->CS.leave();
+
+	_pi->remove(channel);
+}
+
+size_t SensorHub::size()
+{
+	_pi->CS.enter();
+	size_t count = _pi->Channels.size();
+	_pi->CS.leave();
+
+	return count;
+}
+
+SensorHub::SensorStats SensorHub::stats(VnSensor& sensor)
+{
+	_pi->CS.enter();
+
+	vector<Impl::Channel*>::iterator it = _pi->find(sensor);
+
+	if (it == _pi->Channels.end())
+	{
+		_pi->CS.leave();
+		throw not_found("The sensor was not added.");
+	}
+
+	Impl::Channel* channel = *it;
+
+	channel->Owner->CS.enter();
+	SensorStats s = channel->Stats;
+	channel->Owner->CS.leave();
+
+	_pi->CS.leave();
+
+	return s;
+}
+
+#elif _WIN32 || __APPLE__ || __CYGWIN__ || __QNXNTO__
+
+struct SensorHub::Impl
+{
+};
+
+SensorHub::SensorHub(size_t, int) :
+	_pi(NULL)
+{
+	throw not_supported();
+}
+
+SensorHub::~SensorHub()
+{
+}
+
+void SensorHub::add(VnSensor&)
+{
+	throw not_supported();
+}
+
+void SensorHub::remove(VnSensor&)
+{
+	throw not_supported();
+}
+
+size_t SensorHub::size()
+{
+	return 0;
+}
+
+SensorHub::SensorStats SensorHub::stats(VnSensor&)
+{
+	throw not_supported();
+}
+
+#else
+#error "Unknown System"
+#endif
+
+}
+}
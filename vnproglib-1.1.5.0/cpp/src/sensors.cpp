@@ -10,11 +10,29 @@
 #include "vn/matrix.h"
 #include "vn/compiler.h"
 #include "vn/util.h"
+#include "vn/thread.h"
+#include "vn/searcher.h"
+#include "vn/mpscqueue.h"
 
 #include <string>
-#include <queue>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <list>
+#include <vector>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+
+#if __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+	#include <poll.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#if __linux__
+	#include <sys/inotify.h>
+#endif
 
 #if PYTHON
 	#include "util.h"
@@ -70,34 +88,275 @@ char const* sensor_error::what() const throw()
 	return _errorMessage;
 }
 
+// The baudrate cache holds one "<port> <baudrate>" line per port.
+static uint32_t readCachedBaudrate(const string &cacheFile, const string &portName)
+{
+	ifstream in(cacheFile.c_str());
+	string line;
+
+	while (getline(in, line))
+	{
+		istringstream fields(line);
+		string port;
+		uint32_t baudrate;
+
+		if (fields >> port >> baudrate && port == portName)
+			return baudrate;
+	}
+
+	return 0;
+}
+
+static void writeCachedBaudrate(const string &cacheFile, const string &portName, uint32_t baudrate)
+{
+	vector<string> lines;
+
+	{
+		ifstream in(cacheFile.c_str());
+		string line;
+
+		while (getline(in, line))
+		{
+			istringstream fields(line);
+			string port;
+
+			if (fields >> port && port != portName)
+				lines.push_back(line);
+		}
+	}
+
+	ofstream out(cacheFile.c_str(), ios::trunc);
+
+	for (size_t i = 0; i < lines.size(); i++)
+		out << lines[i] << '\n';
+
+	out << portName << ' ' << baudrate << '\n';
+}
+
 struct VnSensor::Impl
 {
 	static const size_t DefaultReadBufferSize = 256;
 	static const uint16_t DefaultResponseTimeoutMs = 500;
 	static const uint16_t DefaultRetransmitDelayMs = 200;
+	static const size_t DefaultMaxCommandsInFlight = 8;
+	static const uint32_t MaxAsyncCommandWaitUs = 100000;
+	static const uint32_t CommandSlotPollUs = 1000;
+	static const size_t ResponseMaxLength = 512;
+	static const size_t ResponseQueueCapacity = 64;
+	static const uint32_t SupervisorCheckIntervalMs = 50;
+	static const uint32_t SubscriberReclaimPollUs = 50;
+	static const uint32_t PortReleasePollUs = 50;
+	static const uint32_t ReconnectRetryDelayMs = 100;
+
+	struct Subscriber
+	{
+		size_t Id;
+		TimedAsyncPacketReceivedHandler Handler;
+		void* UserData;
+		AsyncPacketFilter Filter;
+	};
+
+	// Subscribers are never modified in place. Changes publish a new list
+	// and retire the old one, which is freed once no dispatch can use it.
+	typedef vector<Subscriber> SubscriberList;
+
+	// Counts a dispatch under the current epoch, and marks the sensor whose
+	// subscribers the current thread is dispatching to, so unsubscribing from
+	// within a handler does not wait on itself.
+	struct DispatchScope
+	{
+		Impl* Owner;
+		Impl* Previous;
+		size_t Epoch;
+
+		explicit DispatchScope(Impl* owner) :
+			Owner(owner),
+			Previous(dispatchingSensor()),
+			Epoch(owner->_dispatchEpoch & 1)
+		{
+			Owner->_numOfDispatches[Epoch]++;
+			dispatchingSensor() = owner;
+		}
+
+		~DispatchScope()
+		{
+			dispatchingSensor() = Previous;
+			Owner->_numOfDispatches[Epoch]--;
+		}
+
+		static Impl*& dispatchingSensor()
+		{
+			static thread_local Impl* sensor = NULL;
+
+			return sensor;
+		}
+	};
+
+	// Holds on to the current port while it is used. Replacing the port
+	// clears the pointers under _connectionCS, so no new scope can get the
+	// old port, and waits for the scopes still holding it to end before
+	// closing and freeing it.
+	struct PortScope
+	{
+		Impl* Owner;
+		IPort* Port;
+		SerialPort* Serial;
+
+		explicit PortScope(Impl* owner) :
+			Owner(owner)
+		{
+			Owner->_connectionCS.enter();
+			Port = Owner->port;
+			Serial = Owner->pSerialPort;
+			Owner->_numOfPortUsers++;
+			Owner->_connectionCS.leave();
+		}
+
+		~PortScope()
+		{
+			Owner->_numOfPortUsers--;
+		}
+	};
+
+	// A response or error copied out of the receive buffer for the command
+	// thread, so the receive thread neither allocates nor takes a lock.
+	struct ReceivedResponse
+	{
+		char Data[ResponseMaxLength];
+		size_t Length;
+	};
+
+	// A command written to the sensor that is still owned by a caller waiting
+	// on its response. Responses are matched by command type and, for register
+	// reads/writes, by register ID.
+	struct PendingCommand
+	{
+		string Command;
+		string Type;
+		int RegisterId;
+		uint16_t ResponseTimeoutMs;
+		uint16_t RetransmitDelayMs;
+		xplat::Event* Done;
+		promise<Packet>* Promise;
+		ResponseReceivedHandler Handler;
+		void* HandlerUserData;
+		bool Completed;
+		bool TimedOut;
+		float FirstSentMs;
+		float LastSentMs;
+		Packet Response;
+
+		PendingCommand(const string& command, uint16_t responseTimeoutMs, uint16_t retransmitDelayMs) :
+			Command(command),
+			RegisterId(-1),
+			ResponseTimeoutMs(responseTimeoutMs),
+			RetransmitDelayMs(retransmitDelayMs),
+			Done(NULL),
+			Promise(NULL),
+			Handler(NULL),
+			HandlerUserData(NULL),
+			Completed(false),
+			TimedOut(false),
+			FirstSentMs(0),
+			LastSentMs(0)
+		{
+			// Commands look like "$VNRRG,5*XX\r\n".
+			if (command.size() >= 6)
+				Type = command.substr(3, 3);
+
+			if ((Type == "RRG" || Type == "WRG") && command.size() > 7)
+				RegisterId = atoi(command.c_str() + 7);
+		}
+
+		// Commands sent with sendAsync are owned by the sensor rather than by
+		// a waiting caller.
+		bool isAsync()
+		{
+			return Promise != NULL || Handler != NULL;
+		}
+
+		// Reports the outcome of an asynchronous command and frees it.
+		void completeAsync()
+		{
+			if (Handler != NULL)
+				Handler(HandlerUserData, Response, TimedOut);
+			else if (TimedOut)
+				Promise->set_exception(make_exception_ptr(timeout()));
+			else if (Response.isError())
+				Promise->set_exception(make_exception_ptr(sensor_error(Response.parseError())));
+			else
+				Promise->set_value(Response);
+
+			delete Promise;
+			delete this;
+		}
+
+		bool isAnsweredBy(Packet& response)
+		{
+			string r = response.datastr();
+
+			if (r.size() < 6 || r.compare(3, 3, Type) != 0)
+				return false;
+
+			if (RegisterId < 0)
+				return true;
+
+			return r.size() > 7 && atoi(r.c_str() + 7) == RegisterId;
+		}
+	};
 
 	SerialPort *pSerialPort;
+	atomic<SerialPort::NotificationDriver*> _notificationDriver;
 	IPort* port;
 	bool SimplePortIsOurs;
 	bool DidWeOpenSimplePort;
+	CriticalSection _connectionCS;
+	atomic<size_t> _numOfPortUsers;
 	RawDataReceivedHandler _rawDataReceivedHandler;
 	void* _rawDataReceivedUserData;
 	PossiblePacketFoundHandler _possiblePacketFoundHandler;
 	void* _possiblePacketFoundUserData;
 	PacketFinder _packetFinder;
+	char _readBuffer[DefaultReadBufferSize];
 	size_t _dataRunningIndex;
 	AsyncPacketReceivedHandler _asyncPacketReceivedHandler;
 	void* _asyncPacketReceivedUserData;
+	TimedAsyncPacketReceivedHandler _timedAsyncPacketReceivedHandler;
+	void* _timedAsyncPacketReceivedUserData;
+	atomic<const SubscriberList*> _subscribers;
+	atomic<size_t> _dispatchEpoch;
+	atomic<size_t> _numOfDispatches[2];
+	CriticalSection _reclaimCS;
+	CriticalSection _subscribersCS;
+	vector<const SubscriberList*> _retiredSubscribers;
+	size_t _nextSubscriptionId;
 	ErrorDetectionMode _sendErrorDetectionMode;
 	VnSensor* BackReference;
-	queue<Packet> _receivedResponses;
+	list<PendingCommand*> _pendingCommands;
+	atomic<size_t> _numOfPendingCommands;
+	MpscQueue<ReceivedResponse> _receivedResponses;
 	CriticalSection _transactionCS;
-	bool _waitingForResponse;
+	atomic<size_t> _maxCommandsInFlight;
+	list<PendingCommand*> _queuedAsyncCommands;
+	Thread* _commandThread;
+	atomic<bool> _continueCommandThread;
+	xplat::Event _commandThreadEvent;
+	Stopwatch _asyncCommandClock;
+	string _baudCacheFile;
+	Thread* _supervisorThread;
+	atomic<bool> _continueSupervising;
+	string _supervisedPortName;
+	uint32_t _supervisedBaudrate;
+	uint32_t _streamLossTimeoutMs;
+	ConfigurationProfile _supervisorProfile;
+	ReconnectedHandler _reconnectedHandler;
+	void* _reconnectedUserData;
+	atomic<int64_t> _lastPacketNs;
+	atomic<bool> _asyncOutputsPaused;
 	ErrorPacketReceivedHandler _errorPacketReceivedHandler;
 	void* _errorPacketReceivedUserData;
 	uint16_t _responseTimeoutMs;
 	uint16_t _retransmitDelayMs;
-	xplat::Event _newResponsesEvent;
 	#if PYTHON
 	PyObject* _rawDataReceivedHandlerPython;
 	PyObject* _asyncPacketReceivedHandlerPython;
@@ -105,9 +364,11 @@ struct VnSensor::Impl
 
 	explicit Impl(VnSensor* backReference) :
 		pSerialPort(NULL),
+		_notificationDriver(NULL),
 		port(NULL),
 		SimplePortIsOurs(false),
 		DidWeOpenSimplePort(false),
+		_numOfPortUsers(0),
 		_rawDataReceivedHandler(NULL),
 		_rawDataReceivedUserData(NULL),
 		_possiblePacketFoundHandler(NULL),
@@ -115,9 +376,26 @@ struct VnSensor::Impl
 		_dataRunningIndex(0),
 		_asyncPacketReceivedHandler(NULL),
 		_asyncPacketReceivedUserData(NULL),
+		_timedAsyncPacketReceivedHandler(NULL),
+		_timedAsyncPacketReceivedUserData(NULL),
+		_subscribers(NULL),
+		_dispatchEpoch(0),
+		_nextSubscriptionId(1),
 		_sendErrorDetectionMode(ERRORDETECTIONMODE_CHECKSUM),
 		BackReference(backReference),
-		_waitingForResponse(false),
+		_numOfPendingCommands(0),
+		_receivedResponses(ResponseQueueCapacity),
+		_maxCommandsInFlight(DefaultMaxCommandsInFlight),
+		_commandThread(NULL),
+		_continueCommandThread(false),
+		_supervisorThread(NULL),
+		_continueSupervising(false),
+		_supervisedBaudrate(0),
+		_streamLossTimeoutMs(0),
+		_reconnectedHandler(NULL),
+		_reconnectedUserData(NULL),
+		_lastPacketNs(0),
+		_asyncOutputsPaused(false),
 		_errorPacketReceivedHandler(NULL),
 		_errorPacketReceivedUserData(NULL),
 		_responseTimeoutMs(DefaultResponseTimeoutMs),
@@ -128,12 +406,20 @@ struct VnSensor::Impl
 		_rawDataReceivedHandlerPython(NULL)
 		#endif
 	{
+		_numOfDispatches[0] = 0;
+		_numOfDispatches[1] = 0;
+
 		_packetFinder.registerPossiblePacketFoundHandler(this, possiblePacketFoundHandler);
 	}
 
 	~Impl()
 	{
+		stopSupervisor();
+		stopCommandThread();
         _packetFinder.unregisterPossiblePacketFoundHandler();
+
+		delete _subscribers.load();
+		reclaimSubscribers(_retiredSubscribers);
 	}
 
 	void onPossiblePacketFound(Packet& possiblePacket, size_t packetStartRunningIndex)
@@ -149,6 +435,11 @@ struct VnSensor::Impl
 		if (_asyncPacketReceivedHandler != NULL)
 			_asyncPacketReceivedHandler(_asyncPacketReceivedUserData, asciiPacket, runningIndex);
 
+		if (_timedAsyncPacketReceivedHandler != NULL)
+			_timedAsyncPacketReceivedHandler(_timedAsyncPacketReceivedUserData, asciiPacket, runningIndex, timestamp);
+
+		dispatchToSubscribers(asciiPacket, runningIndex, timestamp);
+
 		#if PYTHON
 		BackReference->eventAsyncPacketReceived.fire(asciiPacket, runningIndex, timestamp);
 		#endif
@@ -163,6 +454,72 @@ struct VnSensor::Impl
 		//#endif
 	}
 
+	void dispatchToSubscribers(Packet& packet, size_t runningIndex, TimeStamp timestamp)
+	{
+		// Count the dispatch before loading the list, so a writer that sees
+		// no dispatches after publishing a new list knows the old one is free.
+		DispatchScope scope(this);
+
+		const SubscriberList* subscribers = _subscribers.load();
+
+		if (subscribers == NULL)
+			return;
+
+		for (size_t i = 0; i < subscribers->size(); i++)
+		{
+			const Subscriber& s = (*subscribers)[i];
+
+			if (s.Filter.matches(packet))
+				s.Handler(s.UserData, packet, runningIndex, timestamp);
+		}
+	}
+
+	// Publishes a new subscriber list. Returns the retired lists the caller
+	// should pass to reclaimSubscribers after releasing _subscribersCS, which
+	// must be held here.
+	vector<const SubscriberList*> replaceSubscribers(const SubscriberList* subscribers)
+	{
+		vector<const SubscriberList*> retired;
+		const SubscriberList* old = _subscribers.exchange(subscribers);
+
+		if (old != NULL)
+			_retiredSubscribers.push_back(old);
+
+		// Handlers may subscribe or unsubscribe; the list they are iterating
+		// is then reclaimed by a later change from another thread.
+		if (DispatchScope::dispatchingSensor() != this)
+			retired.swap(_retiredSubscribers);
+
+		return retired;
+	}
+
+	// Waits until no dispatch can still be using the retired lists and frees
+	// them. Each round moves new dispatches to the other epoch's counter and
+	// waits for those left under the previous one, so only dispatches that
+	// started before the lists were retired are waited for, however busy the
+	// sensor is. Two rounds are needed since a dispatch may have loaded the
+	// epoch just before an earlier reclaim flipped it.
+	void reclaimSubscribers(const vector<const SubscriberList*>& retired)
+	{
+		if (retired.empty())
+			return;
+
+		_reclaimCS.enter();
+
+		for (int round = 0; round < 2; round++)
+		{
+			size_t previous = _dispatchEpoch++ & 1;
+
+			while (_numOfDispatches[previous] != 0)
+				Thread::sleepUs(SubscriberReclaimPollUs);
+		}
+
+		_reclaimCS.leave();
+
+		for (size_t i = 0; i < retired.size(); i++)
+			delete retired[i];
+	}
+
 	void onErrorPacketReceived(Packet& errorPacket, size_t runningIndex)
 	{
 		if (_errorPacketReceivedHandler != NULL)
@@ -178,30 +535,19 @@ struct VnSensor::Impl
 		if (!possiblePacket.isValid())
 			return;
 
+		pThis->_lastPacketNs = monotonicNs();
+
 		if (possiblePacket.isError())
 		{
-			if (pThis->_waitingForResponse)
-			{
-				pThis->_transactionCS.enter();
-				pThis->_receivedResponses.push(possiblePacket);
-				pThis->_newResponsesEvent.signal();
-				pThis->_transactionCS.leave();
-			}
+			pThis->queueResponse(possiblePacket);
 
 			pThis->onErrorPacketReceived(possiblePacket, packetStartRunningIndex);
 
 			return;
 		}
 
-		if (possiblePacket.isResponse() && pThis->_waitingForResponse)
-		{
-			pThis->_transactionCS.enter();
-			pThis->_receivedResponses.push(possiblePacket);
-			pThis->_newResponsesEvent.signal();
-			pThis->_transactionCS.leave();
-
+		if (possiblePacket.isResponse() && pThis->queueResponse(possiblePacket))
 			return;
-		}
 
 		// This wasn't anything else. We assume it is an async packet.
 		pThis->onAsyncPacketReceived(possiblePacket, packetStartRunningIndex, timestamp);
@@ -209,21 +555,35 @@ struct VnSensor::Impl
 
 	static void dataReceivedHandler(void* userData)
 	{
-		static char readBuffer[DefaultReadBufferSize];
 		Impl *pi = static_cast<Impl*>(userData);
+		char* readBuffer = pi->_readBuffer;
 
 		size_t numOfBytesRead = 0;
+		TimeStamp t;
+		uint32_t byteTimeNs = 0;
 
-		pi->port->read(
-			readBuffer,
-			DefaultReadBufferSize,
-			numOfBytesRead);
+		{
+			PortScope scope(pi);
+
+			// The port is being released.
+			if (scope.Port == NULL)
+				return;
+
+			// Serial ports stamp the data when their notification thread
+			// wakes, which is closer to the arrival of the data than after
+			// the read.
+			t = scope.Serial != NULL ? scope.Serial->dataReceivedTimestamp() : TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC);
+			byteTimeNs = scope.Serial != NULL ? scope.Serial->byteTimeNs() : 0;
+
+			scope.Port->read(
+				readBuffer,
+				DefaultReadBufferSize,
+				numOfBytesRead);
+		}
 
 		if (numOfBytesRead == 0)
 			return;
 
-		TimeStamp t = TimeStamp::get();
-
 		if (pi->_rawDataReceivedHandler != NULL)
 			pi->_rawDataReceivedHandler(pi->_rawDataReceivedUserData, reinterpret_cast<char*>(readBuffer), numOfBytesRead, pi->_dataRunningIndex);
 
@@ -238,14 +598,97 @@ struct VnSensor::Impl
 		}
 		#endif
 
-		pi->_packetFinder.processReceivedData(reinterpret_cast<char*>(readBuffer), numOfBytesRead, t);
+		pi->_packetFinder.processReceivedData(reinterpret_cast<char*>(readBuffer), numOfBytesRead, t, byteTimeNs);
 
 		pi->_dataRunningIndex += numOfBytesRead;
 	}
 
 	bool isConnected()
 	{
-		return port != NULL && port->isOpen();
+		PortScope scope(this);
+
+		return scope.Port != NULL && scope.Port->isOpen();
+	}
+
+	// Starts using a port, opening it if needed. serialPort is the same
+	// port if it is a SerialPort we created, and is freed when the port is
+	// released. The port is only made visible to other threads once it is
+	// open; data arriving before then waits in the port.
+	void attachPort(IPort* newPort, SerialPort* serialPort)
+	{
+		bool weOpen = !newPort->isOpen();
+
+		try
+		{
+			newPort->registerDataReceivedHandler(this, dataReceivedHandler);
+
+			if (weOpen)
+				newPort->open();
+		}
+		catch (...)
+		{
+			newPort->unregisterDataReceivedHandler();
+			freePort(newPort, serialPort, false);
+			throw;
+		}
+
+		_connectionCS.enter();
+		port = newPort;
+		pSerialPort = serialPort;
+		SimplePortIsOurs = false;
+		DidWeOpenSimplePort = weOpen;
+		_connectionCS.leave();
+	}
+
+	// Stops using the port. Waits for calls still using it on other threads
+	// to return, which for a transaction may take until its timeout, then
+	// closes it if we opened it and frees it if we created it. Errors
+	// closing the port are ignored if ignoreErrors is set, e.g. when the
+	// sensor was unplugged, and otherwise thrown once it is freed.
+	void releasePort(bool ignoreErrors)
+	{
+		_connectionCS.enter();
+		IPort* released = port;
+		SerialPort* serialPort = pSerialPort;
+		bool close = DidWeOpenSimplePort;
+		bool ours = SimplePortIsOurs;
+		port = NULL;
+		pSerialPort = NULL;
+		DidWeOpenSimplePort = false;
+		_connectionCS.leave();
+
+		while (_numOfPortUsers != 0)
+			Thread::sleepUs(PortReleasePollUs);
+
+		if (released == NULL)
+			return;
+
+		try
+		{
+			released->unregisterDataReceivedHandler();
+
+			if (close && released->isOpen())
+				released->close();
+		}
+		catch (...)
+		{
+			freePort(released, serialPort, ours);
+
+			if (!ignoreErrors)
+				throw;
+
+			return;
+		}
+
+		freePort(released, serialPort, ours);
+	}
+
+	static void freePort(IPort* released, SerialPort* serialPort, bool ours)
+	{
+		if (ours && released != serialPort)
+			delete released;
+
+		delete serialPort;
 	}
 
 	size_t finalizeCommandToSend(char *toSend, size_t length)
@@ -276,99 +719,669 @@ struct VnSensor::Impl
 		return length;
 	}
 
+	// Called on the receive thread. Hands a response or error to the command
+	// thread if any command is in flight, in which case stray responses (e.g.
+	// the echo of a retransmit) are consumed there. Never blocks; if the
+	// queue is full the response is dropped and its command retransmits.
+	bool queueResponse(Packet& packet)
+	{
+		if (_numOfPendingCommands.load(memory_order_acquire) == 0)
+			return false;
+
+		if (packet.length() > ResponseMaxLength)
+			return true;
+
+		ReceivedResponse r;
+		memcpy(r.Data, packet.data(), packet.length());
+		r.Length = packet.length();
+
+		if (_receivedResponses.tryPush(r))
+			_commandThreadEvent.signal();
+
+		return true;
+	}
+
+	// Called on the command thread. Hands each queued response or error to
+	// the oldest in flight command waiting on it. Errors do not identify
+	// their command, so they go to the oldest outstanding one.
+	void dispatchResponses()
+	{
+		ReceivedResponse r;
+
+		while (_receivedResponses.tryPop(r))
+		{
+			Packet packet(r.Data, r.Length);
+			bool isError = packet.isError();
+			PendingCommand* asyncCommand = NULL;
+
+			_transactionCS.enter();
+
+			for (list<PendingCommand*>::iterator it = _pendingCommands.begin(); it != _pendingCommands.end(); ++it)
+			{
+				PendingCommand* c = *it;
+
+				if (c->Completed)
+					continue;
+
+				if (isError || c->isAnsweredBy(packet))
+				{
+					c->Response = packet;
+					c->Completed = true;
+
+					if (c->isAsync())
+					{
+						asyncCommand = c;
+						_pendingCommands.erase(it);
+						_numOfPendingCommands = _pendingCommands.size();
+					}
+					else
+					{
+						c->Done->signal();
+					}
+
+					break;
+				}
+			}
+
+			_transactionCS.leave();
+
+			if (asyncCommand != NULL)
+				asyncCommand->completeAsync();
+		}
+	}
+
+	void removePendingCommands(PendingCommand* commands, size_t count)
+	{
+		_transactionCS.enter();
+
+		for (size_t i = 0; i < count; i++)
+			_pendingCommands.remove(&commands[i]);
+
+		_numOfPendingCommands = _pendingCommands.size();
+
+		_transactionCS.leave();
+	}
+
+	// Counts the commands sent and not yet answered or timed out, whether
+	// from runCommands or the async queue, so together they never exceed
+	// _maxCommandsInFlight. Must be called with _transactionCS held.
+	size_t commandsInFlight() const
+	{
+		size_t inFlight = 0;
+
+		for (list<PendingCommand*>::const_iterator it = _pendingCommands.begin(); it != _pendingCommands.end(); ++it)
+		{
+			if (!(*it)->Completed)
+				inFlight++;
+		}
+
+		return inFlight;
+	}
+
+	// Starts the command thread, which dispatches responses and runs
+	// asynchronous commands, unless it is already running. Must be called
+	// with _transactionCS held.
+	void ensureCommandThread()
+	{
+		if (_commandThread != NULL)
+			return;
+
+		_continueCommandThread = true;
+		_commandThread = Thread::startNew(commandThread, this);
+	}
+
+	// Runs the provided commands, sending each once fewer than
+	// _maxCommandsInFlight commands are outstanding, counting those of other
+	// callers and the async queue. Each command keeps its own retransmit and
+	// timeout schedule, which starts when it is sent. Once every command has
+	// finished, the first failure (in the order provided) is thrown.
+	void runCommands(PendingCommand* commands, size_t count)
+	{
+		PortScope scope(this);
+
+		if (scope.Port == NULL)
+			throw invalid_operation();
+
+		xplat::Event done;
+		size_t nextToSend = 0;
+		Stopwatch sw;
+
+		for (size_t i = 0; i < count; i++)
+			commands[i].Done = &done;
+
+		try
+		{
+			while (true)
+			{
+				vector<PendingCommand*> toWrite;
+				size_t ownInFlight = 0;
+				float waitMs = -1;
+				float now = sw.elapsedMs();
+
+				_transactionCS.enter();
+
+				for (size_t i = 0; i < nextToSend; i++)
+				{
+					PendingCommand& c = commands[i];
+
+					if (c.Completed)
+						continue;
+
+					if (now - c.FirstSentMs >= c.ResponseTimeoutMs)
+					{
+						c.Completed = true;
+						c.TimedOut = true;
+						continue;
+					}
+
+					ownInFlight++;
+
+					if (c.RetransmitDelayMs > 0 && now - c.LastSentMs >= c.RetransmitDelayMs)
+					{
+						c.LastSentMs = now;
+						toWrite.push_back(&c);
+					}
+				}
+
+				size_t inFlight = commandsInFlight();
+
+				while (nextToSend < count && inFlight < _maxCommandsInFlight)
+				{
+					PendingCommand& c = commands[nextToSend++];
+
+					c.FirstSentMs = c.LastSentMs = now;
+					_pendingCommands.push_back(&c);
+					toWrite.push_back(&c);
+					ownInFlight++;
+					inFlight++;
+				}
+
+				_numOfPendingCommands = _pendingCommands.size();
+
+				// Responses reach us through the command thread.
+				ensureCommandThread();
+
+				// Sleep until the nearest retransmit or timeout is due.
+				for (size_t i = 0; i < nextToSend; i++)
+				{
+					PendingCommand& c = commands[i];
+
+					if (c.Completed)
+						continue;
+
+					float due = c.FirstSentMs + c.ResponseTimeoutMs - now;
+
+					if (c.RetransmitDelayMs > 0 && c.LastSentMs + c.RetransmitDelayMs - now < due)
+						due = c.LastSentMs + c.RetransmitDelayMs - now;
+
+					if (waitMs < 0 || due < waitMs)
+						waitMs = due;
+				}
+
+				_transactionCS.leave();
+
+				if (ownInFlight == 0 && nextToSend == count)
+					break;
+
+				for (size_t i = 0; i < toWrite.size(); i++)
+					scope.Port->write(toWrite[i]->Command.c_str(), toWrite[i]->Command.size());
+
+				// Other callers' commands completing do not signal us, so
+				// check for a free slot regularly while some are unsent.
+				if (nextToSend < count && (waitMs < 0 || waitMs * 1000 > CommandSlotPollUs))
+					waitMs = CommandSlotPollUs / 1000.f;
+
+				if (waitMs > 0)
+					done.waitUs(static_cast<uint32_t>(waitMs * 1000) + 1);
+			}
+		}
+		catch (...)
+		{
+			removePendingCommands(commands, count);
+			throw;
+		}
+
+		removePendingCommands(commands, count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			if (commands[i].TimedOut)
+				throw timeout();
+
+			if (commands[i].Response.isError())
+				throw sensor_error(commands[i].Response.parseError());
+		}
+	}
+
 	Packet transactionWithWait(char* toSend, size_t length, uint16_t responseTimeoutMs, uint16_t retransmitDelayMs)
 	{
-		// Make sure we don't have any existing responses.
+		PendingCommand c(string(toSend, length), responseTimeoutMs, retransmitDelayMs);
+
+		runCommands(&c, 1);
+
+		return c.Response;
+	}
+
+	// Sends already finalized commands pipelined and returns their responses
+	// in the same order.
+	vector<Packet> transactionBatch(const vector<string>& toSend, uint16_t responseTimeoutMs, uint16_t retransmitDelayMs)
+	{
+		if (!isConnected())
+			throw invalid_operation();
+
+		vector<PendingCommand> commands;
+		commands.reserve(toSend.size());
+
+		for (size_t i = 0; i < toSend.size(); i++)
+			commands.push_back(PendingCommand(toSend[i], responseTimeoutMs, retransmitDelayMs));
+
+		vector<Packet> responses;
+
+		if (commands.empty())
+			return responses;
+
+		runCommands(&commands[0], commands.size());
+
+		for (size_t i = 0; i < commands.size(); i++)
+			responses.push_back(commands[i].Response);
+
+		return responses;
+	}
+
+	// Queues an asynchronous command. Responses complete it on the serial
+	// thread; the async command thread only launches queued commands and
+	// handles retransmits and timeouts.
+	void queueAsyncCommand(PendingCommand* command)
+	{
+		if (!isConnected())
+		{
+			delete command->Promise;
+			delete command;
+
+			throw invalid_operation();
+		}
+
 		_transactionCS.enter();
 
-		#if VN_SUPPORTS_SWAP
-		queue<Packet> empty;
-		_receivedResponses.swap(empty);
-		#else
-		while (!_receivedResponses.empty()) _receivedResponses.pop();
-		#endif
-		_waitingForResponse = true;
+		ensureCommandThread();
+
+		_queuedAsyncCommands.push_back(command);
+
+		_transactionCS.leave();
+
+		_commandThreadEvent.signal();
+	}
+
+	future<Packet> sendAsync(const string& command)
+	{
+		PendingCommand* c = new PendingCommand(command, _responseTimeoutMs, _retransmitDelayMs);
+		c->Promise = new promise<Packet>();
+
+		future<Packet> f = c->Promise->get_future();
+
+		queueAsyncCommand(c);
+
+		return f;
+	}
+
+	void stopCommandThread()
+	{
+		_transactionCS.enter();
+		Thread* t = _commandThread;
+		_continueCommandThread = false;
+		_transactionCS.leave();
+
+		if (t == NULL)
+			return;
+
+		_commandThreadEvent.signal();
+		t->join();
+
+		// ensureCommandThread reads it under the lock.
+		_transactionCS.enter();
+		_commandThread = NULL;
 		_transactionCS.leave();
 
-		// Send the command and continue sending if retransmits are enabled
-		// until we receive the response or timeout.
-		Stopwatch timeoutSw;
+		delete t;
+	}
 
-		port->write(toSend, length);
-		float curElapsedTime = timeoutSw.elapsedMs();
+	static void commandThread(void* data)
+	{
+		static_cast<Impl*>(data)->commandThread();
+	}
 
-		while (true)
+	void commandThread()
+	{
+		while (_continueCommandThread)
 		{
-			bool shouldRetransmit = false;
+			dispatchResponses();
+
+			vector<PendingCommand*> toWrite;
+			vector<PendingCommand*> expired;
+			float waitMs = MaxAsyncCommandWaitUs / 1000.f;
+			float now = _asyncCommandClock.elapsedMs();
+
+			_transactionCS.enter();
 
-			// Compute how long we should wait for a response before taking
-			// more action.
-			float responseWaitTime = responseTimeoutMs - curElapsedTime;
-			if (responseWaitTime > retransmitDelayMs)
+			list<PendingCommand*>::iterator it = _pendingCommands.begin();
+			while (it != _pendingCommands.end())
 			{
-				responseWaitTime = retransmitDelayMs;
-				shouldRetransmit = true;
+				PendingCommand* c = *it;
+
+				if (c->Completed || !c->isAsync())
+				{
+					++it;
+					continue;
+				}
+
+				if (now - c->FirstSentMs >= c->ResponseTimeoutMs)
+				{
+					c->Completed = true;
+					c->TimedOut = true;
+					expired.push_back(c);
+					it = _pendingCommands.erase(it);
+					continue;
+				}
+
+				if (c->RetransmitDelayMs > 0 && now - c->LastSentMs >= c->RetransmitDelayMs)
+				{
+					c->LastSentMs = now;
+					toWrite.push_back(c);
+				}
+
+				float due = c->FirstSentMs + c->ResponseTimeoutMs - now;
+
+				if (c->RetransmitDelayMs > 0 && c->LastSentMs + c->RetransmitDelayMs - now < due)
+					due = c->LastSentMs + c->RetransmitDelayMs - now;
+
+				if (due < waitMs)
+					waitMs = due;
+
+				++it;
 			}
 
-			// See if we have time left.
-			if (responseWaitTime < 0)
+			size_t inFlight = commandsInFlight();
+
+			while (!_queuedAsyncCommands.empty() && inFlight < _maxCommandsInFlight)
 			{
-				_waitingForResponse = false;
-				throw timeout();
+				PendingCommand* c = _queuedAsyncCommands.front();
+				_queuedAsyncCommands.pop_front();
+
+				c->FirstSentMs = c->LastSentMs = now;
+				_pendingCommands.push_back(c);
+				toWrite.push_back(c);
+				inFlight++;
+
+				float due = c->RetransmitDelayMs > 0 && c->RetransmitDelayMs < c->ResponseTimeoutMs ? c->RetransmitDelayMs : c->ResponseTimeoutMs;
+
+				if (due < waitMs)
+					waitMs = due;
 			}
 
-			// Wait for any new responses that come in or until it is time to
-			// send a new retransmit.
-			xplat::Event::WaitResult waitResult = _newResponsesEvent.waitUs(static_cast<uint32_t>(responseWaitTime * 1000));
+			_numOfPendingCommands = _pendingCommands.size();
+
+			bool queueWaiting = !_queuedAsyncCommands.empty();
 
-			queue<Packet> responsesToProcess;
+			_transactionCS.leave();
 
-			if (waitResult == xplat::Event::WAIT_TIMEDOUT)
+			// Slots freed by runCommands do not signal us.
+			if (queueWaiting && waitMs * 1000 > CommandSlotPollUs)
+				waitMs = CommandSlotPollUs / 1000.f;
+
+			// A write failing here, or the port being released, just leaves
+			// the command to time out.
+			if (!toWrite.empty())
 			{
-				if (!shouldRetransmit)
+				PortScope scope(this);
+
+				try
 				{
-					_waitingForResponse = false;
-					throw timeout();
+					for (size_t i = 0; scope.Port != NULL && i < toWrite.size(); i++)
+						scope.Port->write(toWrite[i]->Command.c_str(), toWrite[i]->Command.size());
 				}
+				catch (...) { }
 			}
 
-			if (waitResult == xplat::Event::WAIT_SIGNALED)
+			for (size_t i = 0; i < expired.size(); i++)
+				expired[i]->completeAsync();
+
+			if (waitMs > 0)
+				_commandThreadEvent.waitUs(static_cast<uint32_t>(waitMs * 1000) + 1);
+		}
+
+		// Anything still outstanding fails as timed out.
+		vector<PendingCommand*> abandoned;
+
+		_transactionCS.enter();
+
+		abandoned.insert(abandoned.end(), _queuedAsyncCommands.begin(), _queuedAsyncCommands.end());
+		_queuedAsyncCommands.clear();
+
+		list<PendingCommand*>::iterator it = _pendingCommands.begin();
+		while (it != _pendingCommands.end())
+		{
+			if ((*it)->isAsync() && !(*it)->Completed)
 			{
-				// Get the current collection of responses.
-				_transactionCS.enter();
-				#if VN_SUPPORTS_SWAP
-				_receivedResponses.swap(responsesToProcess);
-				#else
-				while (!_receivedResponses.empty())
-				{
-					responsesToProcess.push(_receivedResponses.front());
-					_receivedResponses.pop();
-				}
-				#endif
-				_transactionCS.leave();
+				abandoned.push_back(*it);
+				it = _pendingCommands.erase(it);
+			}
+			else
+			{
+				++it;
 			}
+		}
+
+		_numOfPendingCommands = _pendingCommands.size();
+
+		_transactionCS.leave();
+
+		for (size_t i = 0; i < abandoned.size(); i++)
+		{
+			abandoned[i]->Completed = true;
+			abandoned[i]->TimedOut = true;
+			abandoned[i]->completeAsync();
+		}
+	}
+
+	static int64_t monotonicNs()
+	{
+		return TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC).totalNs();
+	}
+
+	static bool deviceNodeExists(const string& portName)
+	{
+		#if _WIN32
+
+		// COM ports have no file system node to look at, so a port is
+		// considered present and reconnecting simply retries.
+		return true;
+
+		#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+
+		struct stat st;
+
+		return stat(portName.c_str(), &st) == 0;
+
+		#else
+		#error "Unknown System"
+		#endif
+	}
+
+	void startSupervisor(const string& portName, uint32_t baudrate, uint32_t streamLossTimeoutMs, const ConfigurationProfile& profile, ReconnectedHandler handler, void* userData)
+	{
+		_supervisedPortName = portName;
+		_supervisedBaudrate = baudrate;
+		_streamLossTimeoutMs = streamLossTimeoutMs;
+		_supervisorProfile = profile;
+		_reconnectedHandler = handler;
+		_reconnectedUserData = userData;
+		_lastPacketNs = monotonicNs();
+		_continueSupervising = true;
+
+		_supervisorThread = Thread::startNew(supervisorThread, this);
+	}
+
+	void stopSupervisor()
+	{
+		if (_supervisorThread == NULL)
+			return;
+
+		_continueSupervising = false;
+		_supervisorThread->join();
+
+		delete _supervisorThread;
+		_supervisorThread = NULL;
+	}
+
+	// Closes the port after the sensor went away. The port may already be
+	// unusable, so failures are ignored.
+	void dropConnection()
+	{
+		stopCommandThread();
+
+		releasePort(true);
+	}
+
+	// Finds the sensor on the supervised port again, restores its baudrate
+	// and brings its registers back in line with the supervisor's profile.
+	bool tryReconnect(ReconnectInfo& info)
+	{
+		if (!deviceNodeExists(_supervisedPortName))
+			return false;
+
+		try
+		{
+			vector<uint32_t> likely;
+			likely.push_back(_supervisedBaudrate);
+
+			if (!_baudCacheFile.empty())
+				likely.push_back(readCachedBaudrate(_baudCacheFile, _supervisedPortName));
+
+			uint32_t foundBaudrate;
+
+			if (!Searcher::quickSearch(_supervisedPortName, likely, &foundBaudrate))
+				return false;
+
+			BackReference->connect(_supervisedPortName, foundBaudrate);
+
+			if (foundBaudrate != _supervisedBaudrate)
+				BackReference->changeBaudRate(_supervisedBaudrate);
+
+			ConfigurationSession session(*BackReference);
+
+			ConfigurationResult result = BackReference->applyConfiguration(_supervisorProfile);
+
+			session.resume();
 
-			// Process the collection of responses we have.
-			while (!responsesToProcess.empty())
+			info.baudrate = _supervisedBaudrate;
+			info.changedRegisters = result.changedRegisters;
+
+			return true;
+		}
+		catch (...)
+		{
+			dropConnection();
+
+			return false;
+		}
+	}
+
+	static void supervisorThread(void* data)
+	{
+		static_cast<Impl*>(data)->supervisorThread();
+	}
+
+	void supervisorThread()
+	{
+		#if __linux__
+
+		// Watching the port's directory reports the device node going away
+		// and coming back without waiting for the stream timeout.
+		size_t slash = _supervisedPortName.rfind('/');
+		string directory = slash == string::npos ? string(".") : slash == 0 ? string("/") : _supervisedPortName.substr(0, slash);
+
+		int notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+		if (notifyFd != -1)
+			inotify_add_watch(notifyFd, directory.c_str(), IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO);
+
+		#endif
+
+		uint64_t numOfReconnects = 0;
+		bool connected = true;
+		int64_t lostNs = 0;
+		Stopwatch reconnectClock;
+
+		while (_continueSupervising)
+		{
+			uint32_t waitMs = connected ? SupervisorCheckIntervalMs : ReconnectRetryDelayMs;
+
+			#if __linux__
+
+			if (notifyFd != -1)
 			{
-				Packet p = responsesToProcess.front();
-				responsesToProcess.pop();
+				struct pollfd pfd;
+				pfd.fd = notifyFd;
+				pfd.events = POLLIN;
 
-				if (p.isError())
+				if (poll(&pfd, 1, waitMs) > 0)
 				{
-					_waitingForResponse = false;
-					throw sensor_error(p.parseError());
+					char events[1024];
+
+					while (read(notifyFd, events, sizeof(events)) > 0) { }
 				}
+			}
+			else
+			{
+				Thread::sleepMs(waitMs);
+			}
 
-				// We must have a response packet.
-				_waitingForResponse = false;
-				return p;
+			#else
+
+			Thread::sleepMs(waitMs);
+
+			#endif
+
+			if (!_continueSupervising)
+				break;
+
+			if (connected)
+			{
+				bool silent = monotonicNs() - _lastPacketNs > static_cast<int64_t>(_streamLossTimeoutMs) * 1000000;
+
+				if ((!silent || _asyncOutputsPaused) && deviceNodeExists(_supervisedPortName))
+					continue;
+
+				lostNs = _lastPacketNs;
+				reconnectClock.reset();
+				connected = false;
+
+				dropConnection();
 			}
 
-			// Retransmit.
-			port->write(toSend, length);
-			curElapsedTime = timeoutSw.elapsedMs();
+			ReconnectInfo info;
+
+			if (!tryReconnect(info))
+				continue;
+
+			connected = true;
+			_asyncOutputsPaused = false;
+			_lastPacketNs = monotonicNs();
+
+			info.reconnectMs = reconnectClock.elapsedMs();
+			info.outageMs = (_lastPacketNs - lostNs) / 1e6;
+			info.numOfReconnects = ++numOfReconnects;
+
+			if (_reconnectedHandler != NULL)
+				_reconnectedHandler(_reconnectedUserData, info);
 		}
+
+		#if __linux__
+
+		if (notifyFd != -1)
+			close(notifyFd);
+
+		#endif
 	}
 
 	void transactionNoFinalize(char* toSend, size_t length, bool waitForReply, Packet *response, uint16_t responseTimeoutMs, uint16_t retransmitDelayMs)
@@ -385,7 +1398,12 @@ struct VnSensor::Impl
 		}
 		else
 		{
-			port->write(toSend, length);
+			PortScope scope(this);
+
+			if (scope.Port == NULL)
+				throw invalid_operation();
+
+			scope.Port->write(toSend, length);
 		}
 	}
 
@@ -570,22 +1588,47 @@ VnSensor::~VnSensor()
 	}
 }
 
-uint32_t VnSensor::baudrate()
+uint32_t VnSensor::baudrate()
+{
+	Impl::PortScope scope(_pi);
+
+	if (scope.Serial == NULL)
+		// We are not connected to a known serial port.
+		throw invalid_operation();
+
+	return scope.Serial->baudrate();
+}
+
+std::string VnSensor::port()
 {
-	if (_pi->pSerialPort == NULL)
+	Impl::PortScope scope(_pi);
+
+	if (scope.Serial == NULL)
 		// We are not connected to a known serial port.
 		throw invalid_operation();
 
-	return _pi->pSerialPort->baudrate();
+	return scope.Serial->port();
 }
 
-std::string VnSensor::port()
+SerialPort::LineStatistics VnSensor::lineStatistics()
 {
-	if (_pi->pSerialPort == NULL)
+	Impl::PortScope scope(_pi);
+
+	if (scope.Serial == NULL)
 		// We are not connected to a known serial port.
 		throw invalid_operation();
 
-	return _pi->pSerialPort->port();
+	return scope.Serial->lineStatistics();
+}
+
+void VnSensor::setNotificationDriver(SerialPort::NotificationDriver* driver)
+{
+	_pi->_notificationDriver = driver;
+
+	Impl::PortScope scope(_pi);
+
+	if (scope.Serial != NULL)
+		scope.Serial->setNotificationDriver(driver);
 }
 
 ErrorDetectionMode VnSensor::sendErrorDetectionMode()
@@ -623,6 +1666,19 @@ void VnSensor::setRetransmitDelayMs(uint16_t delay)
 	_pi->_retransmitDelayMs = delay;
 }
 
+size_t VnSensor::maxCommandsInFlight()
+{
+	return _pi->_maxCommandsInFlight;
+}
+
+void VnSensor::setMaxCommandsInFlight(size_t count)
+{
+	if (count == 0)
+		throw invalid_argument("count");
+
+	_pi->_maxCommandsInFlight = count;
+}
+
 bool VnSensor::verifySensorConnectivity()
 {
 	try
@@ -638,52 +1694,69 @@ bool VnSensor::verifySensorConnectivity()
 
 void VnSensor::connect(const string &portName, uint32_t baudrate)
 {
-	_pi->pSerialPort = new SerialPort(portName, baudrate);
+	SerialPort* serialPort = new SerialPort(portName, baudrate);
+	serialPort->setNotificationDriver(_pi->_notificationDriver);
 
-	connect(dynamic_cast<IPort*>(_pi->pSerialPort));
+	_pi->attachPort(serialPort, serialPort);
 }
 
 void VnSensor::connect(IPort* simplePort)
 {
-	_pi->port = simplePort;
-	_pi->SimplePortIsOurs = false;
+	_pi->attachPort(simplePort, NULL);
+}
+
+uint32_t VnSensor::connectFast(const string &portName, const string &baudCacheFile, uint32_t likelyBaudrate)
+{
+	vector<uint32_t> likely;
 
-	_pi->port->registerDataReceivedHandler(_pi, Impl::dataReceivedHandler);
+	if (!baudCacheFile.empty())
+		likely.push_back(readCachedBaudrate(baudCacheFile, portName));
 
-	if (!_pi->port->isOpen())
-	{
-		_pi->port->open();
-		_pi->DidWeOpenSimplePort = true;
-	}
+	likely.push_back(likelyBaudrate);
+
+	uint32_t foundBaudrate;
+
+	if (!Searcher::quickSearch(portName, likely, &foundBaudrate))
+		throw not_found("No VectorNav sensor found on " + portName + ".");
+
+	connect(portName, foundBaudrate);
+
+	_pi->_baudCacheFile = baudCacheFile;
+
+	if (!baudCacheFile.empty() && likely[0] != foundBaudrate)
+		writeCachedBaudrate(baudCacheFile, portName, foundBaudrate);
+
+	return foundBaudrate;
 }
 
-void VnSensor::disconnect()
+void VnSensor::enableSupervisor(uint32_t expectedPeriodMs, uint32_t missedPeriods, const ConfigurationProfile& profile, ReconnectedHandler handler, void* userData)
 {
-	if (_pi->port == NULL || !_pi->port->isOpen())
+	Impl::PortScope scope(_pi);
+
+	if (scope.Serial == NULL || !scope.Serial->isOpen() || _pi->_supervisorThread != NULL)
 		throw invalid_operation();
 
-	_pi->port->unregisterDataReceivedHandler();
+	_pi->startSupervisor(scope.Serial->port(), scope.Serial->baudrate(), expectedPeriodMs * missedPeriods, profile, handler, userData);
+}
 
-	if (_pi->DidWeOpenSimplePort)
-	{
-		_pi->port->close();
-	}
+void VnSensor::disableSupervisor()
+{
+	_pi->stopSupervisor();
+}
 
-	_pi->DidWeOpenSimplePort = false;
+void VnSensor::disconnect()
+{
+	// Stop the supervisor first so it does not reconnect behind our back.
+	_pi->stopSupervisor();
 
-	if (_pi->SimplePortIsOurs)
-	{
-		delete _pi->port;
+	if (!_pi->isConnected())
+		throw invalid_operation();
 
-		_pi->port = NULL;
-	}
+	_pi->stopCommandThread();
 
-	if (_pi->pSerialPort != NULL)
-	{
-		// Assuming we created this serial port.
-		delete _pi->pSerialPort;
-		_pi->pSerialPort = NULL;
-	}
+	_pi->_baudCacheFile.clear();
+
+	_pi->releasePort(false);
 }
 
 string VnSensor::transaction(string toSend)
@@ -713,93 +1786,210 @@ string VnSensor::transaction(string toSend)
 	return response.datastr();
 }
 
-string VnSensor::send(string toSend, bool waitForReply, ErrorDetectionMode errorDetectionMode)
+// Completes a user supplied command with the leading '$', error detection
+// and line ending as needed.
+static string completeCommand(string toSend, ErrorDetectionMode errorDetectionMode)
 {
-	Packet p;
-	char *buffer = new char[toSend.size() + 8];	// Extra room for possible additions.
-	size_t curToSendLength = toSend.size();
-
 	// See if a '$' needs to be prepended.
-	if (toSend[0] == '$')
-	{
-		#if VN_HAVE_SECURE_SCL
-		toSend._Copy_s(buffer, toSend.size() + 8, toSend.size());
-		#else
-		toSend.copy(buffer, toSend.size());
-		#endif
-
-	}
-	else
-	{
-		buffer[0] = '$';
-		#if VN_HAVE_SECURE_SCL
-		toSend._Copy_s(buffer + 1, toSend.size() + 8 - 1, toSend.size());
-		#else
-		toSend.copy(buffer + 1, toSend.size());
-		#endif
-		curToSendLength++;
-	}
-
-	// Locate any '*' in the command.
-	size_t astrickLocation = string::npos;
-	for (size_t i = 0; i < curToSendLength; i++)
-	{
-		if (buffer[i] == '*')
-		{
-			astrickLocation = i;
-			break;
-		}
-	}
+	if (toSend.empty() || toSend[0] != '$')
+		toSend.insert(0, 1, '$');
 
 	// Do we need to add a '*'?
+	size_t astrickLocation = toSend.find('*');
 	if (astrickLocation == string::npos)
 	{
-		buffer[curToSendLength] = '*';
-		astrickLocation = curToSendLength++;
+		toSend += '*';
+		astrickLocation = toSend.size() - 1;
 	}
 
 	// Do we need to add a checksum/CRC?
-	if (astrickLocation == curToSendLength - 1)
+	if (astrickLocation == toSend.size() - 1)
 	{
+		char suffix[8];
+
 		if (errorDetectionMode == ERRORDETECTIONMODE_CHECKSUM)
 		{
 			#if VN_HAVE_SECURE_CRT
-			curToSendLength += sprintf_s(buffer + curToSendLength, toSend.size() + 8 - curToSendLength, "%02X\r\n", Checksum8::compute(buffer + 1, curToSendLength - 2));
+			sprintf_s(suffix, sizeof(suffix), "%02X\r\n", Checksum8::compute(toSend.c_str() + 1, toSend.size() - 2));
 			#else
-			curToSendLength += sprintf(buffer + curToSendLength, "%02X\r\n", Checksum8::compute(buffer + 1, curToSendLength - 2));
+			sprintf(suffix, "%02X\r\n", Checksum8::compute(toSend.c_str() + 1, toSend.size() - 2));
 			#endif
 		}
 		else if (errorDetectionMode == ERRORDETECTIONMODE_CRC)
 		{
 			#if VN_HAVE_SECURE_CRT
-			curToSendLength += sprintf_s(buffer + curToSendLength, toSend.size() + 8 - curToSendLength, "%04X\r\n", Crc16::compute(buffer + 1, curToSendLength - 2));
+			sprintf_s(suffix, sizeof(suffix), "%04X\r\n", Crc16::compute(toSend.c_str() + 1, toSend.size() - 2));
 			#else
-			curToSendLength += sprintf(buffer + curToSendLength, "%04X\r\n", Crc16::compute(buffer + 1, curToSendLength - 2));
+			sprintf(suffix, "%04X\r\n", Crc16::compute(toSend.c_str() + 1, toSend.size() - 2));
 			#endif
 		}
 		else
 		{
 			#if VN_HAVE_SECURE_CRT
-			curToSendLength += sprintf_s(buffer + curToSendLength, toSend.size() + 8 - curToSendLength, "*XX\r\n");
+			sprintf_s(suffix, sizeof(suffix), "XX\r\n");
 			#else
-			curToSendLength += sprintf(buffer + curToSendLength, "*XX\r\n");
+			sprintf(suffix, "XX\r\n");
 			#endif
 		}
+
+		toSend += suffix;
 	}
 	// Do we need to add "\r\n"?
-	else if (buffer[curToSendLength - 1] != '\n')
+	else if (toSend[toSend.size() - 1] != '\n')
 	{
-		buffer[curToSendLength++] = '\r';
-		buffer[curToSendLength++] = '\n';
+		toSend += "\r\n";
 	}
 
-	_pi->transactionNoFinalize(buffer, curToSendLength, waitForReply, &p, _pi->_responseTimeoutMs, _pi->_retransmitDelayMs);
+	return toSend;
+}
+
+string VnSensor::send(string toSend, bool waitForReply, ErrorDetectionMode errorDetectionMode)
+{
+	Packet p;
+	string command = completeCommand(toSend, errorDetectionMode);
 
-	delete [] buffer;
+	_pi->transactionNoFinalize(&command[0], command.size(), waitForReply, &p, _pi->_responseTimeoutMs, _pi->_retransmitDelayMs);
 
 	return p.datastr();
 }
 
+vector<string> VnSensor::sendBatch(const vector<string>& commands, ErrorDetectionMode errorDetectionMode)
+{
+	vector<string> toSend;
+
+	for (size_t i = 0; i < commands.size(); i++)
+		toSend.push_back(completeCommand(commands[i], errorDetectionMode));
+
+	vector<Packet> responses = _pi->transactionBatch(toSend, _pi->_responseTimeoutMs, _pi->_retransmitDelayMs);
+
+	vector<string> results;
+
+	for (size_t i = 0; i < responses.size(); i++)
+		results.push_back(responses[i].datastr());
+
+	return results;
+}
+
+future<Packet> VnSensor::sendAsync(const string& toSend, ErrorDetectionMode errorDetectionMode)
+{
+	return _pi->sendAsync(completeCommand(toSend, errorDetectionMode));
+}
+
+void VnSensor::sendAsync(const string& toSend, ResponseReceivedHandler handler, void* userData, ErrorDetectionMode errorDetectionMode)
+{
+	Impl::PendingCommand* c = new Impl::PendingCommand(completeCommand(toSend, errorDetectionMode), _pi->_responseTimeoutMs, _pi->_retransmitDelayMs);
+	c->Handler = handler;
+	c->HandlerUserData = userData;
+
+	_pi->queueAsyncCommand(c);
+}
+
+// Builds the start of a register command, e.g. "VNRRG,7".
+static string registerCommand(const char* type, uint8_t registerId)
+{
+	char buffer[16];
+
+	#if VN_HAVE_SECURE_CRT
+	sprintf_s(buffer, sizeof(buffer), "%s,%u", type, registerId);
+	#else
+	sprintf(buffer, "%s,%u", type, registerId);
+	#endif
+
+	return buffer;
+}
+
+ConfigurationResult VnSensor::applyConfiguration(const ConfigurationProfile& profile)
+{
+	ConfigurationResult result;
+	Stopwatch sw;
+	const vector<ConfigurationProfile::Entry>& entries = profile.entries();
+	vector<string> reads;
+	vector<string> writes;
+
+	for (size_t i = 0; i < entries.size(); i++)
+		reads.push_back(completeCommand(registerCommand("VNRRG", entries[i].registerId), _pi->_sendErrorDetectionMode));
+
+	vector<Packet> current = _pi->transactionBatch(reads, _pi->_responseTimeoutMs, _pi->_retransmitDelayMs);
+
+	result.readMs = sw.elapsedMs();
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		// Responses look like "$VNRRG,07,200*XX".
+		string r = current[i].datastr();
+		size_t start = r.find(',', 7);
+		size_t end = r.find('*');
+		string fields = start == string::npos || end == string::npos || start > end ? string() : r.substr(start + 1, end - start - 1);
+
+		if (ConfigurationProfile::fieldsMatch(fields, entries[i].fields))
+			continue;
+
+		writes.push_back(completeCommand(registerCommand("VNWRG", entries[i].registerId) + "," + entries[i].fields, _pi->_sendErrorDetectionMode));
+		result.changedRegisters.push_back(entries[i].registerId);
+	}
+
+	if (!writes.empty())
+	{
+		_pi->transactionBatch(writes, _pi->_responseTimeoutMs, _pi->_retransmitDelayMs);
+
+		if (profile.persist())
+		{
+			writeSettings(true);
+			result.settingsWritten = true;
+		}
+	}
+
+	result.elapsedMs = sw.elapsedMs();
+	result.writeMs = result.elapsedMs - result.readMs;
+
+	return result;
+}
+
+future<Packet> VnSensor::tareAsync()
+{
+	char toSend[14];
+
+	size_t length = Packet::genTare(_pi->_sendErrorDetectionMode, toSend, sizeof(toSend));
+
+	return _pi->sendAsync(string(toSend, length));
+}
+
+future<Packet> VnSensor::setGyroBiasAsync()
+{
+	char toSend[14];
+
+	size_t length = Packet::genSetGyroBias(_pi->_sendErrorDetectionMode, toSend, sizeof(toSend));
+
+	return _pi->sendAsync(string(toSend, length));
+}
+
+future<Packet> VnSensor::magneticDisturbancePresentAsync(bool disturbancePresent)
+{
+	char toSend[16];
+
+	size_t length = Packet::genKnownMagneticDisturbance(_pi->_sendErrorDetectionMode, toSend, sizeof(toSend), disturbancePresent);
+
+	return _pi->sendAsync(string(toSend, length));
+}
+
+future<Packet> VnSensor::accelerationDisturbancePresentAsync(bool disturbancePresent)
+{
+	char toSend[16];
+
+	size_t length = Packet::genKnownAccelerationDisturbance(_pi->_sendErrorDetectionMode, toSend, sizeof(toSend), disturbancePresent);
+
+	return _pi->sendAsync(string(toSend, length));
+}
+
+future<Packet> VnSensor::writeFilterActiveTuningParametersAsync(FilterActiveTuningParametersRegister &fields)
+{
+	char toSend[256];
+
+	size_t length = Packet::genWriteFilterActiveTuningParameters(_pi->_sendErrorDetectionMode, toSend, sizeof(toSend), fields.magneticDisturbanceGain, fields.accelerationDisturbanceGain, fields.magneticDisturbanceMemory, fields.accelerationDisturbanceMemory);
+
+	return _pi->sendAsync(string(toSend, length));
+}
+
 void VnSensor::registerRawDataReceivedHandler(void* userData, RawDataReceivedHandler handler)
 {
 	if (_pi->_rawDataReceivedHandler != NULL)
@@ -886,6 +2076,142 @@ void VnSensor::unregisterAsyncPacketReceivedHandler()
 	_pi->_asyncPacketReceivedUserData = NULL;
 }
 
+void VnSensor::registerTimedAsyncPacketReceivedHandler(void* userData, TimedAsyncPacketReceivedHandler handler)
+{
+	if (_pi->_timedAsyncPacketReceivedHandler != NULL)
+		throw invalid_operation();
+
+	_pi->_timedAsyncPacketReceivedHandler = handler;
+	_pi->_timedAsyncPacketReceivedUserData = userData;
+}
+
+void VnSensor::unregisterTimedAsyncPacketReceivedHandler()
+{
+	if (_pi->_timedAsyncPacketReceivedHandler == NULL)
+		throw invalid_operation();
+
+	_pi->_timedAsyncPacketReceivedHandler = NULL;
+	_pi->_timedAsyncPacketReceivedUserData = NULL;
+}
+
+VnSensor::AsyncPacketFilter::AsyncPacketFilter() :
+	type(Packet::TYPE_UNKNOWN),
+	asciiType(VNOFF),
+	matchLayout(false)
+{ }
+
+VnSensor::AsyncPacketFilter VnSensor::AsyncPacketFilter::ascii(AsciiAsync type)
+{
+	AsyncPacketFilter f;
+	f.type = Packet::TYPE_ASCII;
+	f.asciiType = type;
+
+	return f;
+}
+
+VnSensor::AsyncPacketFilter VnSensor::AsyncPacketFilter::binary()
+{
+	AsyncPacketFilter f;
+	f.type = Packet::TYPE_BINARY;
+
+	return f;
+}
+
+VnSensor::AsyncPacketFilter VnSensor::AsyncPacketFilter::binary(const BinaryOutputRegister& layout)
+{
+	AsyncPacketFilter f;
+	f.type = Packet::TYPE_BINARY;
+	f.matchLayout = true;
+	f.layout = layout;
+
+	return f;
+}
+
+bool VnSensor::AsyncPacketFilter::matches(Packet& packet) const
+{
+	if (type == Packet::TYPE_UNKNOWN)
+		return true;
+
+	if (packet.type() != type)
+		return false;
+
+	if (type == Packet::TYPE_ASCII)
+		return asciiType == VNOFF || packet.determineAsciiAsyncType() == asciiType;
+
+	return !matchLayout || packet.isCompatible(
+		layout.commonField,
+		layout.timeField,
+		layout.imuField,
+		layout.gpsField,
+		layout.attitudeField,
+		layout.insField,
+		layout.gps2Field);
+}
+
+size_t VnSensor::subscribeAsyncPackets(TimedAsyncPacketReceivedHandler handler, void* userData, const AsyncPacketFilter& filter)
+{
+	if (handler == NULL)
+		throw invalid_argument("handler");
+
+	Impl::Subscriber s;
+	s.Handler = handler;
+	s.UserData = userData;
+	s.Filter = filter;
+
+	_pi->_subscribersCS.enter();
+
+	s.Id = _pi->_nextSubscriptionId++;
+
+	const Impl::SubscriberList* current = _pi->_subscribers.load();
+	Impl::SubscriberList* updated = current != NULL ? new Impl::SubscriberList(*current) : new Impl::SubscriberList();
+	updated->push_back(s);
+
+	vector<const Impl::SubscriberList*> retired = _pi->replaceSubscribers(updated);
+
+	_pi->_subscribersCS.leave();
+
+	_pi->reclaimSubscribers(retired);
+
+	return s.Id;
+}
+
+void VnSensor::unsubscribeAsyncPackets(size_t subscriptionId)
+{
+	_pi->_subscribersCS.enter();
+
+	const Impl::SubscriberList* current = _pi->_subscribers.load();
+	Impl::SubscriberList* updated = new Impl::SubscriberList();
+
+	if (current != NULL)
+	{
+		for (size_t i = 0; i < current->size(); i++)
+		{
+			if ((*current)[i].Id != subscriptionId)
+				updated->push_back((*current)[i]);
+		}
+	}
+
+	if (current == NULL || updated->size() == current->size())
+	{
+		delete updated;
+		_pi->_subscribersCS.leave();
+
+		throw not_found("No subscription with this ID.");
+	}
+
+	if (updated->empty())
+	{
+		delete updated;
+		updated = NULL;
+	}
+
+	vector<const Impl::SubscriberList*> retired = _pi->replaceSubscribers(updated);
+
+	_pi->_subscribersCS.leave();
+
+	_pi->reclaimSubscribers(retired);
+}
+
 void VnSensor::registerErrorPacketReceivedHandler(void* userData, ErrorPacketReceivedHandler handler)
 {
 	if (_pi->_errorPacketReceivedHandler != NULL)
@@ -963,6 +2289,39 @@ void VnSensor::accelerationDisturbancePresent(bool disturbancePresent, bool wait
 	_pi->transactionNoFinalize(toSend, length, waitForReply, &response);
 }
 
+void VnSensor::setAsyncOutputsEnabled(bool enabled, bool waitForReply)
+{
+	char toSend[16];
+
+	size_t length = Packet::genAsyncOutputEnable(_pi->_sendErrorDetectionMode, toSend, sizeof(toSend), enabled);
+
+	Packet response;
+
+	// Flag the pause before the stream stops so the supervisor never sees
+	// the silence, and restart its timer when the stream comes back.
+	bool wasPaused = _pi->_asyncOutputsPaused;
+
+	if (!enabled)
+		_pi->_asyncOutputsPaused = true;
+
+	try
+	{
+		_pi->transactionNoFinalize(toSend, length, waitForReply, &response);
+	}
+	catch (...)
+	{
+		_pi->_asyncOutputsPaused = wasPaused;
+
+		throw;
+	}
+
+	if (enabled)
+	{
+		_pi->_lastPacketNs = Impl::monotonicNs();
+		_pi->_asyncOutputsPaused = false;
+	}
+}
+
 void VnSensor::restoreFactorySettings(bool waitForReply)
 {
 	char toSend[37];
@@ -993,7 +2352,17 @@ void VnSensor::changeBaudRate(uint32_t baudrate)
 {
     writeSerialBaudRate(baudrate, true);
 
-	_pi->pSerialPort->changeBaudrate(baudrate);
+	Impl::PortScope scope(_pi);
+
+	if (scope.Serial == NULL)
+		throw invalid_operation();
+
+	scope.Serial->changeBaudrate(baudrate);
+
+	_pi->_supervisedBaudrate = baudrate;
+
+	if (!_pi->_baudCacheFile.empty())
+		writeCachedBaudrate(_pi->_baudCacheFile, scope.Serial->port(), baudrate);
 }
 
 VnSensor::Family VnSensor::determineDeviceFamily()
@@ -3400,5 +4769,41 @@ void VnSensor::goRequest()
 
 #endif
 
+ConfigurationSession::ConfigurationSession(VnSensor& sensor) :
+	_sensor(sensor),
+	_paused(false)
+{
+	_sensor.setAsyncOutputsEnabled(false);
+
+	_paused = true;
+}
+
+ConfigurationSession::~ConfigurationSession()
+{
+	if (!_paused)
+		return;
+
+	try
+	{
+		resume();
+	}
+	catch (...)
+	{
+		// Don't want to throw out of the destructor, possibly while an
+		// exception from the configuration is already propagating.
+	}
+}
+
+void ConfigurationSession::resume()
+{
+	if (!_paused)
+		return;
+
+	// Still paused if this throws, so the destructor tries again.
+	_sensor.setAsyncOutputsEnabled(true);
+
+	_paused = false;
+}
+
 }
 }
@@ -31,6 +31,7 @@
 
 #include <list>
 #include <iostream>
+#include <atomic>
 
 #include "vn/thread.h"
 #include "vn/criticalsection.h"
@@ -56,6 +57,8 @@ struct SerialPort::Impl
 
 	static const uint8_t WaitTimeForSerialPortReadsInMs = 100;
 
+	static const uint32_t DefaultLineStatisticsSampleIntervalMs = 1000;
+
 	// Members ////////////////////////////////////////////////////////////////
 
 	#if _WIN32
@@ -89,7 +92,7 @@ struct SerialPort::Impl
 
 	Thread *pSerialPortEventsThread;
 
-	bool ContinueHandlingSerialPortEvents;
+	atomic<bool> ContinueHandlingSerialPortEvents;
 	bool ChangingBaudrate;
 	
 	bool PurgeFirstDataBytesWhenSerialPortIsFirstOpened;
@@ -103,6 +106,25 @@ struct SerialPort::Impl
 	Event WaitForBaudrateChange;
 	Event NotificationsThreadStopped;
 
+	// Services the port in place of the notifications thread when set.
+	NotificationDriver* Driver;
+	bool DriverAttached;
+
+	// Time the notifications thread woke up for the data being reported.
+	// Only accessed from the notifications thread.
+	TimeStamp DataReceivedTimestamp;
+
+	// Periodically sampled line counters. Guarded by StatisticsCS since they
+	// are written by the notifications thread and read by user code.
+	CriticalSection StatisticsCS;
+	LineStatistics Statistics;
+	uint32_t LineStatisticsSampleIntervalMs;
+	Stopwatch LineStatisticsSw;
+	#if __linux__
+	serial_icounter_struct LastICount;
+	bool HaveLastICount;
+	#endif
+
 	#if PYTHON && !PL156_ORIGINAL && !PL156_FIX_ATTEMPT_1
 	bool ExternalStopRequest;
 	bool ThreadStopped;
@@ -132,7 +154,14 @@ struct SerialPort::Impl
 		#endif
 		ThreadIsRunning(false),
 		BackReference(backReference),
-		stopBits(ONE_STOP_BIT)
+		stopBits(ONE_STOP_BIT),
+		Driver(NULL),
+		DriverAttached(false),
+		LineStatisticsSampleIntervalMs(DefaultLineStatisticsSampleIntervalMs)
+		#if __linux__
+		,
+		HaveLastICount(false)
+		#endif
 	{ }
 
 	~Impl()
@@ -371,6 +400,8 @@ struct SerialPort::Impl
 					break;
 				}
 
+				PollLineStatistics();
+
 				if (!FD_ISSET(SerialPortHandle, &readfs))
 					continue;
 
@@ -417,8 +448,113 @@ struct SerialPort::Impl
 			closeAfterUsbCableUnplugged();
 	}
 
+	#if __linux__
+
+	static uint32_t CounterDelta(int current, int last)
+	{
+		// The driver's counters restart from zero if the UART is
+		// reinitialized, in which case the current value is the delta.
+		uint32_t c = static_cast<uint32_t>(current);
+		uint32_t l = static_cast<uint32_t>(last);
+
+		return c >= l ? c - l : c;
+	}
+
+	void SampleLineStatistics()
+	{
+		serial_icounter_struct icount;
+
+		memset(&icount, 0, sizeof(serial_icounter_struct));
+
+		if (ioctl(SerialPortHandle, TIOCGICOUNT, &icount) == -1)
+			// Not all ttys support this (e.g. CDC-ACM and pseudo-terminals).
+			return;
+
+		TimeStamp now = TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC);
+
+		StatisticsCS.enter();
+
+		LineCounters d;
+
+		if (HaveLastICount)
+		{
+			d.rx = CounterDelta(icount.rx, LastICount.rx);
+			d.tx = CounterDelta(icount.tx, LastICount.tx);
+			d.frame = CounterDelta(icount.frame, LastICount.frame);
+			d.parity = CounterDelta(icount.parity, LastICount.parity);
+			d.brk = CounterDelta(icount.brk, LastICount.brk);
+			d.overrun = CounterDelta(icount.overrun, LastICount.overrun);
+			d.bufOverrun = CounterDelta(icount.buf_overrun, LastICount.buf_overrun);
+		}
+
+		LineCounters &t = Statistics.total;
+		t.rx += d.rx;
+		t.tx += d.tx;
+		t.frame += d.frame;
+		t.parity += d.parity;
+		t.brk += d.brk;
+		t.overrun += d.overrun;
+		t.bufOverrun += d.bufOverrun;
+
+		Statistics.delta = d;
+		Statistics.timestamp = now;
+		Statistics.numOfSamples++;
+
+		LastICount = icount;
+		HaveLastICount = true;
+
+		StatisticsCS.leave();
+	}
+
+	#endif
+
+	void PollLineStatistics()
+	{
+		#if __linux__
+
+		if (LineStatisticsSw.elapsedMs() >= LineStatisticsSampleIntervalMs)
+		{
+			LineStatisticsSw.reset();
+			SampleLineStatistics();
+		}
+
+		#endif
+	}
+
+	void ResetLineStatistics(bool clearTotals)
+	{
+		StatisticsCS.enter();
+
+		if (clearTotals)
+			Statistics = LineStatistics();
+
+		#if __linux__
+		HaveLastICount = false;
+		#endif
+
+		StatisticsCS.leave();
+
+		#if __linux__
+		// Take the baseline sample.
+		SampleLineStatistics();
+		LineStatisticsSw.reset();
+		#endif
+	}
+
 	void StartSerialPortNotificationsThread()
 	{
+		#if !_WIN32
+
+		if (Driver != NULL)
+		{
+			Driver->portOpened(*BackReference, SerialPortHandle);
+			DriverAttached = true;
+
+			return;
+		}
+
+		#endif
+
 		ContinueHandlingSerialPortEvents = true;
 
 		pSerialPortEventsThread = Thread::startNew(
@@ -440,18 +576,34 @@ struct SerialPort::Impl
 
 	void StopSerialPortNotificationsThread()
 	{
+		if (DriverAttached)
+		{
+			DriverAttached = false;
+			Driver->portClosing(*BackReference);
+
+			return;
+		}
+
 		ContinueHandlingSerialPortEvents = false;
 
 		pSerialPortEventsThread->join();
 
 		delete pSerialPortEventsThread;
+		pSerialPortEventsThread = NULL;
 	}
 
 	void OnDataReceived()
+	{
+		OnDataReceived(TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC));
+	}
+
+	void OnDataReceived(const TimeStamp& timestamp)
 	{
 		bool exception_happened = false;
 		exception rethrow;
 
+		DataReceivedTimestamp = timestamp;
+
 		ObserversCriticalSection.enter();
 
 		// This is a critical section block
@@ -743,6 +895,9 @@ struct SerialPort::Impl
 		if (checkAndToggleIsOpenFlag)
 			IsOpen = true;
 
+		// Totals are kept across baudrate changes.
+		ResetLineStatistics(checkAndToggleIsOpenFlag);
+
 		if (PurgeFirstDataBytesWhenSerialPortIsFirstOpened)
 			PurgeFirstDataBytesFromSerialPort();
 
@@ -1238,6 +1393,22 @@ SerialPort::StopBits SerialPort::stopBits()
 	return _pi->stopBits;
 }
 	
+TimeStamp SerialPort::dataReceivedTimestamp()
+{
+	return _pi->DataReceivedTimestamp;
+}
+
+uint32_t SerialPort::byteTimeNs()
+{
+	if (_pi->Baudrate == 0)
+		return 0;
+
+	// Start bit, 8 data bits and the stop bits.
+	uint32_t bitsPerByte = _pi->stopBits == TWO_STOP_BITS ? 11 : 10;
+
+	return static_cast<uint32_t>(bitsPerByte * 1000000000ULL / _pi->Baudrate);
+}
+
 void SerialPort::setStopBits(SerialPort::StopBits stopBits)
 {
 	_pi->ensureClosed();
@@ -1432,6 +1603,87 @@ size_t SerialPort::NumberOfReceiveDataDroppedSections()
 	#endif
 }
 
+SerialPort::LineStatistics SerialPort::lineStatistics()
+{
+	#if __linux__
+
+	_pi->StatisticsCS.enter();
+	LineStatistics s = _pi->Statistics;
+	_pi->StatisticsCS.leave();
+
+	return s;
+
+	#elif _WIN32
+
+	// Windows only tells us about RX overruns, and only as events.
+	LineStatistics s;
+	s.timestamp = TimeStamp::get(TimeStamp::CLOCKSOURCE_MONOTONIC);
+	s.total.overrun = static_cast<uint32_t>(_pi->NumberOfReceiveDataDroppedSections);
+
+	return s;
+
+	#elif __APPLE__ || __CYGWIN__ || __QNXNTO__
+
+	throw not_implemented();
+
+	#else
+	#error "Unknown System"
+	#endif
+}
+
+uint32_t SerialPort::lineStatisticsSampleIntervalMs()
+{
+	return _pi->LineStatisticsSampleIntervalMs;
+}
+
+void SerialPort::setLineStatisticsSampleIntervalMs(uint32_t intervalMs)
+{
+	_pi->LineStatisticsSampleIntervalMs = intervalMs;
+}
+
+void SerialPort::setNotificationDriver(NotificationDriver* driver)
+{
+	#if _WIN32
+
+	// Overlapped I/O events cannot be waited on together with other ports.
+	if (driver != NULL)
+		throw not_supported();
+
+	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
+
+	if (driver == _pi->Driver)
+		return;
+
+	if (_pi->IsOpen)
+		_pi->StopSerialPortNotificationsThread();
+
+	_pi->Driver = driver;
+
+	if (_pi->IsOpen)
+		_pi->StartSerialPortNotificationsThread();
+
+	#else
+	#error "Unknown System"
+	#endif
+}
+
+SerialPort::NotificationDriver* SerialPort::notificationDriver()
+{
+	return _pi->Driver;
+}
+
+void SerialPort::notifyDataReceived(const TimeStamp& timestamp)
+{
+	_pi->PollLineStatistics();
+
+	_pi->OnDataReceived(timestamp);
+}
+
+void SerialPort::pollLineStatistics()
+{
+	_pi->PollLineStatistics();
+}
+
 #if PYTHON && !PL156_ORIGINAL && !PL156_FIX_ATTEMPT_1
 
 void SerialPort::stopThread()
@@ -0,0 +1,484 @@
+#include "vn/threadpool.h"
+
+#if __linux__
+	#include <sys/prctl.h>
+#endif
+
+#include <deque>
+#include <list>
+#include <thread>
+#include <vector>
+
+#include "vn/exceptions.h"
+
+using namespace std;
+
+namespace vn {
+namespace xplat {
+
+namespace
+{
+	// How finely parallelFor splits its range per thread, so threads that
+	// finish early can take chunks from slower ones.
+	const size_t ChunksPerThread = 4;
+
+	// A worker waiting on a batch looks for jobs to help with this often,
+	// since the jobs it waits on may be queued behind other waiting workers.
+	const uint32_t HelpPollUs = 200;
+
+	struct Job
+	{
+		Thread::ThreadStartRoutine routine;
+		void* userData;
+		ThreadPool::Batch* batch;
+	};
+
+	struct RangeJob
+	{
+		ThreadPool::RangeRoutine routine;
+		void* userData;
+		size_t begin;
+		size_t end;
+	};
+
+	void runRange(void* routineData)
+	{
+		RangeJob* r = static_cast<RangeJob*>(routineData);
+
+		r->routine(r->userData, r->begin, r->end);
+	}
+
+	void nameThread(const char* name)
+	{
+		#if __linux__
+		prctl(PR_SET_NAME, name, 0, 0, 0);
+		#else
+		(void) name;
+		#endif
+	}
+}
+
+struct ThreadPool::Impl
+{
+	struct Worker
+	{
+		Impl* Pool;
+		CriticalSection CS;
+		deque<Job> Jobs;
+		Event Wake;
+		atomic<bool> Sleeping;
+		Thread* WorkerThread;
+
+		explicit Worker(Impl* pool) :
+			Pool(pool),
+			Sleeping(false),
+			WorkerThread(NULL)
+		{ }
+	};
+
+	struct Dedicated
+	{
+		Job Work;
+		Thread* JobThread;
+		atomic<bool> Finished;
+
+		explicit Dedicated(const Job& work) :
+			Work(work),
+			JobThread(NULL),
+			Finished(false)
+		{ }
+	};
+
+	vector<Worker*> Workers;
+	atomic<size_t> NextQueue;
+
+	// Jobs queued over all workers, so idle workers can tell there is
+	// nothing to steal without locking every queue.
+	atomic<size_t> NumOfQueued;
+
+	atomic<bool> Stopping;
+	CriticalSection DedicatedCS;
+	list<Dedicated*> DedicatedJobs;
+
+	Impl() :
+		NextQueue(0),
+		NumOfQueued(0),
+		Stopping(false)
+	{ }
+
+	static Worker*& currentWorker()
+	{
+		static thread_local Worker* worker = NULL;
+
+		return worker;
+	}
+
+	// The calling thread's worker if it belongs to this pool.
+	Worker* self()
+	{
+		Worker* w = currentWorker();
+
+		return w != NULL && w->Pool == this ? w : NULL;
+	}
+
+	void push(const Job& job)
+	{
+		Worker* w = self();
+
+		if (w == NULL)
+			w = Workers[NextQueue.fetch_add(1, memory_order_relaxed) % Workers.size()];
+
+		w->CS.enter();
+		w->Jobs.push_back(job);
+		NumOfQueued.fetch_add(1);
+		w->CS.leave();
+
+		// Pairs with the worker publishing that it sleeps before checking
+		// NumOfQueued one last time, so one of the two always notices.
+		if (w->Sleeping.exchange(false))
+		{
+			w->Wake.signal();
+			return;
+		}
+
+		for (size_t i = 0; i < Workers.size(); i++)
+		{
+			if (Workers[i]->Sleeping.exchange(false))
+			{
+				Workers[i]->Wake.signal();
+				return;
+			}
+		}
+	}
+
+	// Takes the newest job of the caller's own queue, or else the oldest job
+	// of another worker's.
+	bool tryPop(Worker* w, Job& job)
+	{
+		if (NumOfQueued.load() == 0)
+			return false;
+
+		if (w != NULL)
+		{
+			w->CS.enter();
+
+			if (!w->Jobs.empty())
+			{
+				job = w->Jobs.back();
+				w->Jobs.pop_back();
+				NumOfQueued.fetch_sub(1);
+				w->CS.leave();
+
+				return true;
+			}
+
+			w->CS.leave();
+		}
+
+		size_t start = NextQueue.load(memory_order_relaxed);
+
+		for (size_t i = 0; i < Workers.size(); i++)
+		{
+			Worker* victim = Workers[(start + i) % Workers.size()];
+
+			if (victim == w)
+				continue;
+
+			victim->CS.enter();
+
+			if (!victim->Jobs.empty())
+			{
+				job = victim->Jobs.front();
+				victim->Jobs.pop_front();
+				NumOfQueued.fetch_sub(1);
+				victim->CS.leave();
+
+				return true;
+			}
+
+			victim->CS.leave();
+		}
+
+		return false;
+	}
+
+	static void run(const Job& job)
+	{
+		job.routine(job.userData);
+
+		if (job.batch == NULL)
+			return;
+
+		Batch* b = job.batch;
+
+		b->_finishing.enter();
+
+		if (b->_pending.fetch_sub(1) == 1)
+			b->_done.signal();
+
+		b->_finishing.leave();
+	}
+
+	static void workerThread(void* routineData)
+	{
+		Worker* w = static_cast<Worker*>(routineData);
+		Impl* pool = w->Pool;
+
+		currentWorker() = w;
+		nameThread("vnpool");
+
+		for (;;)
+		{
+			Job job;
+
+			if (pool->tryPop(w, job))
+			{
+				run(job);
+				continue;
+			}
+
+			if (pool->Stopping.load())
+				break;
+
+			w->Sleeping.store(true);
+
+			if (pool->NumOfQueued.load() != 0 || pool->Stopping.load())
+			{
+				w->Sleeping.store(false);
+				continue;
+			}
+
+			w->Wake.wait();
+			w->Sleeping.store(false);
+		}
+
+		currentWorker() = NULL;
+	}
+
+	static void dedicatedThread(void* routineData)
+	{
+		Dedicated* d = static_cast<Dedicated*>(routineData);
+
+		nameThread("vnjob");
+
+		run(d->Work);
+
+		d->Finished.store(true);
+	}
+
+	// Joins the dedicated threads that have finished. Must be called with
+	// DedicatedCS held.
+	void reapDedicated(bool all)
+	{
+		for (list<Dedicated*>::iterator it = DedicatedJobs.begin(); it != DedicatedJobs.end(); )
+		{
+			Dedicated* d = *it;
+
+			if (!all && !d->Finished.load())
+			{
+				++it;
+				continue;
+			}
+
+			d->JobThread->join();
+			delete d->JobThread;
+			delete d;
+
+			it = DedicatedJobs.erase(it);
+		}
+	}
+
+	void stop()
+	{
+		Stopping.store(true);
+
+		for (size_t i = 0; i < Workers.size(); i++)
+			Workers[i]->Wake.signal();
+
+		for (size_t i = 0; i < Workers.size(); i++)
+		{
+			if (Workers[i]->WorkerThread != NULL)
+			{
+				Workers[i]->WorkerThread->join();
+				delete Workers[i]->WorkerThread;
+			}
+
+			delete Workers[i];
+		}
+
+		Workers.clear();
+
+		DedicatedCS.enter();
+		reapDedicated(true);
+		DedicatedCS.leave();
+	}
+};
+
+ThreadPool::Batch::Batch() :
+	_pending(0)
+{ }
+
+size_t ThreadPool::Batch::pending() const
+{
+	return _pending.load();
+}
+
+ThreadPool::ThreadPool(size_t numOfThreads) :
+	_pi(new Impl())
+{
+	if (numOfThreads == 0)
+		numOfThreads = thread::hardware_concurrency();
+
+	if (numOfThreads == 0)
+		numOfThreads = 1;
+
+	for (size_t i = 0; i < numOfThreads; i++)
+		_pi->Workers.push_back(new Impl::Worker(_pi));
+
+	try
+	{
+		for (size_t i = 0; i < numOfThreads; i++)
+			_pi->Workers[i]->WorkerThread = Thread::startNew(Impl::workerThread, _pi->Workers[i]);
+	}
+	catch (...)
+	{
+		_pi->stop();
+		delete _pi;
+
+		throw;
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	_pi->stop();
+
+	delete _pi;
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+
+	return pool;
+}
+
+size_t ThreadPool::numOfThreads() const
+{
+	return _pi->Workers.size();
+}
+
+void ThreadPool::submit(Thread::ThreadStartRoutine routine, void* userData, Batch* batch, Placement placement)
+{
+	Job job;
+	job.routine = routine;
+	job.userData = userData;
+	job.batch = batch;
+
+	if (batch != NULL)
+		batch->_pending.fetch_add(1);
+
+	if (placement == PLACEMENT_POOLED)
+	{
+		_pi->push(job);
+		return;
+	}
+
+	Impl::Dedicated* d = new Impl::Dedicated(job);
+
+	_pi->DedicatedCS.enter();
+
+	_pi->reapDedicated(false);
+
+	try
+	{
+		d->JobThread = Thread::startNew(Impl::dedicatedThread, d);
+	}
+	catch (...)
+	{
+		_pi->DedicatedCS.leave();
+
+		delete d;
+
+		if (batch != NULL)
+			batch->_pending.fetch_sub(1);
+
+		throw;
+	}
+
+	_pi->DedicatedJobs.push_back(d);
+
+	_pi->DedicatedCS.leave();
+}
+
+void ThreadPool::wait(Batch& batch)
+{
+	Impl::Worker* w = _pi->self();
+
+	while (batch._pending.load() != 0)
+	{
+		Job job;
+
+		if (_pi->tryPop(w, job))
+		{
+			Impl::run(job);
+			continue;
+		}
+
+		if (w != NULL)
+			batch._done.waitUs(HelpPollUs);
+		else
+			batch._done.wait();
+	}
+
+	// Let the job that finished the batch get out of it.
+	batch._finishing.enter();
+	batch._finishing.leave();
+}
+
+void ThreadPool::parallelFor(size_t count, RangeRoutine routine, void* userData, size_t minChunk)
+{
+	if (count == 0)
+		return;
+
+	if (minChunk == 0)
+		minChunk = 1;
+
+	size_t numOfChunks = (numOfThreads() + 1) * ChunksPerThread;
+	size_t chunk = (count + numOfChunks - 1) / numOfChunks;
+
+	if (chunk < minChunk)
+		chunk = minChunk;
+
+	if (chunk >= count)
+	{
+		routine(userData, 0, count);
+		return;
+	}
+
+	vector<RangeJob> ranges;
+	ranges.reserve((count + chunk - 1) / chunk);
+
+	for (size_t begin = 0; begin < count; begin += chunk)
+	{
+		RangeJob r;
+		r.routine = routine;
+		r.userData = userData;
+		r.begin = begin;
+		r.end = begin + chunk < count ? begin + chunk : count;
+
+		ranges.push_back(r);
+	}
+
+	Batch batch;
+
+	for (size_t i = 1; i < ranges.size(); i++)
+		submit(runRange, &ranges[i], &batch);
+
+	runRange(&ranges[0]);
+
+	wait(batch);
+}
+
+}
+}
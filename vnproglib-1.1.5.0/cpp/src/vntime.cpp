@@ -19,30 +19,151 @@ using namespace std;
 namespace vn {
 namespace xplat {
 
-TimeStamp::TimeStamp() : _sec(0), _usec(0) { }
+namespace
+{
+	const int64_t NsPerSec = 1000000000;
+}
+
+TimeStamp::TimeStamp() : _sec(0), _usec(0), _nsec(0), _clock(CLOCKSOURCE_REALTIME) { }
+
+TimeStamp::TimeStamp(int64_t sec, uint64_t usec) :
+	_sec(sec),
+	_usec(usec),
+	_nsec(static_cast<uint32_t>(usec * 1000)),
+	_clock(CLOCKSOURCE_REALTIME)
+{ }
 
-TimeStamp::TimeStamp(int64_t sec, uint64_t usec) : _sec(sec), _usec(usec) { }
+TimeStamp::TimeStamp(int64_t sec, uint32_t nsec, ClockSource clock) :
+	_sec(sec),
+	_usec(nsec / 1000),
+	_nsec(nsec),
+	_clock(clock)
+{ }
 
 TimeStamp TimeStamp::get()
+{
+	return get(CLOCKSOURCE_REALTIME);
+}
+
+TimeStamp TimeStamp::get(ClockSource clock)
 {
 	#if _WIN32
 
-	// HACK: Just returning an empty TimeStamp for now.
-	return TimeStamp();
-	
-	#elif __linux__ || __APPLE__ || __CYGWIN__ || __QNXNTO__
-	
-	struct timeval tv;
+	if (clock == CLOCKSOURCE_REALTIME)
+	{
+		// FILETIME counts 100 ns intervals since January 1, 1601.
+		FILETIME ft;
+		GetSystemTimeAsFileTime(&ft);
 
-	gettimeofday(&tv, NULL);
+		ULARGE_INTEGER t;
+		t.LowPart = ft.dwLowDateTime;
+		t.HighPart = ft.dwHighDateTime;
+
+		int64_t ns = static_cast<int64_t>(t.QuadPart - 116444736000000000ULL) * 100;
+
+		return fromNs(ns, CLOCKSOURCE_REALTIME);
+	}
+
+	// The performance counter is not adjusted so it serves both monotonic
+	// clocks.
+	LARGE_INTEGER freq, counter;
+	if (!QueryPerformanceFrequency(&freq))
+		throw not_supported();
+
+	QueryPerformanceCounter(&counter);
+
+	int64_t sec = counter.QuadPart / freq.QuadPart;
+	int64_t rem = counter.QuadPart % freq.QuadPart;
+
+	return TimeStamp(sec, static_cast<uint32_t>(rem * NsPerSec / freq.QuadPart), clock);
+
+	#elif __linux__ || __CYGWIN__ || __QNXNTO__
+
+	clockid_t id;
+
+	switch (clock)
+	{
+		case CLOCKSOURCE_REALTIME:
+			id = CLOCK_REALTIME;
+			break;
+
+		#ifdef CLOCK_MONOTONIC_RAW
+		case CLOCKSOURCE_MONOTONIC_RAW:
+			id = CLOCK_MONOTONIC_RAW;
+			break;
+		#endif
+
+		default:
+			id = CLOCK_MONOTONIC;
+			break;
+	}
+
+	struct timespec time;
+
+	if (clock_gettime(id, &time))
+		throw unknown_error();
+
+	return TimeStamp(time.tv_sec, static_cast<uint32_t>(time.tv_nsec), clock);
+
+	#elif __APPLE__
+
+	if (clock == CLOCKSOURCE_REALTIME)
+	{
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+
+		return TimeStamp(tv.tv_sec, static_cast<uint64_t>(tv.tv_usec));
+	}
+
+	clock_serv_t cclock;
+	mach_timespec_t mts;
+
+	host_get_clock_service(mach_host_self(), SYSTEM_CLOCK, &cclock);
+	clock_get_time(cclock, &mts);
+	mach_port_deallocate(mach_task_self(), cclock);
+
+	return TimeStamp(mts.tv_sec, static_cast<uint32_t>(mts.tv_nsec), clock);
 
-	return TimeStamp(tv.tv_sec, tv.tv_usec);
-	
 	#else
 	#error "Unknown System"
 	#endif
 }
 
+TimeStamp TimeStamp::fromNs(int64_t ns, ClockSource clock)
+{
+	int64_t sec = ns / NsPerSec;
+	int64_t nsec = ns % NsPerSec;
+
+	if (nsec < 0)
+	{
+		sec -= 1;
+		nsec += NsPerSec;
+	}
+
+	return TimeStamp(sec, static_cast<uint32_t>(nsec), clock);
+}
+
+TimeStamp::ClockSource TimeStamp::clockSource() const
+{
+	return _clock;
+}
+
+int64_t TimeStamp::totalNs() const
+{
+	return _sec * NsPerSec + _nsec;
+}
+
+double TimeStamp::totalSec() const
+{
+	return static_cast<double>(_sec) + _nsec / 1e9;
+}
+
+TimeStamp TimeStamp::addNs(int64_t ns) const
+{
+	return fromNs(totalNs() + ns, _clock);
+}
+
 struct Stopwatch::Impl
 {
 	#if _WIN32